@@ -8,11 +8,24 @@
 
 #include "hel_kernel.h"
 #include "mem_driver.h"
+#if HEL_THREAD_SAFE
+#include "os_driver.h"
+#endif
 
 // TODO This not protecting against wrapparounds
 #define ROUND_UP_DEV(x, y) (((x) + (y) - 1) / y)
 
-static uint8_t *used_map;
+#define HEL_MIN(x, y) ((x > y) ? y: x)
+#define HEL_MAX(x, y) ((x > y) ? x: y)
+
+/*
+ * All the state of volume is at its hel_fs (see hel_kernel.h), internal functions get it as fs and the macros below use it.
+ */
+#define MEM_READ(v_addr, size, out) fs->driver.mem_read(fs->driver.arg, (v_addr), (size), (out))
+#define MEM_WRITE(v_addr, atomic_write, in, size, buffs_num) fs->driver.mem_write(fs->driver.arg, (v_addr), (atomic_write), (in), (size), (buffs_num))
+
+#define MAP_WORD_BITS 64
+#define MAP_WORD_FULL (~(hel_map_word)0)
 
 /*
  * We have two bits that are constant, and the other are flexible.
@@ -78,18 +91,137 @@ static_assert(META_IS_END_OFFSET + META_IS_END_BITS_NUM == HEL_BASE_TYPE_BITS);
 #define META_IS_START_SET(meta, val)				META_SETTER(meta, META_IS_START_BITS_NUM, META_IS_START_OFFSET, val)
 #define META_IS_END_SET(meta, val)					META_SETTER(meta, META_IS_END_BITS_NUM, META_IS_END_OFFSET, val)
 
-#define CHUNK_SIZE_IN_SECTORS(chunk) (!META_IS_END_GET(*chunk) ? META_NOT_END_SECTORS_SIZE_GET(*chunk) : ROUND_UP_DEV(META_END_BYTES_SIZE_GET(*chunk), sector_size))
-#define CHUNK_DATA_BYTES(chunk) (META_IS_END_GET(*chunk) ? META_END_BYTES_SIZE_GET(*chunk) - sizeof(hel_metadata) :(META_NOT_END_SECTORS_SIZE_GET(*chunk) * sector_size) - sizeof(hel_metadata))
+#define CHUNK_SIZE_IN_SECTORS(chunk) (!META_IS_END_GET(*chunk) ? META_NOT_END_SECTORS_SIZE_GET(*chunk) : ROUND_UP_DEV(META_END_BYTES_SIZE_GET(*chunk), fs->sector_size))
+#define CHUNK_DATA_BYTES(chunk) (META_IS_END_GET(*chunk) ? META_END_BYTES_SIZE_GET(*chunk) - sizeof(hel_metadata) :(META_NOT_END_SECTORS_SIZE_GET(*chunk) * fs->sector_size) - sizeof(hel_metadata))
 
-#define SET_USED_BIT(id) (used_map[(id) / 8] |= (1 << ((id) % 8)))
-#define UNSET_USED_BIT(id) (used_map[(id) / 8] &= ~(1 << ((id) % 8)))
-#define GET_USED_BIT(id) (used_map[(id) / 8] &  (1 << ((id) % 8)))
+#define MAP_WORD_IDX(id) ((id) / MAP_WORD_BITS)
+#define MAP_BIT_IDX(id) ((id) % MAP_WORD_BITS)
+#define MAP_BIT_MASK(id) ((hel_map_word)1 << MAP_BIT_IDX(id))
+#define MAP_MASK_FROM(bit) (MAP_WORD_FULL << (bit)) // All bits from 'bit' to the end of the word
 
-#define NUM_OF_SECTORS (mem_size / sector_size)
+#define GET_USED_BIT(id) (fs->used_map[MAP_WORD_IDX(id)] & MAP_BIT_MASK(id))
 
-#define PROTECT_POWER_LOSS
+#define NUM_OF_SECTORS (fs->mem_size / fs->sector_size)
+#define NUM_OF_MAP_WORDS ROUND_UP_DEV(NUM_OF_SECTORS, MAP_WORD_BITS)
+#define NUM_OF_SUMMARY_WORDS ROUND_UP_DEV(NUM_OF_MAP_WORDS, MAP_WORD_BITS)
 
-#define HEL_MIN(x, y) ((x > y) ? y: x)
+/*
+ * @brief count trailing zeros of map word (the index of the first set bit).
+ *
+ * @param [IN] word - the word to check, should not be 0.
+ *
+ * @return the number of trailing zeros.
+ */
+static inline HEL_BASE_TYPE hel_map_word_ctz(hel_map_word word)
+{
+	assert(word != 0);
+
+#if defined(__GNUC__) || defined(__clang__)
+	return (HEL_BASE_TYPE)__builtin_ctzll(word);
+#else
+	HEL_BASE_TYPE ret = 0;
+
+	while((word & 1) == 0)
+	{
+		word >>= 1;
+		ret++;
+	}
+
+	return ret;
+#endif
+}
+
+/*
+ * @brief count the set bits of map word.
+ *
+ * @param [IN] word - the word to count.
+ *
+ * @return the number of set bits.
+ */
+static inline HEL_BASE_TYPE hel_map_word_popcount(hel_map_word word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (HEL_BASE_TYPE)__builtin_popcountll(word);
+#else
+	HEL_BASE_TYPE ret = 0;
+
+	while(word != 0)
+	{
+		word &= word - 1;
+		ret++;
+	}
+
+	return ret;
+#endif
+}
+
+/*
+ * @brief update the summary bits of used map word, should be called after every change of the word.
+ *
+ * @param [IN] word_idx - the index of the used map word.
+ */
+static void hel_update_word_summary(hel_fs *fs, HEL_BASE_TYPE word_idx)
+{
+	HEL_BASE_TYPE summary_idx = MAP_WORD_IDX(word_idx);
+	hel_map_word summary_mask = MAP_BIT_MASK(word_idx);
+
+	if(fs->used_map[word_idx] == MAP_WORD_FULL)
+	{
+		fs->full_words_map[summary_idx] |= summary_mask;
+	}
+	else
+	{
+		fs->full_words_map[summary_idx] &= ~summary_mask;
+	}
+
+	if(fs->used_map[word_idx] == 0)
+	{
+		fs->empty_words_map[summary_idx] |= summary_mask;
+	}
+	else
+	{
+		fs->empty_words_map[summary_idx] &= ~summary_mask;
+	}
+}
+
+/*
+ * @brief find the first used map word, starting from specific word, that its summary bit is unset.
+ *
+ * @param [IN] summary - the summary map to search in (full_words_map or empty_words_map).
+ * @param [IN] word_idx - the index of the used map word to start from.
+ *
+ * @return the index of the used map word, NUM_OF_MAP_WORDS if there is no such word.
+ */
+static HEL_BASE_TYPE hel_find_unset_summary_bit(hel_fs *fs, hel_map_word *summary, HEL_BASE_TYPE word_idx)
+{
+	HEL_BASE_TYPE summary_idx = MAP_WORD_IDX(word_idx);
+	HEL_BASE_TYPE summary_words_num = NUM_OF_SUMMARY_WORDS;
+	hel_map_word unset_bits;
+
+	if(word_idx >= NUM_OF_MAP_WORDS)
+	{
+		return NUM_OF_MAP_WORDS;
+	}
+
+	unset_bits = ~summary[summary_idx] & MAP_MASK_FROM(MAP_BIT_IDX(word_idx));
+
+	while(unset_bits == 0)
+	{
+		summary_idx++;
+		if(summary_idx == summary_words_num)
+		{
+			return NUM_OF_MAP_WORDS;
+		}
+
+		unset_bits = ~summary[summary_idx];
+	}
+
+	word_idx = (summary_idx * MAP_WORD_BITS) + hel_map_word_ctz(unset_bits);
+
+	return HEL_MIN(word_idx, NUM_OF_MAP_WORDS);
+}
+
+#define PROTECT_POWER_LOSS
 
 /*
  * @brief Internal macro for reading chunk metadata from memory.
@@ -99,708 +231,6120 @@ static_assert(META_IS_END_OFFSET + META_IS_END_BITS_NUM == HEL_BASE_TYPE_BITS);
  * 
  * @return hel_success upon success, hel_XXXX_err otherwise.
 */
-#define READ_CHUNK_METADATA(id, p_chunk) mem_driver_read((id) * sector_size, sizeof(hel_metadata), (p_chunk))
+#define READ_CHUNK_METADATA(id, p_chunk) MEM_READ((id) * fs->sector_size, sizeof(hel_metadata), (p_chunk))
+
+#define FREE_EXTENTS_MIN_CAPACITY 8
 
-static HEL_BASE_TYPE mem_size;
-static HEL_BASE_TYPE sector_size;
+#ifndef HEL_COPY_BUFF_SIZE
+#define HEL_COPY_BUFF_SIZE 64
+#endif
+
+/*
+ * Journal record is chunk that signed as start of file and points to itself as next chunk (which is not valid for file),
+ * after the metadata it holds the number of writes, and then for each write its address, length and data.
+ * It exists only during operation that needs multiple writes to be atomic, if power down happens the writes are finished at hel_init.
+ */
+#define IS_JOURNAL_CHUNK(chunk, id) (META_IS_START_GET(chunk) && !META_IS_END_GET(chunk) && (META_NOT_END_NEXT_GET(chunk) == (id)))
 
 typedef struct
 {
-	hel_file_id id;
-	HEL_BASE_TYPE size;
-}chunk_data;
+	HEL_BASE_TYPE addr; // memory address to write to
+	HEL_BASE_TYPE len; // number of bytes to write
+	void *data;
+}journal_op;
 
 /*
- * @brief internal function to iterate over chunks.
- * 
- * @param [INOUT] curr_chunk - pointer to chunk, upon success points to next chunk.
- * @param [INOUT] id - pointer to the id of curr_chunk, upon success points to the next chunk id.
- * 
- * @return hel_success upon success, hel_mem_err in case curr_chunk is last chunk, hel_XXXX_err otherwise.
+ * Each API function is implementation function (with _unlocked suffix) called under the lock of the volume, see the end of this file.
+ * Functions that only read the memory take the lock shared so they run in parallel, all others take it exclusive
+ * (except hel_create_and_write, which takes it shared and the allocator lock for changing the free space state, see below).
+ * The extent cache is changed also by readers, so it has its own short lock.
  */
-static hel_ret hel_iterator(hel_metadata *curr_chunk, hel_file_id *id)
-{
-	hel_file_id next_id;
-	hel_ret ret;
+#if HEL_THREAD_SAFE
+#define HEL_LOCKED_CALL(lock, unlock, call)				\
+	do													\
+	{													\
+		hel_ret _ret, _unlock_ret;						\
+														\
+		if(NULL == fs)									\
+		{												\
+			return hel_param_err;						\
+		}												\
+														\
+		_ret = fs->driver.lock(fs->driver.arg);			\
+		if(_ret != hel_success)							\
+		{												\
+			return _ret;								\
+		}												\
+														\
+		_ret = (call);									\
+		_unlock_ret = fs->driver.unlock(fs->driver.arg);	\
+														\
+		return (_ret != hel_success) ? _ret : _unlock_ret;	\
+	}while(0)
+#else
+#define HEL_LOCKED_CALL(lock, unlock, call)	\
+	do										\
+	{										\
+		if(NULL == fs)						\
+		{									\
+			return hel_param_err;			\
+		}									\
+											\
+		return (call);						\
+	}while(0)
+#endif
 
-	next_id = *id + CHUNK_SIZE_IN_SECTORS(curr_chunk);
-	assert(next_id <= NUM_OF_SECTORS);
-	assert(next_id > *id);
+#define HEL_SHARED_CALL(call) HEL_LOCKED_CALL(lock_shared, unlock_shared, call)
+#if HEL_ASYNC
+// The asynchronous creates that were done are settled before every change, see hel_async_settle
+#define HEL_SETTLED_CALL(call) (hel_async_settle(fs), (call))
+#else
+#define HEL_SETTLED_CALL(call) (call)
+#endif
+#if HEL_LOCKFREE_READS
+// Ranges that were freed are reused only after the lock-free readers that may read them end, see hel_lockfree_reclaim
+#define HEL_EXCLUSIVE_CALL(call) HEL_LOCKED_CALL(lock_exclusive, unlock_exclusive, hel_lockfree_reclaim(fs, HEL_SETTLED_CALL(call)))
+#else
+#define HEL_EXCLUSIVE_CALL(call) HEL_LOCKED_CALL(lock_exclusive, unlock_exclusive, HEL_SETTLED_CALL(call))
+#endif
 
-	if(next_id >= NUM_OF_SECTORS)
-	{
-		return hel_mem_err;
-	}
+/*
+ * Creates hold the kernel lock shared, so the free space state is changed by them under the allocator lock,
+ * and each create holds the lock of its allocation group while it writes the file.
+ * The order is always group lock and then allocator lock.
+ */
+#if HEL_THREAD_SAFE
+#define ALLOC_LOCK() fs->driver.alloc_lock(fs->driver.arg)
+#define ALLOC_UNLOCK() fs->driver.alloc_unlock(fs->driver.arg)
+#define GROUP_LOCK(group) fs->driver.group_lock(fs->driver.arg, (group))
+#define GROUP_UNLOCK(group) fs->driver.group_unlock(fs->driver.arg, (group))
+#else
+#define ALLOC_LOCK() hel_success
+#define ALLOC_UNLOCK() hel_success
+#define GROUP_LOCK(group) hel_success
+#define GROUP_UNLOCK(group) hel_success
+#endif
 
-	ret = READ_CHUNK_METADATA(next_id, curr_chunk);
-	if(ret != hel_success)
+/*
+ * Reads hold the kernel lock shared too, so the extent cache is changed under the cache lock,
+ * it is held just for finding and installing entries, never while reading the memory.
+ */
+#if HEL_THREAD_SAFE
+#define CACHE_LOCK() fs->driver.cache_lock(fs->driver.arg)
+#define CACHE_UNLOCK() fs->driver.cache_unlock(fs->driver.arg)
+#else
+#define CACHE_LOCK() hel_success
+#define CACHE_UNLOCK() hel_success
+#endif
+
+static hel_ret hel_get_first_file_unlocked(hel_fs *fs, hel_file_id *id);
+static hel_ret hel_iterate_files_unlocked(hel_fs *fs, hel_file_id *id);
+
+#define FREE_EXTENT_END(idx) (fs->free_extents[(idx)].id + fs->free_extents[(idx)].size)
+
+/*
+ * @brief internal function for getting the histogram bucket of extent size.
+ *
+ * @param [IN] size - the size of the extent in sectors.
+ *
+ * @return the bucket index, floor(log2(size)) limited to the last bucket.
+ */
+static HEL_BASE_TYPE hel_hist_bucket(HEL_BASE_TYPE size)
+{
+	HEL_BASE_TYPE bucket = 0;
+
+	assert(size != 0);
+
+	while((size > 1) && (bucket < HEL_FREE_HIST_BUCKETS - 1))
 	{
-		return ret;
+		size >>= 1;
+		bucket++;
 	}
 
-	*id = next_id;
-	
-	return hel_success;
+	return bucket;
 }
 
 /*
- * @brief internal function for finding next empty chunk.
- * 
- * @param [IN] id - the chunk id to start searching from.
- * @param [OUT] out_id - the first id of chunk, starting from id, which is not part of file.
- * 
- * @return hel_success if found such empty chunk, hel_mem_err if no such empty chunk exist.
+ * @brief internal function for updating the free space counters upon adding/removing extent from the index.
+ *
+ * @param [IN] size - the size of the extent in sectors.
+ * @param [IN] add - true if the extent added to the index, false if removed.
+ *
+ * @note changing extent size should be accounted as removing the old extent and adding the new.
  */
-static hel_ret hel_find_empty_chunk(hel_file_id id, hel_file_id *out_id)
+static void hel_extent_account(hel_fs *fs, HEL_BASE_TYPE size, bool add)
 {
-	assert(id <= NUM_OF_SECTORS);
-
-	for(HEL_BASE_TYPE curr_id = id; curr_id < mem_size / sector_size; curr_id++)
+	if(add)
 	{
-		if(!GET_USED_BIT(curr_id))
+		fs->free_sectors_num += size;
+		fs->free_extents_hist[hel_hist_bucket(size)]++;
+
+		if(!fs->largest_free_extent_dirty && (size > fs->largest_free_extent))
 		{
-			*out_id = curr_id;
-			return hel_success;
+			fs->largest_free_extent = size;
 		}
 	}
+	else
+	{
+		fs->free_sectors_num -= size;
+		fs->free_extents_hist[hel_hist_bucket(size)]--;
 
-	return hel_mem_err;
+		if(size == fs->largest_free_extent)
+		{
+			fs->largest_free_extent_dirty = true;
+		}
+	}
 }
 
 /*
- * @brief internal function for signing internally chunk/chain of chunks as free or part of file.
- * 
- * @param [IN] chunk - the metadata of the first chunk need to sign.
- * @param [IN] start_sector_id - the id of the first sector in the chunk.
- * @param [IN] all_chain - if need to sign just current chunk or aso the whole chain it points to.
- * @param [IN] in_use - if the chunk(s) is in use ore free.
- * 
- * @return hel_success upon success, hel_XXXX_err otherwise.
+ * @brief internal function for updating the files counters upon creating/deleting file.
+ *
+ * @param [IN] chunks_num - the number of chunks of the file.
+ * @param [IN] add - true if the file created, false if deleted.
  */
-static hel_ret hel_sign_area(hel_metadata *chunk, hel_file_id start_sector_id, bool all_chain, bool in_use)
+static void hel_file_account(hel_fs *fs, HEL_BASE_TYPE chunks_num, bool add)
 {
-	hel_ret ret;
-	HEL_BASE_TYPE num_of_sectors = CHUNK_SIZE_IN_SECTORS(chunk);
-
-	while(true)
+	if(add)
 	{
-		for(hel_file_id id = start_sector_id; id < start_sector_id + num_of_sectors; id++)
+		fs->files_num++;
+		fs->files_chunks_num += chunks_num;
+
+		if(!fs->max_file_chunks_dirty && (chunks_num > fs->max_file_chunks))
 		{
-			if(in_use)
-			{
-				SET_USED_BIT(id);
-			}
-			else
-			{
-				UNSET_USED_BIT(id);
-			}
+			fs->max_file_chunks = chunks_num;
 		}
+	}
+	else
+	{
+		fs->files_num--;
+		fs->files_chunks_num -= chunks_num;
 
-		if(!all_chain || META_IS_END_GET(*chunk))
+		if(chunks_num == fs->max_file_chunks)
 		{
-			break;
+			fs->max_file_chunks_dirty = true;
 		}
+	}
+}
 
-		start_sector_id = META_NOT_END_NEXT_GET(*chunk);
-
-		ret = READ_CHUNK_METADATA(start_sector_id, chunk);
-		if(ret != hel_success)
+/*
+ * @brief internal function for getting the size of the largest free extent.
+ *
+ * @return the size of the largest free extent in sectors, 0 if there is no free extent.
+ */
+static HEL_BASE_TYPE hel_get_largest_free_extent(hel_fs *fs)
+{
+	if(fs->largest_free_extent_dirty)
+	{
+		fs->largest_free_extent = 0;
+		for(HEL_BASE_TYPE idx = 0; idx < fs->free_extents_num; idx++)
 		{
-			// TODO how to heal from this?
-			return ret;
+			if(fs->free_extents[idx].size > fs->largest_free_extent)
+			{
+				fs->largest_free_extent = fs->free_extents[idx].size;
+			}
 		}
 
-		num_of_sectors = CHUNK_SIZE_IN_SECTORS(chunk);
+		fs->largest_free_extent_dirty = false;
 	}
 
-	return hel_success;
+	return fs->largest_free_extent;
 }
 
 /*
- * @brief internal function for counting how many cosecutive free sectors there are, starting from specific id
- * 
- * @param [IN] id - the id of the sector to start from
- * 
- * @return the number of consecutive free sectors
+ * @brief internal function for getting how many data bytes can be written to new file.
+ *
+ * @return number of bytes, when the file is split on all the free extents.
  */
-static HEL_BASE_TYPE hel_count_consecutive_free_sectors(hel_file_id id)
+static HEL_BASE_TYPE hel_get_free_bytes(hel_fs *fs)
 {
-	HEL_BASE_TYPE ret = 0;
+	// Each free extent will be chunk with its own metadata
+	return (fs->free_sectors_num * fs->sector_size) - (fs->free_extents_num * sizeof(hel_metadata));
+}
 
-	assert(id < NUM_OF_SECTORS);
+/*
+ * @brief internal function for finding the first extent that ends after id.
+ *
+ * @param [IN] id - sector id.
+ * @param [IN] include_adjacent - if true, extent that ends exactly at id is also counted.
+ *
+ * @return index of the extent, free_extents_num if there is no such extent.
+ */
+static HEL_BASE_TYPE hel_extents_lower_bound(hel_fs *fs, hel_file_id id, bool include_adjacent)
+{
+	HEL_BASE_TYPE low = 0, high = fs->free_extents_num;
 
-	for(; id < NUM_OF_SECTORS; id++)
+	while(low < high)
 	{
-		if(GET_USED_BIT(id))
+		HEL_BASE_TYPE mid = low + (high - low) / 2;
+		hel_file_id end = FREE_EXTENT_END(mid);
+
+		if((end < id) || (!include_adjacent && (end == id)))
 		{
-			return ret;
+			low = mid + 1;
 		}
-		else{
-			ret++;
+		else
+		{
+			high = mid;
 		}
 	}
 
-	return ret;
+	return low;
 }
 
 /*
- * @brief internal function that decides where to create chunks for file.
+ * @brief internal function for making room for new extents in the index.
+ *
+ * @param [IN] idx - index to open the room at.
+ * @param [IN] num - number of extents to add, all the extents from idx moved forward.
  *
- * @param [IN]  size - num of data bytes that need space for them.
- * @param [OUT] chunks_arr - array of chunks to write the data to them. It allocated in the function and should be free outside in case of success.
- * @param [OUT] chunks_num - number of chunks in chunks_arr.
- * 
  * @return hel_success upon success, hel_XXXX_err otherwise.
- * 
- * @note this function is the main function that can be changed to optimize writes upon needs. currently it uses greedy implementation that chooses the first chunks.
  */
-static hel_ret hel_get_chunks_for_file(HEL_BASE_TYPE size, chunk_data **chunks_arr, HEL_BASE_TYPE *chunks_num)
+static hel_ret hel_extents_open_room(hel_fs *fs, HEL_BASE_TYPE idx, HEL_BASE_TYPE num)
 {
-	hel_file_id new_file_id = 0;
-	HEL_BASE_TYPE empty_sectors;
-	chunk_data *chunks_arr_tmp;
-	hel_ret ret;
-
-	*chunks_arr = NULL;
-	*chunks_num = 0;
+	if(fs->free_extents_num + num > fs->free_extents_capacity)
+	{
+		HEL_BASE_TYPE new_capacity = fs->free_extents_capacity * 2;
+		hel_free_extent *new_extents;
 
+		if(new_capacity < fs->free_extents_num + num)
+		{
+			new_capacity = fs->free_extents_num + num;
+		}
 
-	while((ret = hel_find_empty_chunk(new_file_id, &new_file_id)) == hel_success)
-	{			
-		empty_sectors = hel_count_consecutive_free_sectors(new_file_id);
-		chunks_arr_tmp = (chunk_data *)realloc(*chunks_arr, (*chunks_num + 1) * sizeof(chunk_data));
-		if(chunks_arr_tmp == NULL)
+		new_extents = (hel_free_extent *)realloc(fs->free_extents, new_capacity * sizeof(hel_free_extent));
+		if(new_extents == NULL)
 		{
-			free(*chunks_arr);
 			return hel_out_of_heap_err;
 		}
 
-		*chunks_arr = chunks_arr_tmp;
-		(*chunks_arr)[*chunks_num].id = new_file_id;
+		fs->free_extents = new_extents;
+		fs->free_extents_capacity = new_capacity;
+	}
 
-		HEL_BASE_TYPE size_in_empty = (empty_sectors * sector_size) - sizeof(hel_metadata);
-		if(size_in_empty >= size)
-		{ // Last chunk
-			(*chunks_arr)[*chunks_num].size = size;
-			(*chunks_num)++;
-			break;
-		}
-		else
-		{ // not last chunk
-			new_file_id += empty_sectors;
-			size -= size_in_empty;
+	memmove(&fs->free_extents[idx + num], &fs->free_extents[idx], (fs->free_extents_num - idx) * sizeof(hel_free_extent));
+	fs->free_extents_num += num;
 
-			(*chunks_arr)[*chunks_num].size = size_in_empty;
-			(*chunks_num)++;
-		}
+	return hel_success;
+}
+
+/*
+ * @brief internal function for growing chunks plan to the capacity of the free extents index, it should be called before planning file.
+ *
+ * @param [INOUT] plan - the plan.
+ * @param [INOUT] capacity - the capacity of the plan.
+ *
+ * @return hel_success upon success, hel_out_of_heap_err otherwise.
+ *
+ * @note the index may grow while the planned chunks are signed, but they were planned at the extents that existed before.
+ */
+static hel_ret hel_chunks_plan_fit(hel_fs *fs, hel_chunk_data **plan, HEL_BASE_TYPE *capacity)
+{
+	hel_chunk_data *new_plan;
+
+	if(*capacity >= fs->free_extents_capacity)
+	{
+		return hel_success;
 	}
 
-	if(ret != hel_success)
+	new_plan = (hel_chunk_data *)realloc(*plan, fs->free_extents_capacity * sizeof(hel_chunk_data));
+	if(new_plan == NULL)
 	{
-		// We will get here also if there is no enough space
-		free(*chunks_arr);
-		return ret;
+		return hel_out_of_heap_err;
 	}
 
+	*plan = new_plan;
+	*capacity = fs->free_extents_capacity;
+
 	return hel_success;
 }
 
 /*
- * @brief Before writing the actual data, creating/defragmenting chunks.
+ * @brief internal function for removing extents from the index.
+ *
+ * @param [IN] idx - index of the first extent to remove.
+ * @param [IN] num - number of extents to remove.
+ */
+static void hel_extents_remove(hel_fs *fs, HEL_BASE_TYPE idx, HEL_BASE_TYPE num)
+{
+	memmove(&fs->free_extents[idx], &fs->free_extents[idx + num], (fs->free_extents_num - idx - num) * sizeof(hel_free_extent));
+	fs->free_extents_num -= num;
+}
+
+/*
+ * @brief internal function for updating the free extents index upon signing sectors.
+ *
+ * @param [IN] start_sector_id - the id of the first sector to sign.
+ * @param [IN] num_of_sectors - number of sectors to sign.
+ * @param [IN] in_use - if the sectors are in use or free.
  *
- * @param [IN] chunks_arr - array of chunks that need to create.
- * @param [IN] chunks_num - number of chunks in chunks_arr.
- * 
  * @return hel_success upon success, hel_XXXX_err otherwise.
  */
-static hel_ret hel_organize_chunks_arr(chunk_data *chunks_arr, HEL_BASE_TYPE chunks_num)
+static hel_ret hel_extents_sign(hel_fs *fs, hel_file_id start_sector_id, HEL_BASE_TYPE num_of_sectors, bool in_use)
 {
+	hel_file_id end_sector_id = start_sector_id + num_of_sectors;
+	HEL_BASE_TYPE idx;
 	hel_ret ret;
 
-	for(HEL_BASE_TYPE i = 0; i < chunks_num; i++)
+	if(num_of_sectors == 0)
 	{
-		hel_metadata first_chunk, curr_chunk;
-		/*
-		 * options:
-		 * 1. all perfect.
-		 * 2. need to update first for defragment, no need to update after as beginning of chunk
-		 * 3. need to update first and create second that not exist.
-		 * 
-		 * what needed to check:
-		 * if after not exist, else if first is fragmented
-		 */
-		bool need_to_update_first = false, need_to_update_first_and_end = false;
-		HEL_BASE_TYPE empty_sectors = hel_count_consecutive_free_sectors(chunks_arr[i].id);
-		HEL_BASE_TYPE needed_sectors = ROUND_UP_DEV(chunks_arr[i].size + sizeof(hel_metadata), sector_size);
-		ret = mem_driver_read(chunks_arr[i].id * sector_size, sizeof(first_chunk), &first_chunk);
-		if(ret != hel_success)
+		return hel_success;
+	}
+
+	if(in_use)
+	{
+		idx = hel_extents_lower_bound(fs, start_sector_id, false);
+
+		if((idx < fs->free_extents_num) && (fs->free_extents[idx].id < start_sector_id) && (FREE_EXTENT_END(idx) > end_sector_id))
 		{
-			return ret;
+			// The area is in the middle of extent, split it
+			ret = hel_extents_open_room(fs, idx + 1, 1);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			hel_extent_account(fs, fs->free_extents[idx].size, false);
+
+			fs->free_extents[idx + 1].id = end_sector_id;
+			fs->free_extents[idx + 1].size = FREE_EXTENT_END(idx) - end_sector_id;
+			fs->free_extents[idx].size = start_sector_id - fs->free_extents[idx].id;
+
+			hel_extent_account(fs, fs->free_extents[idx].size, true);
+			hel_extent_account(fs, fs->free_extents[idx + 1].size, true);
+
+			return hel_success;
 		}
 
-		if(CHUNK_SIZE_IN_SECTORS(&first_chunk) != needed_sectors)
+		if((idx < fs->free_extents_num) && (fs->free_extents[idx].id < start_sector_id))
 		{
-			curr_chunk = first_chunk;
-			need_to_update_first = true;
-			hel_file_id curr_id= chunks_arr[i].id;
-			while(true)
-			{
-				curr_id += CHUNK_SIZE_IN_SECTORS(&curr_chunk);
-				if(curr_id > chunks_arr[i].id + needed_sectors)
-				{
-					need_to_update_first_and_end = true;
-					break;
-				}
-				
-				if(curr_id == chunks_arr[i].id + needed_sectors)
-				{
-					break;
-				}
+			hel_extent_account(fs, fs->free_extents[idx].size, false);
+			fs->free_extents[idx].size = start_sector_id - fs->free_extents[idx].id;
+			hel_extent_account(fs, fs->free_extents[idx].size, true);
+			idx++;
+		}
 
-				ret = READ_CHUNK_METADATA(curr_id, &curr_chunk);
-				if(ret != hel_success)
-				{
-					return ret;
-				}
-			}
+		HEL_BASE_TYPE covered_num = 0;
+		while((idx + covered_num < fs->free_extents_num) && (FREE_EXTENT_END(idx + covered_num) <= end_sector_id))
+		{
+			hel_extent_account(fs, fs->free_extents[idx + covered_num].size, false);
+			covered_num++;
 		}
 
-		if(need_to_update_first_and_end)
+		hel_extents_remove(fs, idx, covered_num);
+
+		if((idx < fs->free_extents_num) && (fs->free_extents[idx].id < end_sector_id))
 		{
-			// write_end
-			hel_metadata end_chunk;
-			META_IS_START_SET(end_chunk, 0);
-			META_IS_END_SET(end_chunk, 0);
-			META_NOT_END_SECTORS_SIZE_SET(end_chunk, empty_sectors - needed_sectors);
-			// No need to set next ID, as currently it is not part of file.
-			
-			mem_driver_write((chunks_arr[i].id + needed_sectors) * sector_size, &end_chunk, NULL, NULL, 0);
+			hel_extent_account(fs, fs->free_extents[idx].size, false);
+			fs->free_extents[idx].size = FREE_EXTENT_END(idx) - end_sector_id;
+			fs->free_extents[idx].id = end_sector_id;
+			hel_extent_account(fs, fs->free_extents[idx].size, true);
 		}
+	}
+	else
+	{
+		hel_file_id new_start = start_sector_id, new_end = end_sector_id;
+		HEL_BASE_TYPE merged_num = 0;
 
-#ifdef PROTECT_POWER_LOSS
-		if(need_to_update_first || need_to_update_first_and_end)
+		// Merge with all overlapping/adjacent extents
+		idx = hel_extents_lower_bound(fs, start_sector_id, true);
+		while((idx + merged_num < fs->free_extents_num) && (fs->free_extents[idx + merged_num].id <= end_sector_id))
 		{
-			// write_first
-			hel_metadata first_chunk;
-			META_IS_START_SET(first_chunk, 0);
-			META_IS_END_SET(first_chunk, 0);
-			META_NOT_END_SECTORS_SIZE_SET(first_chunk, needed_sectors);
-			// No need to set next ID, as currently it is not part of file.
+			hel_extent_account(fs, fs->free_extents[idx + merged_num].size, false);
+			new_start = HEL_MIN(new_start, fs->free_extents[idx + merged_num].id);
+			if(FREE_EXTENT_END(idx + merged_num) > new_end)
+			{
+				new_end = FREE_EXTENT_END(idx + merged_num);
+			}
+			merged_num++;
+		}
 
-			mem_driver_write(chunks_arr[i].id * sector_size, &first_chunk, NULL, NULL, 0);
+		if(merged_num == 0)
+		{
+			ret = hel_extents_open_room(fs, idx, 1);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
 		}
-#endif
+		else
+		{
+			hel_extents_remove(fs, idx + 1, merged_num - 1);
+		}
+
+		fs->free_extents[idx].id = new_start;
+		fs->free_extents[idx].size = new_end - new_start;
+		hel_extent_account(fs, fs->free_extents[idx].size, true);
 	}
 
 	return hel_success;
 }
 
 /*
- * @brief write chunk with metadata and data.
+ * @brief internal function for getting the number of consecutive free sectors, starting from specific id.
  *
- * @param [IN] total_size - num of data bytes to write.
- * @param [IN] id - the id of sector to start the chunk from.
- * @param [IN] buff - array of buffers to write the data from.
- * @param [IN] size - array of sizes, of the buffers.
- * @param [IN] is_first - if the chunk is first chunk of file.
- * @param [IN] is_end - if the chunk is last chunk of file.
- * @param [IN] next_id - the id of first sector in next file chunk, if (is_end == true) the value igmnored.
- * 
- * @return hel_success upon success, hel_XXXX_err otherwise.
+ * @param [IN] id - the id of the sector to start from.
+ *
+ * @return the number of consecutive free sectors, 0 if id is in use.
  */
-static hel_ret hel_write_to_chunk(HEL_BASE_TYPE total_size, hel_file_id id, void **buff, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, bool is_first, bool is_end, hel_file_id next_id)
+static HEL_BASE_TYPE hel_extents_free_sectors_from(hel_fs *fs, hel_file_id id)
 {
-	hel_metadata new_file = 0;;
-	hel_ret ret;
+	HEL_BASE_TYPE idx = hel_extents_lower_bound(fs, id, false);
 
-	if(is_end)
+	if((idx == fs->free_extents_num) || (fs->free_extents[idx].id > id))
 	{
-		META_END_BYTES_SIZE_SET(new_file, total_size + sizeof(hel_metadata));
-		META_IS_END_SET(new_file, 1);
+		return 0;
 	}
-	else
-	{
-		HEL_BASE_TYPE needed_sectors = ROUND_UP_DEV(total_size + sizeof(hel_metadata), sector_size);
 
-		META_NOT_END_SECTORS_SIZE_SET(new_file, needed_sectors);
-		META_IS_END_SET(new_file, 0);
-		META_NOT_END_NEXT_SET(new_file, next_id);
+	return FREE_EXTENT_END(idx) - id;
+}
 
-	}
+/*
+ * @brief internal function to iterate over chunks.
+ * 
+ * @param [INOUT] curr_chunk - pointer to chunk, upon success points to next chunk.
+ * @param [INOUT] id - pointer to the id of curr_chunk, upon success points to the next chunk id.
+ * 
+ * @return hel_success upon success, hel_mem_err in case curr_chunk is last chunk, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_iterator(hel_fs *fs, hel_metadata *curr_chunk, hel_file_id *id)
+{
+	hel_file_id next_id;
+	hel_ret ret;
 
-	META_IS_START_SET(new_file, is_first ? 1: 0);
-	
-	ret = hel_sign_area(&new_file, id, false, true);
-	if(ret != hel_success)
+	next_id = *id + CHUNK_SIZE_IN_SECTORS(curr_chunk);
+	assert(next_id <= NUM_OF_SECTORS);
+	assert(next_id > *id);
+
+	if(next_id >= NUM_OF_SECTORS)
 	{
-		return ret;
+		return hel_mem_err;
 	}
 
-	ret = mem_driver_write(id * sector_size, &new_file, buff, size, num);
+	ret = READ_CHUNK_METADATA(next_id, curr_chunk);
 	if(ret != hel_success)
 	{
 		return ret;
 	}
 
+	*id = next_id;
+	
 	return hel_success;
 }
 
-hel_ret hel_init()
+/*
+ * @brief internal function for finding next empty chunk.
+ * 
+ * @param [IN] id - the chunk id to start searching from.
+ * @param [OUT] out_id - the first id of chunk, starting from id, which is not part of file.
+ * 
+ * @return hel_success if found such empty chunk, hel_mem_err if no such empty chunk exist.
+ */
+static hel_ret hel_find_empty_chunk(hel_fs *fs, hel_file_id id, hel_file_id *out_id)
 {
-	hel_ret ret;
-	hel_metadata check_chunk;
-	hel_file_id curr_id = 0;
+	HEL_BASE_TYPE word_idx = MAP_WORD_IDX(id);
+	hel_map_word free_bits;
 
-	ret = mem_driver_init(&mem_size, &sector_size);
-	if(ret != hel_success)
-	{
-		return ret;
-	}
+	assert(id <= NUM_OF_SECTORS);
 
-	used_map = (uint8_t *)malloc(ROUND_UP_DEV(mem_size / sector_size, 8));
-	if(used_map == NULL)
+	if(id == NUM_OF_SECTORS)
 	{
-		return hel_out_of_heap_err;
+		return hel_mem_err;
 	}
 
-	memset(used_map, 0, ROUND_UP_DEV(mem_size / sector_size, 8));
+	// First word may be partial, ignore the bits before id
+	free_bits = ~fs->used_map[word_idx] & MAP_MASK_FROM(MAP_BIT_IDX(id));
 
-	while((ret = hel_find_empty_chunk(curr_id, &curr_id)) == hel_success)
-	{ 
-		ret = READ_CHUNK_METADATA(curr_id, &check_chunk);
-		if(ret != hel_success)
+	if(free_bits == 0)
+	{
+		// Skip all the full words
+		word_idx = hel_find_unset_summary_bit(fs, fs->full_words_map, word_idx + 1);
+		if(word_idx == NUM_OF_MAP_WORDS)
 		{
-			return ret;
+			return hel_mem_err;
 		}
 
-		if(META_IS_START_GET(check_chunk))
+		free_bits = ~fs->used_map[word_idx];
+	}
+
+	// The padding bits after last sector are signed as used, so this is always valid sector
+	*out_id = (word_idx * MAP_WORD_BITS) + hel_map_word_ctz(free_bits);
+	assert(*out_id < NUM_OF_SECTORS);
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for updating the free sectors counters of the allocation groups upon changing used map word.
+ *
+ * @param [IN] word_idx - the index of the used map word.
+ * @param [IN] changed_bits - the bits of the word that their value was changed.
+ * @param [IN] in_use - if the sectors were signed in use or free.
+ */
+static void hel_alloc_groups_account(hel_fs *fs, HEL_BASE_TYPE word_idx, hel_map_word changed_bits, bool in_use)
+{
+	while(changed_bits != 0)
+	{
+		hel_file_id id = (word_idx * MAP_WORD_BITS) + hel_map_word_ctz(changed_bits);
+		hel_alloc_group *group = &fs->alloc_groups[id / fs->alloc_group_sectors];
+		HEL_BASE_TYPE group_end_bit = group->end_sector - (word_idx * MAP_WORD_BITS);
+		hel_map_word group_bits = (group_end_bit >= MAP_WORD_BITS) ? changed_bits : changed_bits & (((hel_map_word)1 << group_end_bit) - 1);
+
+		if(in_use)
 		{
-			hel_sign_area(&check_chunk, curr_id, true, true);
+			group->free_sectors_num -= hel_map_word_popcount(group_bits);
 		}
 		else
 		{
-			ret = hel_iterator(&check_chunk, &curr_id);
-			if(ret != hel_success)
-			{
-				break;
-			}
+			group->free_sectors_num += hel_map_word_popcount(group_bits);
 		}
-	}
 
-	if((ret != hel_success) && (ret != hel_mem_err))
-	{
-		return ret;
+		changed_bits &= ~group_bits;
 	}
-	
-	return hel_success;
 }
 
-hel_ret hel_close()
+/*
+ * @brief internal function for signing range of sectors in the used map.
+ * 
+ * @param [IN] start_sector_id - the id of the first sector to sign.
+ * @param [IN] num_of_sectors - number of sectors to sign.
+ * @param [IN] in_use - if the sectors are in use or free.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note it also updates the free extents index.
+ */
+static hel_ret hel_sign_sectors_now(hel_fs *fs, hel_file_id start_sector_id, HEL_BASE_TYPE num_of_sectors, bool in_use)
 {
+	HEL_BASE_TYPE word_idx = MAP_WORD_IDX(start_sector_id);
+	HEL_BASE_TYPE bit_idx = MAP_BIT_IDX(start_sector_id);
 	hel_ret ret;
 
-	free(used_map);
-	used_map = NULL;
+	assert(start_sector_id + num_of_sectors <= NUM_OF_SECTORS);
 
-	ret = mem_driver_close();
-	if(ret != hel_success)
+	// The index is built only after the used map is ready at hel_init
+	if(fs->free_extents != NULL)
 	{
-		return ret;
+		ret = hel_extents_sign(fs, start_sector_id, num_of_sectors, in_use);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	while(num_of_sectors != 0)
+	{
+		HEL_BASE_TYPE bits_in_word = HEL_MIN(num_of_sectors, MAP_WORD_BITS - bit_idx);
+		hel_map_word mask = (bits_in_word == MAP_WORD_BITS) ? MAP_WORD_FULL : (((hel_map_word)1 << bits_in_word) - 1) << bit_idx;
+
+		hel_map_word changed_bits = in_use ? (mask & ~fs->used_map[word_idx]) : (mask & fs->used_map[word_idx]);
+
+		if(in_use)
+		{
+			fs->used_map[word_idx] |= mask;
+		}
+		else
+		{
+			fs->used_map[word_idx] &= ~mask;
+		}
+
+		hel_update_word_summary(fs, word_idx);
+
+		// Like the index, the groups are built at hel_init after the used map is ready
+		if(fs->free_extents != NULL)
+		{
+			hel_alloc_groups_account(fs, word_idx, changed_bits, in_use);
+		}
+
+		num_of_sectors -= bits_in_word;
+		word_idx++;
+		bit_idx = 0;
 	}
 
 	return hel_success;
 }
 
-hel_ret hel_format()
+#if HEL_LOCKFREE_READS
+/*
+ * @brief internal function for keeping freed range of sectors from reuse, till the lock-free readers that may read it end.
+ *
+ * @param [IN] start_sector_id - the id of the first sector in the range.
+ * @param [IN] num_of_sectors - number of sectors in the range.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the range stays signed as in use till hel_lockfree_reclaim frees it.
+ */
+static hel_ret hel_lockfree_retire(hel_fs *fs, hel_file_id start_sector_id, HEL_BASE_TYPE num_of_sectors)
 {
-	hel_metadata first_chunk = 0;
-	hel_ret ret;
+	unsigned int epoch = atomic_load(&fs->lockfree_epoch);
 
-	ret = mem_driver_init(&mem_size, &sector_size);
-	if(ret != hel_success)
+	if(fs->retired_num != 0)
 	{
-		return ret;
-	}	
+		hel_retired_range *last = &fs->retired[fs->retired_num - 1];
 
-	if(sector_size <= sizeof(hel_metadata))
-	{
-		return hel_boundaries_err;
-	}
-	if(mem_size % sector_size != 0)
-	{
-		return hel_boundaries_err;
-	}
-	if(mem_size > MAX_BYTES_NUM)
-	{
-		return hel_boundaries_err;
-	}
-	if(mem_size / sector_size > MAX_SECTORS_NUM)
-	{
-		return hel_boundaries_err;
+		// Chunks of the same chain are usually freed one after the other
+		if((last->epoch == epoch) && (last->id + last->size == start_sector_id))
+		{
+			last->size += num_of_sectors;
+			return hel_success;
+		}
 	}
-	
-	META_NOT_END_SECTORS_SIZE_SET(first_chunk, mem_size / sector_size);
-	META_IS_START_SET(first_chunk, 0);
-	META_IS_END_SET(first_chunk, 0);
 
-	ret = mem_driver_write(0, &first_chunk, NULL, NULL, 0);
-	if(ret != hel_success)
+	if(fs->retired_num == fs->retired_capacity)
 	{
-		return ret;
+		HEL_BASE_TYPE new_capacity = (fs->retired_capacity == 0) ? FREE_EXTENTS_MIN_CAPACITY : fs->retired_capacity * 2;
+		hel_retired_range *new_retired = (hel_retired_range *)realloc(fs->retired, new_capacity * sizeof(hel_retired_range));
+		if(new_retired == NULL)
+		{
+			return hel_out_of_heap_err;
+		}
+
+		fs->retired = new_retired;
+		fs->retired_capacity = new_capacity;
 	}
 
-		
-	ret = hel_init();
-		
-	return ret;
+	fs->retired[fs->retired_num].id = start_sector_id;
+	fs->retired[fs->retired_num].size = num_of_sectors;
+	fs->retired[fs->retired_num].epoch = epoch;
+	fs->retired_num++;
+
+	return hel_success;
 }
 
-hel_ret hel_create_and_write(void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id)
+/*
+ * @brief internal function for freeing the retired ranges that no lock-free reader may read anymore,
+ *        called after every operation that changes the files, while no other change is running.
+ *
+ * @param [IN] op_ret - the return value of the operation.
+ *
+ * @return op_ret, ranges that can't be freed (e.g. out of heap) are kept for the next call.
+ */
+static hel_ret hel_lockfree_reclaim(hel_fs *fs, hel_ret op_ret)
 {
-	HEL_BASE_TYPE total_size = 0;
-	chunk_data *new_chunks_arr;
-	HEL_BASE_TYPE chunks_num;
-	hel_ret ret;
-	HEL_BASE_TYPE curr_idx;
-
+	unsigned int epoch;
+	HEL_BASE_TYPE kept_num = 0;
 
-	if(NULL == out_id)
+	if((fs->retired_num == 0) || (fs->free_extents == NULL))
 	{
-		return hel_param_err;
+		return op_ret;
 	}
 
-	for(HEL_BASE_TYPE i = 0; i < num; i++)
+	// The memory writes of the operation are done before the readers are checked
+	atomic_thread_fence(memory_order_seq_cst);
+
+	// Each advance waits for the readers of the other parity, so the readers that started before range was retired end after two advances
+	for(uint8_t i = 0; i < 2; i++)
 	{
-		total_size += size[i];
-	}
-	
-	ret = hel_get_chunks_for_file(total_size, &new_chunks_arr, &chunks_num);
-	if(ret != hel_success)
-	{
-		return ret;
-	}
+		epoch = atomic_load(&fs->lockfree_epoch);
+		if(atomic_load(&fs->lockfree_readers[(epoch + 1) & 1]) != 0)
+		{
+			break;
+		}
 
-	ret = hel_organize_chunks_arr(new_chunks_arr, chunks_num);
-	if(ret != hel_success)
-	{
-		free(new_chunks_arr);
-		return ret;
+		atomic_store(&fs->lockfree_epoch, epoch + 1);
 	}
 
-	// We are writing from end to start (due to power down protection), so pointing to the end.
-	curr_idx = num - 1;
+	epoch = atomic_load(&fs->lockfree_epoch);
 
-	for(HEL_BASE_TYPE i = chunks_num - 1; i != (HEL_BASE_TYPE)-1; i--)
+	for(HEL_BASE_TYPE i = 0; i < fs->retired_num; i++)
 	{
-		void *buffer_pointer_backup;
-		HEL_BASE_TYPE size_backup;
-		HEL_BASE_TYPE num_of_buffs_to_send = 0;
-		HEL_BASE_TYPE write_size = new_chunks_arr[i].size;
-		HEL_BASE_TYPE write_size_needed = write_size;
-		while(true)
-		{
-			num_of_buffs_to_send++;
-
-			if(write_size_needed > size[curr_idx])
-			{
-				write_size_needed -= size[curr_idx];
-				curr_idx --;
-			}
-			else 
-			{
-				size_backup = size[curr_idx] - write_size_needed;
-				buffer_pointer_backup = in[curr_idx];
-				size[curr_idx]  = write_size_needed;
-				in[curr_idx] = (uint8_t *)in[curr_idx] + size_backup;
-				break;
-			}
-		}
+		hel_retired_range *range = &fs->retired[i];
 
-		ret = hel_write_to_chunk(write_size, new_chunks_arr[i].id, in + curr_idx, size + curr_idx, num_of_buffs_to_send, i == 0, i == chunks_num - 1, (i == chunks_num - 1)? 0: new_chunks_arr[i + 1].id);
-		if(ret != hel_success)
+		if((epoch - range->epoch >= 2) && (hel_sign_sectors_now(fs, range->id, range->size, false) == hel_success))
 		{
-			/// No need to delete something in case of failure, if not all chunks written so nothing really done.
-
-			free(new_chunks_arr);
-			return ret;
+			continue;
 		}
 
-		if(size_backup == 0)
-		{
-			curr_idx --;
-		}
-		else
-		{
-			size[curr_idx] = size_backup;
-			in[curr_idx] =buffer_pointer_backup;
-		}
+		fs->retired[kept_num] = *range;
+		kept_num++;
 	}
-	
-	*out_id = new_chunks_arr[0].id;
 
-	free(new_chunks_arr);
-	
-	return hel_success;
+	fs->retired_num = kept_num;
+
+	return op_ret;
 }
 
-hel_ret hel_read(hel_file_id id, void *_out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+/*
+ * @brief internal function for dropping the retired ranges and freeing the retired list, when the used map is built again.
+ */
+static void hel_lockfree_retired_free(hel_fs *fs)
 {
-	uint8_t *out = _out;
-	hel_metadata read_file;
-	hel_ret ret;
+	free(fs->retired);
+	fs->retired = NULL;
+	fs->retired_num = 0;
+	fs->retired_capacity = 0;
+}
+#endif
 
-	if(id > NUM_OF_SECTORS)
+/*
+ * @brief internal function for signing range of sectors in the used map, see hel_sign_sectors_now.
+ *
+ * @note when HEL_LOCKFREE_READS is set, freed sectors are retired first, so they are not reused while lock-free readers may read them.
+ */
+static hel_ret hel_sign_sectors(hel_fs *fs, hel_file_id start_sector_id, HEL_BASE_TYPE num_of_sectors, bool in_use)
+{
+#if HEL_LOCKFREE_READS
+	// Before the index is built at hel_init nothing can be reused, and there are no readers
+	if(!in_use && (fs->free_extents != NULL))
 	{
-		return hel_boundaries_err;
+		return hel_lockfree_retire(fs, start_sector_id, num_of_sectors);
 	}
+#endif
 
-	ret = READ_CHUNK_METADATA(id, &read_file);
-	if(ret != hel_success)
-	{
-		return ret;
-	}
+	return hel_sign_sectors_now(fs, start_sector_id, num_of_sectors, in_use);
+}
 
-	if(!META_IS_START_GET(read_file))
+/*
+ * @brief internal function for signing internally chunk/chain of chunks as free or part of file.
+ * 
+ * @param [IN] chunk - the metadata of the first chunk need to sign.
+ * @param [IN] start_sector_id - the id of the first sector in the chunk.
+ * @param [IN] all_chain - if need to sign just current chunk or aso the whole chain it points to.
+ * @param [IN] in_use - if the chunk(s) is in use ore free.
+ * @param [OUT] chunks_num - if not NULL, the number of chunks that signed.
+ * 
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_sign_area(hel_fs *fs, hel_metadata *chunk, hel_file_id start_sector_id, bool all_chain, bool in_use, HEL_BASE_TYPE *chunks_num)
+{
+	hel_ret ret;
+	HEL_BASE_TYPE num_of_sectors = CHUNK_SIZE_IN_SECTORS(chunk);
+
+	if(chunks_num != NULL)
 	{
-		return hel_not_file_err;
+		*chunks_num = 0;
 	}
 
-	while(size != 0)
+	while(true)
 	{
-		HEL_BASE_TYPE chunk_data_bytes = CHUNK_DATA_BYTES(&read_file);
-		HEL_BASE_TYPE begin_offset = HEL_MIN(chunk_data_bytes, begin);
-		begin -= begin_offset;
-		HEL_BASE_TYPE read_len = (size > chunk_data_bytes - begin_offset) ? chunk_data_bytes - begin_offset: size;
+		ret = hel_sign_sectors(fs, start_sector_id, num_of_sectors, in_use);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
 
-		if(read_len != 0)
+		if(chunks_num != NULL)
 		{
-			ret = mem_driver_read((id * sector_size) + sizeof(read_file) + begin_offset, read_len, out);
-			if(ret != hel_success)
-			{
-				return ret;
-			}
+			(*chunks_num)++;
 		}
 
-		out += read_len;
-		size -= read_len;
-		if(META_IS_END_GET(read_file))
+		if(!all_chain || META_IS_END_GET(*chunk))
 		{
-			if(size != 0)
-			{
-				return hel_boundaries_err;
-			}
+			break;
 		}
-		else
+
+		start_sector_id = META_NOT_END_NEXT_GET(*chunk);
+
+		ret = READ_CHUNK_METADATA(start_sector_id, chunk);
+		if(ret != hel_success)
 		{
-			id = META_NOT_END_NEXT_GET(read_file);
-			ret = READ_CHUNK_METADATA(id, &read_file);
-			if(ret != hel_success)
-			{
-				return ret;
-			}
+			// TODO how to heal from this?
+			return ret;
 		}
+
+		num_of_sectors = CHUNK_SIZE_IN_SECTORS(chunk);
 	}
 
-	return 0;
+	return hel_success;
 }
 
-hel_ret hel_delete(hel_file_id id)
+/*
+ * @brief internal function for counting how many cosecutive free sectors there are, starting from specific id
+ * 
+ * @param [IN] id - the id of the sector to start from
+ * 
+ * @return the number of consecutive free sectors
+ */
+static HEL_BASE_TYPE hel_count_consecutive_free_sectors(hel_fs *fs, hel_file_id id)
 {
-	hel_metadata del_file;
-	hel_ret ret;
+	HEL_BASE_TYPE word_idx = MAP_WORD_IDX(id);
+	hel_map_word used_bits;
 
-	if(id > NUM_OF_SECTORS)
+	assert(id < NUM_OF_SECTORS);
+
+	used_bits = fs->used_map[word_idx] & MAP_MASK_FROM(MAP_BIT_IDX(id));
+	if(used_bits != 0)
 	{
-		return hel_boundaries_err;
+		return hel_map_word_ctz(used_bits) - MAP_BIT_IDX(id);
 	}
 
-	ret = READ_CHUNK_METADATA(id, &del_file);
-	if(ret != hel_success)
+	// Skip all the empty words
+	word_idx = hel_find_unset_summary_bit(fs, fs->empty_words_map, word_idx + 1);
+	if(word_idx == NUM_OF_MAP_WORDS)
 	{
-		return ret;
+		return NUM_OF_SECTORS - id;
 	}
 
-	if(!META_IS_START_GET(del_file))
+	// The padding bits after last sector are signed as used, so we never count after the last sector
+	return (word_idx * MAP_WORD_BITS) + hel_map_word_ctz(fs->used_map[word_idx]) - id;
+}
+
+/*
+ * @brief internal function for splitting the sectors to the allocation groups and counting their free sectors from the free extents index.
+ */
+static void hel_alloc_groups_build(hel_fs *fs)
+{
+	fs->alloc_group_sectors = ROUND_UP_DEV(NUM_OF_SECTORS, fs->alloc_groups_num);
+	fs->next_alloc_group = 0;
+
+	for(HEL_BASE_TYPE group_idx = 0; group_idx < fs->alloc_groups_num; group_idx++)
 	{
-		return hel_not_file_err;
+		hel_alloc_group *group = &fs->alloc_groups[group_idx];
+
+		group->first_sector = HEL_MIN(group_idx * fs->alloc_group_sectors, NUM_OF_SECTORS);
+		group->end_sector = HEL_MIN(group->first_sector + fs->alloc_group_sectors, NUM_OF_SECTORS);
+		group->free_sectors_num = 0;
+		group->creators_num = 0;
+
+		for(HEL_BASE_TYPE idx = hel_extents_lower_bound(fs, group->first_sector, false);
+			(idx < fs->free_extents_num) && (fs->free_extents[idx].id < group->end_sector); idx++)
+		{
+			hel_file_id start = (fs->free_extents[idx].id > group->first_sector) ? fs->free_extents[idx].id : group->first_sector;
+
+			group->free_sectors_num += HEL_MIN(FREE_EXTENT_END(idx), group->end_sector) - start;
+		}
 	}
+}
 
-	META_IS_START_SET(del_file, 0);
+/*
+ * @brief internal function for building the free extents index from the used map.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_extents_build(hel_fs *fs)
+{
+	hel_file_id id = 0;
 
-	ret = hel_sign_area(&del_file, id, true, false);
-	if(ret != hel_success)
+	fs->free_extents_num = 0;
+	fs->free_sectors_num = 0;
+	fs->largest_free_extent = 0;
+	fs->largest_free_extent_dirty = false;
+	memset(fs->free_extents_hist, 0, sizeof(fs->free_extents_hist));
+	fs->free_extents_capacity = FREE_EXTENTS_MIN_CAPACITY;
+	fs->free_extents = (hel_free_extent *)malloc(fs->free_extents_capacity * sizeof(hel_free_extent));
+	fs->chunks_plan = (hel_chunk_data *)malloc(fs->free_extents_capacity * sizeof(hel_chunk_data));
+	if((fs->free_extents == NULL) || (fs->chunks_plan == NULL))
 	{
-		return ret;
+		return hel_out_of_heap_err;
 	}
+	fs->chunks_plan_capacity = fs->free_extents_capacity;
 
-	ret = mem_driver_write(id * sector_size, &del_file, NULL, NULL, 0);
-	if(ret != hel_success)
+	while(hel_find_empty_chunk(fs, id, &id) == hel_success)
 	{
-		return ret;
+		HEL_BASE_TYPE empty_sectors = hel_count_consecutive_free_sectors(fs, id);
+		hel_ret ret = hel_extents_open_room(fs, fs->free_extents_num, 1);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		fs->free_extents[fs->free_extents_num - 1].id = id;
+		fs->free_extents[fs->free_extents_num - 1].size = empty_sectors;
+		hel_extent_account(fs, empty_sectors, true);
+		id += empty_sectors;
 	}
 
+	hel_alloc_groups_build(fs);
+
 	return hel_success;
 }
 
-hel_ret hel_get_first_file(hel_file_id *id)
+/*
+ * @brief internal function for adding chunk to chunks array.
+ *
+ * @param [INOUT] chunks_arr - array of chunks, should have room for free_extents_num chunks.
+ * @param [INOUT] chunks_num - number of chunks in chunks_arr.
+ * @param [IN] id - the id of the chunk first sector.
+ * @param [IN] size - num of data bytes in the chunk.
+ */
+static void hel_add_chunk(hel_fs *fs, hel_chunk_data *chunks_arr, HEL_BASE_TYPE *chunks_num, hel_file_id id, HEL_BASE_TYPE size)
 {
-	hel_ret ret;
-	hel_metadata curr_file;
+	// Every free extent is used at most once for file
+	assert(*chunks_num < fs->free_extents_num);
 
-	ret = READ_CHUNK_METADATA(0, &curr_file);
-	if(ret != hel_success)
-	{
-		return ret;
-	}
-	
-	*id = 0;
+	chunks_arr[*chunks_num].id = id;
+	chunks_arr[*chunks_num].size = size;
+	(*chunks_num)++;
+}
 
-	if(META_IS_START_GET(curr_file))
+/*
+ * @brief internal function for finding free extent that the whole file fits in, according to the allocation policy.
+ *
+ * @param [IN] needed_sectors - number of sectors needed for the file as single chunk.
+ * @param [IN] policy - hel_alloc_best_fit for the smallest such extent or hel_alloc_worst_fit for the largest extent.
+ *
+ * @return index of the extent, free_extents_num if there is no such extent.
+ */
+static HEL_BASE_TYPE hel_find_fitting_extent(hel_fs *fs, HEL_BASE_TYPE needed_sectors, hel_alloc_policy policy)
+{
+	HEL_BASE_TYPE found_idx = fs->free_extents_num;
+
+	for(HEL_BASE_TYPE idx = 0; idx < fs->free_extents_num; idx++)
 	{
-		return hel_success;
+		if(fs->free_extents[idx].size < needed_sectors)
+		{
+			continue;
+		}
+
+		if((found_idx == fs->free_extents_num) ||
+			((policy == hel_alloc_best_fit) && (fs->free_extents[idx].size < fs->free_extents[found_idx].size)) ||
+			((policy == hel_alloc_worst_fit) && (fs->free_extents[idx].size > fs->free_extents[found_idx].size)))
+		{
+			found_idx = idx;
+		}
 	}
 
-	return hel_iterate_files(id);
+	return found_idx;
 }
 
-hel_ret hel_iterate_files(hel_file_id *id)
+/*
+ * @brief internal function that checks if extent is after other extent, when ordering the extents from the largest to smallest (and by memory order for same size).
+ *
+ * @param [IN] idx - the index of the extent to check.
+ * @param [IN] prev_idx - the index of the other extent, free_extents_num means that there is no other extent so every extent is after it.
+ *
+ * @return true if the extent is after prev_idx, false otherwise.
+ */
+static bool hel_extent_is_after(hel_fs *fs, HEL_BASE_TYPE idx, HEL_BASE_TYPE prev_idx)
 {
-	hel_ret ret;
-	hel_metadata curr_file;
-	hel_file_id curr_id;
-
-	if(*id >= NUM_OF_SECTORS)
+	if(prev_idx == fs->free_extents_num)
 	{
-		return hel_boundaries_err;
+		return true;
 	}
 
-	ret = READ_CHUNK_METADATA(*id, &curr_file);
-	if(ret != hel_success)
-	{
-		return ret;
-	}
+	return (fs->free_extents[idx].size < fs->free_extents[prev_idx].size) ||
+		((fs->free_extents[idx].size == fs->free_extents[prev_idx].size) && (idx > prev_idx));
+}
 
-	curr_id = *id;
+/*
+ * @brief internal function for choosing chunks for file with minimal number of chunks.
+ *
+ * @param [IN]  size - num of data bytes that need space for them.
+ * @param [OUT] chunks_arr - array of chunks to write the data to them, should have room for free_extents_num chunks.
+ * @param [OUT] chunks_num - number of chunks in chunks_arr.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the extents are taken from the largest to the smallest, until the rest of the file fits in one extent, then the smallest extent that fits it is taken.
+ */
+static hel_ret hel_get_min_chunks_for_file(hel_fs *fs, HEL_BASE_TYPE size, hel_chunk_data *chunks_arr, HEL_BASE_TYPE *chunks_num)
+{
+	HEL_BASE_TYPE prev_idx = fs->free_extents_num; // The last extent that was taken whole
 
 	while(true)
 	{
-		ret = hel_iterator(&curr_file, &curr_id);
-		if(ret != hel_success)
+		HEL_BASE_TYPE needed_sectors = ROUND_UP_DEV(size + sizeof(hel_metadata), fs->sector_size);
+		HEL_BASE_TYPE fit_idx = fs->free_extents_num, largest_idx = fs->free_extents_num;
+
+		for(HEL_BASE_TYPE idx = 0; idx < fs->free_extents_num; idx++)
 		{
-			if(ret == hel_mem_err)
+			if(!hel_extent_is_after(fs, idx, prev_idx))
 			{
-				return hel_file_not_exist_err;
+				// Already taken
+				continue;
 			}
-			else
+
+			if((fs->free_extents[idx].size >= needed_sectors) &&
+				((fit_idx == fs->free_extents_num) || (fs->free_extents[idx].size < fs->free_extents[fit_idx].size)))
 			{
-				return ret;
+				fit_idx = idx;
+			}
+
+			if((largest_idx == fs->free_extents_num) || (fs->free_extents[idx].size > fs->free_extents[largest_idx].size))
+			{
+				largest_idx = idx;
 			}
 		}
 
-		if(META_IS_START_GET(curr_file))
-		{
-			*id = curr_id;
+		if(fit_idx != fs->free_extents_num)
+		{ // Last chunk
+			hel_add_chunk(fs, chunks_arr, chunks_num, fs->free_extents[fit_idx].id, size);
 			return hel_success;
 		}
+
+		if(largest_idx == fs->free_extents_num)
+		{
+			// There is no enough space
+			return hel_mem_err;
+		}
+
+		HEL_BASE_TYPE size_in_empty = (fs->free_extents[largest_idx].size * fs->sector_size) - sizeof(hel_metadata);
+		hel_add_chunk(fs, chunks_arr, chunks_num, fs->free_extents[largest_idx].id, size_in_empty);
+
+		size -= size_in_empty;
+		prev_idx = largest_idx;
 	}
 }
+
+/*
+ * @brief internal function that decides where to create chunks for file.
+ *
+ * @param [IN]  size - num of data bytes that need space for them.
+ * @param [IN]  start_sector - where the first fit policy starts from (the first sector of the allocation group), 0 for the whole memory.
+ * @param [OUT] chunks_arr - array of chunks to write the data to them, should have room for free_extents_num chunks.
+ * @param [OUT] chunks_num - number of chunks in chunks_arr.
+ * 
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ * 
+ * @note this function is the main function that can be changed to optimize writes upon needs. the place is chosen by the allocation policy (see hel_set_alloc_policy),
+ *       where policies that cannot fit the file in single chunk falls back to splitting it on the free chunks by their order.
+ *
+ * @note when start_sector is in the middle of free extent, the first chunk starts there, the part of the extent before it is not used.
+ */
+static hel_ret hel_get_chunks_for_file(hel_fs *fs, HEL_BASE_TYPE size, hel_file_id start_sector, hel_chunk_data *chunks_arr, HEL_BASE_TYPE *chunks_num)
+{
+	HEL_BASE_TYPE needed_sectors = ROUND_UP_DEV(size + sizeof(hel_metadata), fs->sector_size);
+	HEL_BASE_TYPE start_idx = 0, start_skip = 0; // start_skip is the number of sectors that are not used at the first extent
+
+	*chunks_num = 0;
+
+	switch(fs->alloc_policy)
+	{
+		case hel_alloc_next_fit:
+		{
+			// Chunks can be created just at start of free extent, so starting from the first extent after the last allocation
+			start_idx = hel_extents_lower_bound(fs, fs->next_fit_sector, false);
+			if((start_idx < fs->free_extents_num) && (fs->free_extents[start_idx].id < fs->next_fit_sector))
+			{
+				start_idx++;
+			}
+			if(start_idx == fs->free_extents_num)
+			{
+				start_idx = 0;
+			}
+			break;
+		}
+		case hel_alloc_min_chunks:
+		{
+			return hel_get_min_chunks_for_file(fs, size, chunks_arr, chunks_num);
+		}
+		case hel_alloc_best_fit:
+		case hel_alloc_worst_fit:
+		{
+			HEL_BASE_TYPE fit_idx = hel_find_fitting_extent(fs, needed_sectors, fs->alloc_policy);
+			if(fit_idx != fs->free_extents_num)
+			{
+				hel_add_chunk(fs, chunks_arr, chunks_num, fs->free_extents[fit_idx].id, size);
+				return hel_success;
+			}
+			break;
+		}
+		case hel_alloc_first_fit:
+		default:
+		{
+			start_idx = hel_extents_lower_bound(fs, start_sector, false);
+			if(start_idx == fs->free_extents_num)
+			{
+				start_idx = 0;
+			}
+			else if(fs->free_extents[start_idx].id < start_sector)
+			{
+				start_skip = start_sector - fs->free_extents[start_idx].id;
+			}
+			break;
+		}
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < fs->free_extents_num; i++)
+	{
+		// Going over the extents cyclically from start_idx
+		HEL_BASE_TYPE idx = (start_idx + i) % fs->free_extents_num;
+		hel_file_id new_file_id = fs->free_extents[idx].id + ((i == 0) ? start_skip : 0);
+		HEL_BASE_TYPE empty_sectors = fs->free_extents[idx].size - ((i == 0) ? start_skip : 0);
+
+		HEL_BASE_TYPE size_in_empty = (empty_sectors * fs->sector_size) - sizeof(hel_metadata);
+		if(size_in_empty >= size)
+		{ // Last chunk
+			hel_add_chunk(fs, chunks_arr, chunks_num, new_file_id, size);
+
+			fs->next_fit_sector = new_file_id + ROUND_UP_DEV(size + sizeof(hel_metadata), fs->sector_size);
+			return hel_success;
+		}
+		else
+		{ // not last chunk
+			size -= size_in_empty;
+
+			hel_add_chunk(fs, chunks_arr, chunks_num, new_file_id, size_in_empty);
+		}
+	}
+
+	// We will get here also if there is no enough space
+	return hel_mem_err;
+}
+
+/*
+ * @brief internal function for splitting free chunk, so new chunk can start at the middle of free extent.
+ *
+ * @param [IN] extent_id - the first sector of the free extent.
+ * @param [IN] split_id - the sector to split at, inside the extent.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the metadata at split_id is written first, till the free chunk that contains it is shrunk it is just part of the free chunk data.
+ */
+static hel_ret hel_split_free_chunk(hel_fs *fs, hel_file_id extent_id, hel_file_id split_id)
+{
+	hel_metadata chunk, split_chunk = 0;
+	hel_file_id id = extent_id;
+	hel_ret ret;
+
+	// The extent may be made of some free chunks, finding the one that contains split_id
+	while(true)
+	{
+		ret = READ_CHUNK_METADATA(id, &chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(id + CHUNK_SIZE_IN_SECTORS(&chunk) > split_id)
+		{
+			break;
+		}
+
+		id += CHUNK_SIZE_IN_SECTORS(&chunk);
+	}
+
+	if(id == split_id)
+	{
+		return hel_success;
+	}
+
+	META_IS_START_SET(split_chunk, 0);
+	META_IS_END_SET(split_chunk, 0);
+	META_NOT_END_SECTORS_SIZE_SET(split_chunk, id + CHUNK_SIZE_IN_SECTORS(&chunk) - split_id);
+
+	ret = MEM_WRITE(split_id * fs->sector_size, &split_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	chunk = 0;
+	META_IS_START_SET(chunk, 0);
+	META_IS_END_SET(chunk, 0);
+	META_NOT_END_SECTORS_SIZE_SET(chunk, split_id - id);
+
+	return MEM_WRITE(id * fs->sector_size, &chunk, NULL, NULL, 0);
+}
+
+/*
+ * @brief Before writing the actual data, creating/defragmenting chunks.
+ *
+ * @param [IN] chunks_arr - array of chunks that need to create.
+ * @param [IN] chunks_num - number of chunks in chunks_arr.
+ * 
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_organize_chunks_arr(hel_fs *fs, hel_chunk_data *chunks_arr, HEL_BASE_TYPE chunks_num)
+{
+	hel_ret ret;
+
+	for(HEL_BASE_TYPE i = 0; i < chunks_num; i++)
+	{
+		hel_metadata first_chunk, curr_chunk;
+		/*
+		 * options:
+		 * 1. all perfect.
+		 * 2. need to update first for defragment, no need to update after as beginning of chunk
+		 * 3. need to update first and create second that not exist.
+		 * 
+		 * what needed to check:
+		 * if after not exist, else if first is fragmented
+		 */
+		bool need_to_update_first = false, need_to_update_first_and_end = false;
+		HEL_BASE_TYPE extent_idx = hel_extents_lower_bound(fs, chunks_arr[i].id, false);
+		HEL_BASE_TYPE empty_sectors = hel_extents_free_sectors_from(fs, chunks_arr[i].id);
+		HEL_BASE_TYPE needed_sectors = ROUND_UP_DEV(chunks_arr[i].size + sizeof(hel_metadata), fs->sector_size);
+
+		if((extent_idx < fs->free_extents_num) && (fs->free_extents[extent_idx].id < chunks_arr[i].id))
+		{
+			// The chunk starts at the middle of free extent (at the start of allocation group), so there may be no metadata there
+			ret = hel_split_free_chunk(fs, fs->free_extents[extent_idx].id, chunks_arr[i].id);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+		}
+
+		ret = MEM_READ(chunks_arr[i].id * fs->sector_size, sizeof(first_chunk), &first_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(CHUNK_SIZE_IN_SECTORS(&first_chunk) != needed_sectors)
+		{
+			curr_chunk = first_chunk;
+			need_to_update_first = true;
+			hel_file_id curr_id= chunks_arr[i].id;
+			while(true)
+			{
+				curr_id += CHUNK_SIZE_IN_SECTORS(&curr_chunk);
+				if(curr_id > chunks_arr[i].id + needed_sectors)
+				{
+					need_to_update_first_and_end = true;
+					break;
+				}
+				
+				if(curr_id == chunks_arr[i].id + needed_sectors)
+				{
+					break;
+				}
+
+				ret = READ_CHUNK_METADATA(curr_id, &curr_chunk);
+				if(ret != hel_success)
+				{
+					return ret;
+				}
+			}
+		}
+
+		if(need_to_update_first_and_end)
+		{
+			// write_end
+			hel_metadata end_chunk;
+			META_IS_START_SET(end_chunk, 0);
+			META_IS_END_SET(end_chunk, 0);
+			META_NOT_END_SECTORS_SIZE_SET(end_chunk, empty_sectors - needed_sectors);
+			// No need to set next ID, as currently it is not part of file.
+			
+			MEM_WRITE((chunks_arr[i].id + needed_sectors) * fs->sector_size, &end_chunk, NULL, NULL, 0);
+		}
+
+#ifdef PROTECT_POWER_LOSS
+		if(need_to_update_first || need_to_update_first_and_end)
+		{
+			// write_first
+			hel_metadata first_chunk;
+			META_IS_START_SET(first_chunk, 0);
+			META_IS_END_SET(first_chunk, 0);
+			META_NOT_END_SECTORS_SIZE_SET(first_chunk, needed_sectors);
+			// No need to set next ID, as currently it is not part of file.
+
+			MEM_WRITE(chunks_arr[i].id * fs->sector_size, &first_chunk, NULL, NULL, 0);
+		}
+#endif
+	}
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for signing the chunks that about to be written as in use, or back as free if they won't be written.
+ *
+ * @param [IN] chunks_arr - array of chunks, as returned from hel_get_chunks_for_file.
+ * @param [IN] chunks_num - number of chunks in chunks_arr.
+ * @param [IN] in_use - if the chunks are in use or free.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_sign_chunks_arr(hel_fs *fs, hel_chunk_data *chunks_arr, HEL_BASE_TYPE chunks_num, bool in_use)
+{
+	hel_ret ret;
+
+	for(HEL_BASE_TYPE i = 0; i < chunks_num; i++)
+	{
+		// The chunks are not part of any file yet, so no lock-free reader may read them and they are not retired when freed
+		ret = hel_sign_sectors_now(fs, chunks_arr[i].id, ROUND_UP_DEV(chunks_arr[i].size + sizeof(hel_metadata), fs->sector_size), in_use);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for making the metadata of chunk of file.
+ *
+ * @param [IN] total_size - num of data bytes at the chunk.
+ * @param [IN] is_first - if the chunk is first chunk of file.
+ * @param [IN] is_end - if the chunk is last chunk of file.
+ * @param [IN] next_id - the id of first sector in next file chunk, if (is_end == true) the value igmnored.
+ *
+ * @return the metadata.
+ */
+static hel_metadata hel_make_chunk_metadata(hel_fs *fs, HEL_BASE_TYPE total_size, bool is_first, bool is_end, hel_file_id next_id)
+{
+	hel_metadata new_file = 0;
+
+	if(is_end)
+	{
+		META_END_BYTES_SIZE_SET(new_file, total_size + sizeof(hel_metadata));
+		META_IS_END_SET(new_file, 1);
+	}
+	else
+	{
+		HEL_BASE_TYPE needed_sectors = ROUND_UP_DEV(total_size + sizeof(hel_metadata), fs->sector_size);
+
+		META_NOT_END_SECTORS_SIZE_SET(new_file, needed_sectors);
+		META_IS_END_SET(new_file, 0);
+		META_NOT_END_NEXT_SET(new_file, next_id);
+	}
+
+	META_IS_START_SET(new_file, is_first ? 1: 0);
+
+	return new_file;
+}
+
+/*
+ * @brief write chunk with metadata and data.
+ *
+ * @param [IN] total_size - num of data bytes to write.
+ * @param [IN] id - the id of sector to start the chunk from.
+ * @param [IN] buff - array of buffers to write the data from.
+ * @param [IN] size - array of sizes, of the buffers.
+ * @param [IN] is_first - if the chunk is first chunk of file.
+ * @param [IN] is_end - if the chunk is last chunk of file.
+ * @param [IN] next_id - the id of first sector in next file chunk, if (is_end == true) the value igmnored.
+ * 
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the chunk should be already signed as in use (see hel_sign_chunks_arr).
+ */
+static hel_ret hel_write_to_chunk(hel_fs *fs, HEL_BASE_TYPE total_size, hel_file_id id, void **buff, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, bool is_first, bool is_end, hel_file_id next_id)
+{
+	hel_metadata new_file = hel_make_chunk_metadata(fs, total_size, is_first, is_end, next_id);
+	hel_ret ret;
+
+	ret = MEM_WRITE(id * fs->sector_size, &new_file, buff, size, num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for finishing the writes of committed journal record, and then removing the record.
+ *
+ * @param [IN] journal_id - the id of the journal record chunk.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the writes are absolute, so it is safe to run it again after power down in the middle.
+ */
+static hel_ret hel_journal_finish(hel_fs *fs, hel_file_id journal_id)
+{
+	HEL_BASE_TYPE addr = (journal_id * fs->sector_size) + sizeof(hel_metadata);
+	HEL_BASE_TYPE ops_num, op_header[2]; // The address and length of the write
+	uint8_t buff[HEL_COPY_BUFF_SIZE];
+	hel_metadata journal_chunk;
+	hel_ret ret;
+
+	ret = MEM_READ(addr, sizeof(ops_num), &ops_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	addr += sizeof(ops_num);
+
+	for(HEL_BASE_TYPE i = 0; i < ops_num; i++)
+	{
+		ret = MEM_READ(addr, sizeof(op_header), op_header);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		addr += sizeof(op_header);
+
+		if((op_header[1] == sizeof(hel_metadata)) && (op_header[0] % fs->sector_size == 0))
+		{
+			// May be chunk metadata, so it is written atomically
+			hel_metadata meta;
+
+			ret = MEM_READ(addr, sizeof(meta), &meta);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			ret = MEM_WRITE(op_header[0], &meta, NULL, NULL, 0);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+		}
+		else
+		{
+			for(HEL_BASE_TYPE offset = 0; offset < op_header[1]; offset += sizeof(buff))
+			{
+				void *write_buff = buff;
+				HEL_BASE_TYPE write_size = HEL_MIN(op_header[1] - offset, sizeof(buff));
+
+				ret = MEM_READ(addr + offset, write_size, buff);
+				if(ret != hel_success)
+				{
+					return ret;
+				}
+
+				ret = MEM_WRITE(op_header[0] + offset, NULL, &write_buff, &write_size, 1);
+				if(ret != hel_success)
+				{
+					return ret;
+				}
+			}
+		}
+
+		addr += op_header[1];
+	}
+
+	ret = READ_CHUNK_METADATA(journal_id, &journal_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	// From here the record is just free chunk
+	META_IS_START_SET(journal_chunk, 0);
+	ret = MEM_WRITE(journal_id * fs->sector_size, &journal_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	return hel_success;
+}
+
+#define JOURNAL_RECORD_SECTORS(ops_num, data_bytes) \
+	ROUND_UP_DEV(sizeof(hel_metadata) + sizeof(HEL_BASE_TYPE) + ((ops_num) * 2 * sizeof(HEL_BASE_TYPE)) + (data_bytes), fs->sector_size)
+
+/*
+ * @brief internal function for starting journal record, it takes free chunk for the record and writes the number of writes to it.
+ *
+ * @param [IN] ops_num - number of writes the record will hold.
+ * @param [IN] data_bytes - total number of bytes of all the writes.
+ * @param [OUT] journal_id - the id of the record chunk.
+ * @param [OUT] addr - the address to write the first write to (see hel_journal_add).
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free chunk for the record, hel_XXXX_err otherwise.
+ *
+ * @note the record is taken from the free chunks, so all the areas the caller prepared should be signed as in use before.
+ */
+static hel_ret hel_journal_begin(hel_fs *fs, HEL_BASE_TYPE ops_num, HEL_BASE_TYPE data_bytes, hel_file_id *journal_id, HEL_BASE_TYPE *addr)
+{
+	HEL_BASE_TYPE record_sectors = JOURNAL_RECORD_SECTORS(ops_num, data_bytes);
+	HEL_BASE_TYPE record_idx = hel_find_fitting_extent(fs, record_sectors, hel_alloc_first_fit);
+	void *write_buff = &ops_num;
+	HEL_BASE_TYPE write_size = sizeof(ops_num);
+	hel_chunk_data record;
+	hel_ret ret;
+
+	if(record_idx == fs->free_extents_num)
+	{
+		return hel_mem_err;
+	}
+
+	*journal_id = fs->free_extents[record_idx].id;
+	record.id = *journal_id;
+	record.size = (record_sectors * fs->sector_size) - sizeof(hel_metadata);
+
+	ret = hel_organize_chunks_arr(fs, &record, 1);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	*addr = (*journal_id * fs->sector_size) + sizeof(hel_metadata);
+
+	ret = MEM_WRITE(*addr, NULL, &write_buff, &write_size, 1);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	*addr += write_size;
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for adding write to journal record that was started with hel_journal_begin.
+ *
+ * @param [INOUT] addr - the address to write the write to, it is moved after it.
+ * @param [IN] op - the write.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_journal_add(hel_fs *fs, HEL_BASE_TYPE *addr, journal_op *op)
+{
+	HEL_BASE_TYPE op_header[2] = {op->addr, op->len};
+	void *write_buffs[2] = {op_header, op->data};
+	HEL_BASE_TYPE write_sizes[2] = {sizeof(op_header), op->len};
+	hel_ret ret;
+
+	ret = MEM_WRITE(*addr, NULL, write_buffs, write_sizes, 2);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	*addr += sizeof(op_header) + op->len;
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for committing journal record, that all its writes were added, and then doing the writes.
+ *
+ * @param [IN] journal_id - the id of the record chunk.
+ * @param [IN] ops_num - number of writes in the record.
+ * @param [IN] data_bytes - total number of bytes of all the writes.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_journal_end(hel_fs *fs, hel_file_id journal_id, HEL_BASE_TYPE ops_num, HEL_BASE_TYPE data_bytes)
+{
+	hel_metadata journal_chunk = 0;
+	hel_ret ret;
+
+	META_NOT_END_SECTORS_SIZE_SET(journal_chunk, JOURNAL_RECORD_SECTORS(ops_num, data_bytes));
+	META_NOT_END_NEXT_SET(journal_chunk, journal_id);
+	META_IS_END_SET(journal_chunk, 0);
+	META_IS_START_SET(journal_chunk, 1);
+
+	// Commit
+	ret = MEM_WRITE(journal_id * fs->sector_size, &journal_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	return hel_journal_finish(fs, journal_id);
+}
+
+/*
+ * @brief internal function for doing multiple writes as one atomic operation, they are written first to journal record
+ *        which is committed by single atomic write, and then they are done at their places.
+ *
+ * @param [IN] ops - array of the writes.
+ * @param [IN] ops_num - number of writes in ops.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free chunk for the record, hel_XXXX_err otherwise.
+ *
+ * @note the record is taken from the free chunks, so all the areas the caller prepared should be signed as in use before.
+ *
+ * @note the writes are done by their order, and power down may stop after any of them (the rest are done at hel_init),
+ *       so the memory should be valid after each write (e.g. when chunk grows, the metadata should be written before the data after it).
+ */
+static hel_ret hel_journal_commit(hel_fs *fs, journal_op *ops, HEL_BASE_TYPE ops_num)
+{
+	HEL_BASE_TYPE data_bytes = 0, addr;
+	hel_file_id journal_id;
+	hel_ret ret;
+
+	for(HEL_BASE_TYPE i = 0; i < ops_num; i++)
+	{
+		data_bytes += ops[i].len;
+	}
+
+	ret = hel_journal_begin(fs, ops_num, data_bytes, &journal_id, &addr);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < ops_num; i++)
+	{
+		ret = hel_journal_add(fs, &addr, &ops[i]);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	return hel_journal_end(fs, journal_id, ops_num, data_bytes);
+}
+
+/*
+ * @brief internal function for signing all the files in the used map, by walking over all the chunks in memory.
+ *
+ * @param [OUT] journal_id - the id of journal record that was committed but not finished, NUM_OF_SECTORS if there is no such record.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the used map and the files counters are reset before, so it can run again after the journal record is finished.
+ */
+static hel_ret hel_discover_files(hel_fs *fs, hel_file_id *journal_id)
+{
+	hel_ret ret;
+	hel_metadata check_chunk;
+	hel_file_id curr_id = 0;
+	HEL_BASE_TYPE chunks_num;
+
+	*journal_id = NUM_OF_SECTORS;
+
+	fs->files_num = 0;
+	fs->files_chunks_num = 0;
+	fs->max_file_chunks = 0;
+	fs->max_file_chunks_dirty = false;
+
+	memset(fs->used_map, 0, NUM_OF_MAP_WORDS * sizeof(hel_map_word));
+
+	// Sign the bits after the last sector as used, so scans will never pass the last sector
+	if(MAP_BIT_IDX(NUM_OF_SECTORS) != 0)
+	{
+		fs->used_map[NUM_OF_MAP_WORDS - 1] |= MAP_MASK_FROM(MAP_BIT_IDX(NUM_OF_SECTORS));
+	}
+
+	memset(fs->full_words_map, 0, NUM_OF_SUMMARY_WORDS * sizeof(hel_map_word));
+	memset(fs->empty_words_map, 0, NUM_OF_SUMMARY_WORDS * sizeof(hel_map_word));
+
+	// The words after the last used map word are signed as full, so scans will never pass the last word
+	if(MAP_BIT_IDX(NUM_OF_MAP_WORDS) != 0)
+	{
+		fs->full_words_map[NUM_OF_SUMMARY_WORDS - 1] |= MAP_MASK_FROM(MAP_BIT_IDX(NUM_OF_MAP_WORDS));
+	}
+
+	for(HEL_BASE_TYPE word_idx = 0; word_idx < NUM_OF_MAP_WORDS; word_idx++)
+	{
+		hel_update_word_summary(fs, word_idx);
+	}
+
+	while((ret = hel_find_empty_chunk(fs, curr_id, &curr_id)) == hel_success)
+	{ 
+		ret = READ_CHUNK_METADATA(curr_id, &check_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(IS_JOURNAL_CHUNK(check_chunk, curr_id))
+		{
+			*journal_id = curr_id;
+			hel_sign_area(fs, &check_chunk, curr_id, false, true, NULL);
+		}
+		else if(META_IS_START_GET(check_chunk))
+		{
+			hel_sign_area(fs, &check_chunk, curr_id, true, true, &chunks_num);
+			hel_file_account(fs, chunks_num, true);
+		}
+		else
+		{
+			ret = hel_iterator(fs, &check_chunk, &curr_id);
+			if(ret != hel_success)
+			{
+				break;
+			}
+		}
+	}
+
+	if((ret != hel_success) && (ret != hel_mem_err))
+	{
+		return ret;
+	}
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for freeing the plans of the allocation groups.
+ */
+static void hel_alloc_groups_free(hel_fs *fs)
+{
+	for(HEL_BASE_TYPE group_idx = 0; group_idx < HEL_MAX_ALLOC_GROUPS; group_idx++)
+	{
+		free(fs->alloc_groups[group_idx].chunks_plan);
+		fs->alloc_groups[group_idx].chunks_plan = NULL;
+		fs->alloc_groups[group_idx].chunks_plan_capacity = 0;
+	}
+}
+
+#if HEL_ASYNC
+/*
+ * @brief internal function for checking if asynchronous create is in progress.
+ *
+ * @return true if the transfers of some create are not done yet.
+ *
+ * @note the driver still owns the requests of such create, and its first chunk metadata is written when they are done,
+ *       so the free space of the volume can't be built again or formatted meanwhile.
+ */
+static bool hel_async_creates_in_flight(hel_fs *fs)
+{
+	for(HEL_BASE_TYPE i = 0; i < HEL_ASYNC_MAX_CREATES; i++)
+	{
+		if(atomic_load(&fs->async_creates[i].state) == hel_async_create_in_flight)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+#endif
+
+static hel_ret hel_init_unlocked(hel_fs *fs)
+{
+	hel_ret ret;
+	hel_file_id journal_id;
+
+#if HEL_ASYNC
+	if(hel_async_creates_in_flight(fs))
+	{
+		return hel_busy_err;
+	}
+#endif
+
+	// The RAM reservations of open writers and transactions are lost, so they are cancelled
+	fs->init_generation++;
+
+	ret = fs->driver.mem_init(fs->driver.arg, &fs->mem_size, &fs->sector_size);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	// The maps of the previous init are allocated again with the size of the memory found now
+	free(fs->used_map);
+	fs->used_map = NULL;
+
+	free(fs->full_words_map);
+	fs->full_words_map = NULL;
+
+	free(fs->empty_words_map);
+	fs->empty_words_map = NULL;
+
+	// The free extents index is built after all the files are signed at the used map
+	free(fs->free_extents);
+	fs->free_extents = NULL;
+
+	free(fs->chunks_plan);
+	fs->chunks_plan = NULL;
+	fs->chunks_plan_capacity = 0;
+
+	hel_alloc_groups_free(fs);
+
+#if HEL_LOCKFREE_READS
+	// All the ranges are found free again from the memory
+	hel_lockfree_retired_free(fs);
+#endif
+
+	fs->alloc_policy = HEL_DEFAULT_ALLOC_POLICY;
+	fs->alloc_groups_num = HEL_DEFAULT_ALLOC_GROUPS;
+	fs->next_fit_sector = 0;
+	fs->compact_cursor = 0;
+	fs->compact_generation = 0;
+
+#if HEL_EXTENT_CACHE_ENTRIES > 0
+	memset(fs->extent_cache, 0, sizeof(fs->extent_cache));
+	fs->extent_cache_clock = 0;
+#endif
+
+	fs->used_map = (hel_map_word *)malloc(NUM_OF_MAP_WORDS * sizeof(hel_map_word));
+	fs->full_words_map = (hel_map_word *)malloc(NUM_OF_SUMMARY_WORDS * sizeof(hel_map_word));
+	fs->empty_words_map = (hel_map_word *)malloc(NUM_OF_SUMMARY_WORDS * sizeof(hel_map_word));
+	if((fs->used_map == NULL) || (fs->full_words_map == NULL) || (fs->empty_words_map == NULL))
+	{
+		return hel_out_of_heap_err;
+	}
+
+	ret = hel_discover_files(fs, &journal_id);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(journal_id != NUM_OF_SECTORS)
+	{
+		// Power down happened after the journal record was committed, so finish its writes and look for the files again
+		ret = hel_journal_finish(fs, journal_id);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		ret = hel_discover_files(fs, &journal_id);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		assert(journal_id == NUM_OF_SECTORS);
+	}
+
+	ret = hel_extents_build(fs);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+	
+	return hel_success;
+}
+
+static hel_ret hel_close_unlocked(hel_fs *fs)
+{
+	hel_ret ret;
+
+#if HEL_ASYNC
+	if(hel_async_creates_in_flight(fs))
+	{
+		return hel_busy_err;
+	}
+#endif
+
+	free(fs->used_map);
+	fs->used_map = NULL;
+
+	free(fs->full_words_map);
+	fs->full_words_map = NULL;
+
+	free(fs->empty_words_map);
+	fs->empty_words_map = NULL;
+
+	free(fs->free_extents);
+	fs->free_extents = NULL;
+
+	free(fs->chunks_plan);
+	fs->chunks_plan = NULL;
+	fs->chunks_plan_capacity = 0;
+
+	hel_alloc_groups_free(fs);
+
+#if HEL_LOCKFREE_READS
+	hel_lockfree_retired_free(fs);
+#endif
+
+	ret = fs->driver.mem_close(fs->driver.arg);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_format_unlocked(hel_fs *fs)
+{
+	hel_metadata first_chunk = 0;
+	hel_ret ret;
+
+#if HEL_ASYNC
+	if(hel_async_creates_in_flight(fs))
+	{
+		return hel_busy_err;
+	}
+#endif
+
+	ret = fs->driver.mem_init(fs->driver.arg, &fs->mem_size, &fs->sector_size);
+	if(ret != hel_success)
+	{
+		return ret;
+	}	
+
+	if(fs->sector_size <= sizeof(hel_metadata))
+	{
+		return hel_boundaries_err;
+	}
+	if(fs->mem_size % fs->sector_size != 0)
+	{
+		return hel_boundaries_err;
+	}
+	if(fs->mem_size > MAX_BYTES_NUM)
+	{
+		return hel_boundaries_err;
+	}
+	if(fs->mem_size / fs->sector_size > MAX_SECTORS_NUM)
+	{
+		return hel_boundaries_err;
+	}
+	
+	META_NOT_END_SECTORS_SIZE_SET(first_chunk, fs->mem_size / fs->sector_size);
+	META_IS_START_SET(first_chunk, 0);
+	META_IS_END_SET(first_chunk, 0);
+
+	ret = MEM_WRITE(0, &first_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+		
+	ret = hel_init_unlocked(fs);
+		
+	return ret;
+}
+
+static hel_ret hel_get_space_info_unlocked(hel_fs *fs, hel_space_info *info)
+{
+	HEL_BASE_TYPE largest;
+
+	if(NULL == info)
+	{
+		return hel_param_err;
+	}
+
+	largest = hel_get_largest_free_extent(fs);
+
+	info->free_sectors = fs->free_sectors_num;
+	info->free_chunks_num = fs->free_extents_num;
+	info->largest_free_sectors = largest;
+	info->max_file_size = hel_get_free_bytes(fs);
+	info->max_contiguous_file_size = (largest == 0) ? 0 : (largest * fs->sector_size) - sizeof(hel_metadata);
+
+	return hel_success;
+}
+
+static hel_ret hel_set_alloc_policy_unlocked(hel_fs *fs, hel_alloc_policy policy)
+{
+	switch(policy)
+	{
+		case hel_alloc_first_fit:
+		case hel_alloc_next_fit:
+		case hel_alloc_best_fit:
+		case hel_alloc_worst_fit:
+		case hel_alloc_min_chunks:
+		{
+			fs->alloc_policy = policy;
+			return hel_success;
+		}
+		default:
+		{
+			return hel_param_err;
+		}
+	}
+}
+
+static hel_ret hel_set_alloc_groups_unlocked(hel_fs *fs, HEL_BASE_TYPE groups_num)
+{
+	if((groups_num == 0) || (groups_num > HEL_MAX_ALLOC_GROUPS))
+	{
+		return hel_param_err;
+	}
+
+	fs->alloc_groups_num = groups_num;
+
+	// Before hel_init the groups are built with the index
+	if(fs->free_extents != NULL)
+	{
+		hel_alloc_groups_build(fs);
+	}
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for counting the chunks and data bytes of chain of chunks.
+ *
+ * @param [IN] id - the id of the first chunk in the chain.
+ * @param [OUT] chunks_num - the number of chunks in the chain.
+ * @param [OUT] data_bytes - if not NULL, the number of data bytes in the chain.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_get_chain_info(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE *chunks_num, HEL_BASE_TYPE *data_bytes)
+{
+	hel_metadata curr_chunk;
+	hel_ret ret;
+
+	*chunks_num = 0;
+	if(data_bytes != NULL)
+	{
+		*data_bytes = 0;
+	}
+
+	while(true)
+	{
+		ret = READ_CHUNK_METADATA(id, &curr_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		(*chunks_num)++;
+		if(data_bytes != NULL)
+		{
+			*data_bytes += CHUNK_DATA_BYTES(&curr_chunk);
+		}
+
+		if(META_IS_END_GET(curr_chunk))
+		{
+			return hel_success;
+		}
+
+		id = META_NOT_END_NEXT_GET(curr_chunk);
+	}
+}
+
+/*
+ * @brief internal function for getting the max number of chunks of single file.
+ *
+ * @param [OUT] max_chunks - the max number of chunks, 0 if there are no files.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_get_max_file_chunks(hel_fs *fs, HEL_BASE_TYPE *max_chunks)
+{
+	hel_file_id id;
+	HEL_BASE_TYPE chunks_num;
+	hel_ret ret;
+
+	if(fs->max_file_chunks_dirty)
+	{
+		fs->max_file_chunks = 0;
+
+		ret = hel_get_first_file_unlocked(fs, &id);
+		while(ret == hel_success)
+		{
+			ret = hel_get_chain_info(fs, id, &chunks_num, NULL);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			if(chunks_num > fs->max_file_chunks)
+			{
+				fs->max_file_chunks = chunks_num;
+			}
+
+			ret = hel_iterate_files_unlocked(fs, &id);
+		}
+
+		if(ret != hel_file_not_exist_err)
+		{
+			return ret;
+		}
+
+		fs->max_file_chunks_dirty = false;
+	}
+
+	*max_chunks = fs->max_file_chunks;
+
+	return hel_success;
+}
+
+static hel_ret hel_get_frag_stats_unlocked(hel_fs *fs, hel_frag_stats *stats)
+{
+	HEL_BASE_TYPE largest;
+	hel_ret ret;
+
+	if(NULL == stats)
+	{
+		return hel_param_err;
+	}
+
+	ret = hel_get_max_file_chunks(fs, &stats->max_chunks_per_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	largest = hel_get_largest_free_extent(fs);
+
+	memcpy(stats->free_chunks_hist, fs->free_extents_hist, sizeof(fs->free_extents_hist));
+	stats->largest_free_sectors = largest;
+	stats->files_num = fs->files_num;
+	stats->files_chunks_num = fs->files_chunks_num;
+	stats->avg_chunks_per_file_x100 = (fs->files_num == 0) ? 0 : (HEL_BASE_TYPE)(((uint64_t)fs->files_chunks_num * 100) / fs->files_num);
+	stats->frag_index = (fs->free_sectors_num == 0) ? 0 : (HEL_BASE_TYPE)(((uint64_t)(fs->free_sectors_num - largest) * 100) / fs->free_sectors_num);
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for reading data of chain of chunks.
+ *
+ * @param [IN]  id - the id of the first chunk in the chain.
+ * @param [IN]  read_file - the metadata of the first chunk in the chain.
+ * @param [OUT] _out - buffer to read into it.
+ * @param [IN]  begin - index of byte in the chain data to start read from.
+ * @param [IN]  size - number of bytes to read.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_read_chain(hel_fs *fs, hel_file_id id, hel_metadata read_file, void *_out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+{
+	uint8_t *out = _out;
+	hel_ret ret;
+
+	while(size != 0)
+	{
+		HEL_BASE_TYPE chunk_data_bytes = CHUNK_DATA_BYTES(&read_file);
+		HEL_BASE_TYPE begin_offset = HEL_MIN(chunk_data_bytes, begin);
+		begin -= begin_offset;
+		HEL_BASE_TYPE read_len = (size > chunk_data_bytes - begin_offset) ? chunk_data_bytes - begin_offset: size;
+
+		if(read_len != 0)
+		{
+			ret = MEM_READ((id * fs->sector_size) + sizeof(read_file) + begin_offset, read_len, out);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+		}
+
+		out += read_len;
+		size -= read_len;
+		if(META_IS_END_GET(read_file))
+		{
+			if(size != 0)
+			{
+				return hel_boundaries_err;
+			}
+		}
+		else
+		{
+			id = META_NOT_END_NEXT_GET(read_file);
+			ret = READ_CHUNK_METADATA(id, &read_file);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * @brief internal function for removing file from the extent cache, should be called before changing the chunks of file.
+ *
+ * @param [IN] id - the id of the file.
+ *
+ * @note it also invalidates the read cursors.
+ */
+static void hel_extent_cache_invalidate(hel_fs *fs, hel_file_id id)
+{
+	fs->chunks_generation++;
+
+#if HEL_EXTENT_CACHE_ENTRIES > 0
+	for(HEL_BASE_TYPE i = 0; i < HEL_EXTENT_CACHE_ENTRIES; i++)
+	{
+		if(fs->extent_cache[i].valid && (fs->extent_cache[i].id == id))
+		{
+			fs->extent_cache[i].valid = false;
+		}
+	}
+#else
+	(void)id;
+#endif
+}
+
+#if HEL_EXTENT_CACHE_ENTRIES > 0
+/*
+ * @brief internal function for finding file at the extent cache, it should be called under the cache lock.
+ *
+ * @param [IN] id - the id of the file.
+ *
+ * @return the cache entry of the file, NULL if the file is not cached.
+ */
+static hel_extent_cache_entry *hel_extent_cache_find(hel_fs *fs, hel_file_id id)
+{
+	for(HEL_BASE_TYPE i = 0; i < HEL_EXTENT_CACHE_ENTRIES; i++)
+	{
+		if(fs->extent_cache[i].valid && (fs->extent_cache[i].id == id))
+		{
+			fs->extent_cache[i].last_use = ++fs->extent_cache_clock;
+			return &fs->extent_cache[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief internal function for loading the chunks of file from the memory into extent cache entry that is not in the cache.
+ *
+ * @param [IN]  id - the id of the file.
+ * @param [OUT] entry - the entry to load the file into.
+ *
+ * @return hel_success upon success, hel_not_file_err if id is not file, hel_XXXX_err otherwise.
+ *
+ * @note it reads the metadata of up to HEL_EXTENT_CACHE_MAX_CHUNKS chunks, so it is called without the cache lock.
+ */
+static hel_ret hel_extent_cache_load(hel_fs *fs, hel_file_id id, hel_extent_cache_entry *entry)
+{
+	hel_metadata curr_chunk;
+	HEL_BASE_TYPE total_bytes = 0;
+	hel_ret ret;
+
+	ret = READ_CHUNK_METADATA(id, &curr_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(curr_chunk))
+	{
+		return hel_not_file_err;
+	}
+
+	entry->valid = true;
+	entry->id = id;
+	entry->chunks_num = 0;
+
+	while(true)
+	{
+		total_bytes += CHUNK_DATA_BYTES(&curr_chunk);
+		entry->chunks_ids[entry->chunks_num] = id;
+		entry->chunks_ends[entry->chunks_num] = total_bytes;
+		entry->chunks_num++;
+
+		entry->complete = META_IS_END_GET(curr_chunk);
+		if(entry->complete || (entry->chunks_num == HEL_EXTENT_CACHE_MAX_CHUNKS))
+		{
+			return hel_success;
+		}
+
+		id = META_NOT_END_NEXT_GET(curr_chunk);
+		ret = READ_CHUNK_METADATA(id, &curr_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+}
+
+/*
+ * @brief internal function for putting loaded entry in the cache, in place of the least recently used entry.
+ *        It should be called under the cache lock.
+ *
+ * @param [IN] entry - the loaded entry.
+ *
+ * @note if other reader has put the same file in the cache meanwhile, the cache is not changed.
+ */
+static void hel_extent_cache_install(hel_fs *fs, const hel_extent_cache_entry *entry)
+{
+	hel_extent_cache_entry *victim = &fs->extent_cache[0];
+
+	for(HEL_BASE_TYPE i = 0; i < HEL_EXTENT_CACHE_ENTRIES; i++)
+	{
+		if(fs->extent_cache[i].valid && (fs->extent_cache[i].id == entry->id))
+		{
+			return;
+		}
+
+		if(victim->valid && (!fs->extent_cache[i].valid || (fs->extent_cache[i].last_use < victim->last_use)))
+		{
+			victim = &fs->extent_cache[i];
+		}
+	}
+
+	*victim = *entry;
+	victim->last_use = ++fs->extent_cache_clock;
+}
+
+/*
+ * @brief internal function for finding the first chunk of extent cache entry that ends after begin, or the last chunk if there is no such.
+ *
+ * @param [IN] entry - the cache entry of the file.
+ * @param [IN] begin - index of byte in the file.
+ *
+ * @return the index of the chunk in the entry.
+ */
+static HEL_BASE_TYPE hel_extent_cache_chunk_idx(const hel_extent_cache_entry *entry, HEL_BASE_TYPE begin)
+{
+	HEL_BASE_TYPE low = 0, high = entry->chunks_num - 1;
+
+	while(low < high)
+	{
+		HEL_BASE_TYPE mid = low + ((high - low) / 2);
+
+		if(entry->chunks_ends[mid] > begin)
+		{
+			high = mid;
+		}
+		else
+		{
+			low = mid + 1;
+		}
+	}
+
+	return low;
+}
+
+#if HEL_THREAD_SAFE
+/*
+ * @brief internal function for copying the chunks of extent cache entry that a read needs, it should be called under the cache lock.
+ *
+ * @param [IN]  entry - the cache entry of the file.
+ * @param [IN]  idx - the first chunk the read needs (see hel_extent_cache_chunk_idx).
+ * @param [IN]  begin - index of byte in the file to start read from.
+ * @param [IN]  size - number of bytes to read.
+ * @param [OUT] copy - entry with the same indexes, just the chunks from idx till the read end are set in it.
+ */
+static void hel_extent_cache_copy_range(const hel_extent_cache_entry *entry, HEL_BASE_TYPE idx, HEL_BASE_TYPE begin, HEL_BASE_TYPE size,
+										hel_extent_cache_entry *copy)
+{
+	copy->valid = entry->valid;
+	copy->complete = entry->complete;
+	copy->id = entry->id;
+	copy->chunks_num = entry->chunks_num;
+
+	if(idx != 0)
+	{
+		copy->chunks_ends[idx - 1] = entry->chunks_ends[idx - 1];
+	}
+
+	for(HEL_BASE_TYPE i = idx; i < entry->chunks_num; i++)
+	{
+		copy->chunks_ids[i] = entry->chunks_ids[i];
+		copy->chunks_ends[i] = entry->chunks_ends[i];
+
+		if((entry->chunks_ends[i] > begin) && (entry->chunks_ends[i] - begin >= size))
+		{
+			break;
+		}
+	}
+}
+#endif
+
+/*
+ * @brief internal function for reading file data using its extent cache entry.
+ *
+ * @param [IN]  entry - the cache entry of the file.
+ * @param [IN]  idx - the chunk that begin is at (see hel_extent_cache_chunk_idx).
+ * @param [OUT] _out - buffer to read into it.
+ * @param [IN]  begin - index of byte in the file to start read from.
+ * @param [IN]  size - number of bytes to read.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_extent_cache_read(hel_fs *fs, const hel_extent_cache_entry *entry, HEL_BASE_TYPE idx, void *_out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+{
+	uint8_t *out = _out;
+	hel_ret ret;
+
+	for(; size != 0; idx++)
+	{
+		HEL_BASE_TYPE chunk_start = (idx == 0) ? 0 : entry->chunks_ends[idx - 1];
+
+		if(idx == entry->chunks_num)
+		{
+			return hel_boundaries_err;
+		}
+
+		if(!entry->complete && (idx == entry->chunks_num - 1))
+		{
+			// The rest of the file is not cached, continue by the chunks metadata
+			hel_metadata curr_chunk;
+
+			ret = READ_CHUNK_METADATA(entry->chunks_ids[idx], &curr_chunk);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			return hel_read_chain(fs, entry->chunks_ids[idx], curr_chunk, out, begin - chunk_start, size);
+		}
+
+		if(begin >= entry->chunks_ends[idx])
+		{
+			continue;
+		}
+
+		HEL_BASE_TYPE read_len = HEL_MIN(size, entry->chunks_ends[idx] - begin);
+		ret = MEM_READ((entry->chunks_ids[idx] * fs->sector_size) + sizeof(hel_metadata) + (begin - chunk_start), read_len, out);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		out += read_len;
+		begin += read_len;
+		size -= read_len;
+	}
+
+	return hel_success;
+}
+#endif
+
+/*
+ * @brief internal function for copying the data of chain of chunks to other place in memory.
+ *
+ * @param [IN] id - the id of the first chunk in the chain.
+ * @param [IN] begin - number of data bytes to skip at the start of the chain.
+ * @param [IN] dst_addr - the address to copy the data to.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the data is copied through small buffer on the stack, so the destination should not be part of file (it is not written atomically).
+ */
+static hel_ret hel_copy_chain_data(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE begin, HEL_BASE_TYPE dst_addr)
+{
+	uint8_t buff[HEL_COPY_BUFF_SIZE];
+	hel_metadata curr_chunk;
+	hel_ret ret;
+
+	while(true)
+	{
+		ret = READ_CHUNK_METADATA(id, &curr_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		HEL_BASE_TYPE chunk_data_bytes = CHUNK_DATA_BYTES(&curr_chunk);
+		HEL_BASE_TYPE begin_offset = HEL_MIN(chunk_data_bytes, begin);
+		HEL_BASE_TYPE src_addr = (id * fs->sector_size) + sizeof(hel_metadata) + begin_offset;
+		HEL_BASE_TYPE left_bytes = chunk_data_bytes - begin_offset;
+		begin -= begin_offset;
+		while(left_bytes != 0)
+		{
+			void *write_buff = buff;
+			HEL_BASE_TYPE write_size = HEL_MIN(left_bytes, sizeof(buff));
+
+			ret = MEM_READ(src_addr, write_size, buff);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			ret = MEM_WRITE(dst_addr, NULL, &write_buff, &write_size, 1);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			src_addr += write_size;
+			dst_addr += write_size;
+			left_bytes -= write_size;
+		}
+
+		if(META_IS_END_GET(curr_chunk))
+		{
+			return hel_success;
+		}
+
+		id = META_NOT_END_NEXT_GET(curr_chunk);
+	}
+}
+
+/*
+ * @brief internal function for moving all the chunks of file, except the first one, into single chunk.
+ *
+ * @param [IN] id - the id of the file.
+ * @param [IN] first_chunk - the metadata of the first chunk of the file, it should not be end chunk.
+ * @param [IN] tail_bytes - number of data bytes in the chunks after the first one.
+ * @param [IN] new_tail_id - the first sector of free extent that has room for the tail.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the first chunk is not moved as its place is the file id. The new tail is not part of any file until the first chunk
+ *       is rewritten (atomically) to point to it, and then the old tail chunks are not part of any file, so power down at any
+ *       point leaves the file either with the old tail or with the new one.
+ */
+static hel_ret hel_move_file_tail(hel_fs *fs, hel_file_id id, hel_metadata first_chunk, HEL_BASE_TYPE tail_bytes, hel_file_id new_tail_id)
+{
+	hel_chunk_data new_tail = {new_tail_id, tail_bytes};
+	hel_file_id old_tail_id = META_NOT_END_NEXT_GET(first_chunk);
+	hel_metadata new_tail_chunk = 0, old_tail_chunk;
+	HEL_BASE_TYPE old_tail_chunks_num;
+	hel_ret ret;
+
+	hel_extent_cache_invalidate(fs, id);
+
+	ret = hel_organize_chunks_arr(fs, &new_tail, 1);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_copy_chain_data(fs, old_tail_id, 0, (new_tail_id * fs->sector_size) + sizeof(hel_metadata));
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	META_END_BYTES_SIZE_SET(new_tail_chunk, tail_bytes + sizeof(hel_metadata));
+	META_IS_END_SET(new_tail_chunk, 1);
+	META_IS_START_SET(new_tail_chunk, 0);
+
+	ret = hel_sign_area(fs, &new_tail_chunk, new_tail_id, false, true, NULL);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = MEM_WRITE(new_tail_id * fs->sector_size, &new_tail_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	// From here the file uses the new tail
+	META_NOT_END_NEXT_SET(first_chunk, new_tail_id);
+	ret = MEM_WRITE(id * fs->sector_size, &first_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = READ_CHUNK_METADATA(old_tail_id, &old_tail_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_sign_area(fs, &old_tail_chunk, old_tail_id, true, false, &old_tail_chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	hel_file_account(fs, old_tail_chunks_num + 1, false);
+	hel_file_account(fs, 2, true);
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for growing the first chunk of file over the free sectors after it, so it holds all the file data.
+ *
+ * @param [IN] id - the id of the file.
+ * @param [IN] first_chunk - the metadata of the first chunk of the file, it should not be end chunk.
+ * @param [IN] tail_bytes - number of data bytes in the chunks after the first one.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free chunk for the journal record, hel_XXXX_err otherwise.
+ *
+ * @note the sectors after the first chunk that needed for the tail should be free.
+ *
+ * @note the tail data is copied after the metadata of the free chunk that follows the first chunk, so till the journal
+ *       is committed the file is not changed. The bytes that replace this metadata are written with the journal.
+ */
+static hel_ret hel_defrag_in_place(hel_fs *fs, hel_file_id id, hel_metadata first_chunk, HEL_BASE_TYPE tail_bytes)
+{
+	HEL_BASE_TYPE first_sectors = META_NOT_END_SECTORS_SIZE_GET(first_chunk);
+	HEL_BASE_TYPE total_bytes = CHUNK_DATA_BYTES(&first_chunk) + tail_bytes;
+	HEL_BASE_TYPE grow_sectors = ROUND_UP_DEV(total_bytes + sizeof(hel_metadata), fs->sector_size) - first_sectors;
+	hel_file_id grow_id = id + first_sectors;
+	hel_file_id old_tail_id = META_NOT_END_NEXT_GET(first_chunk);
+	hel_chunk_data grow_area = {grow_id, (grow_sectors * fs->sector_size) - sizeof(hel_metadata)};
+	uint8_t grow_first_bytes[sizeof(hel_metadata)];
+	hel_metadata new_first_chunk = 0, old_tail_chunk;
+	HEL_BASE_TYPE old_tail_chunks_num;
+	journal_op ops[2];
+	hel_ret ret;
+
+	hel_extent_cache_invalidate(fs, id);
+
+	ret = hel_organize_chunks_arr(fs, &grow_area, 1);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_copy_chain_data(fs, old_tail_id, sizeof(hel_metadata), (grow_id * fs->sector_size) + sizeof(hel_metadata));
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = READ_CHUNK_METADATA(old_tail_id, &old_tail_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_read_chain(fs, old_tail_id, old_tail_chunk, grow_first_bytes, 0, HEL_MIN(tail_bytes, sizeof(hel_metadata)));
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	META_END_BYTES_SIZE_SET(new_first_chunk, total_bytes + sizeof(hel_metadata));
+	META_IS_END_SET(new_first_chunk, 1);
+	META_IS_START_SET(new_first_chunk, 1);
+
+	// Signing before the commit, so the journal record will not be taken from there
+	ret = hel_sign_sectors(fs, grow_id, grow_sectors, true);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	// The first chunk grows before its metadata place becomes data
+	ops[0].addr = id * fs->sector_size;
+	ops[0].len = sizeof(new_first_chunk);
+	ops[0].data = &new_first_chunk;
+	ops[1].addr = grow_id * fs->sector_size;
+	ops[1].len = HEL_MIN(tail_bytes, sizeof(hel_metadata));
+	ops[1].data = grow_first_bytes;
+
+	ret = hel_journal_commit(fs, ops, 2);
+	if(ret != hel_success)
+	{
+		if(ret == hel_mem_err)
+		{
+			// Nothing committed
+			hel_sign_sectors(fs, grow_id, grow_sectors, false);
+		}
+
+		return ret;
+	}
+
+	ret = hel_sign_area(fs, &old_tail_chunk, old_tail_id, true, false, &old_tail_chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	hel_file_account(fs, old_tail_chunks_num + 1, false);
+	hel_file_account(fs, 1, true);
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for copying file into single chunk, and switching to the copy.
+ *
+ * @param [IN] id - the id of the file.
+ * @param [IN] first_chunk - the metadata of the first chunk of the file.
+ * @param [IN] total_bytes - number of data bytes in the file.
+ * @param [IN] new_id - the first sector of free extent that has room for the whole file.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free chunk for the journal record, hel_XXXX_err otherwise.
+ *
+ * @note the copy is signed as start of file and the original is signed as not start of file with single journal commit.
+ */
+static hel_ret hel_defrag_to_new_chunk(hel_fs *fs, hel_file_id id, hel_metadata first_chunk, HEL_BASE_TYPE total_bytes, hel_file_id new_id)
+{
+	HEL_BASE_TYPE new_sectors = ROUND_UP_DEV(total_bytes + sizeof(hel_metadata), fs->sector_size);
+	hel_chunk_data new_chunk = {new_id, total_bytes};
+	hel_metadata new_file = 0, old_file = first_chunk;
+	HEL_BASE_TYPE old_chunks_num;
+	journal_op ops[2];
+	hel_ret ret;
+
+	hel_extent_cache_invalidate(fs, id);
+
+	ret = hel_organize_chunks_arr(fs, &new_chunk, 1);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_copy_chain_data(fs, id, 0, (new_id * fs->sector_size) + sizeof(hel_metadata));
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	META_END_BYTES_SIZE_SET(new_file, total_bytes + sizeof(hel_metadata));
+	META_IS_END_SET(new_file, 1);
+	META_IS_START_SET(new_file, 1);
+
+	META_IS_START_SET(old_file, 0);
+
+	// Signing before the commit, so the journal record will not be taken from there
+	ret = hel_sign_sectors(fs, new_id, new_sectors, true);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ops[0].addr = new_id * fs->sector_size;
+	ops[0].len = sizeof(new_file);
+	ops[0].data = &new_file;
+	ops[1].addr = id * fs->sector_size;
+	ops[1].len = sizeof(old_file);
+	ops[1].data = &old_file;
+
+	ret = hel_journal_commit(fs, ops, 2);
+	if(ret != hel_success)
+	{
+		if(ret == hel_mem_err)
+		{
+			// Nothing committed
+			hel_sign_sectors(fs, new_id, new_sectors, false);
+		}
+
+		return ret;
+	}
+
+	ret = hel_sign_area(fs, &first_chunk, id, true, false, &old_chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	hel_file_account(fs, old_chunks_num, false);
+	hel_file_account(fs, 1, true);
+
+	return hel_success;
+}
+
+static hel_ret hel_defrag_file_unlocked(hel_fs *fs, hel_file_id id, hel_file_id *new_id)
+{
+	HEL_BASE_TYPE first_sectors, tail_chunks_num, tail_bytes, total_bytes, needed_sectors, fit_idx;
+	hel_metadata first_chunk;
+	hel_ret ret;
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(id, &first_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(first_chunk))
+	{
+		return hel_not_file_err;
+	}
+
+	if(new_id != NULL)
+	{
+		*new_id = id;
+	}
+
+	if(META_IS_END_GET(first_chunk))
+	{
+		// Already single chunk
+		return hel_success;
+	}
+
+	ret = hel_get_chain_info(fs, META_NOT_END_NEXT_GET(first_chunk), &tail_chunks_num, &tail_bytes);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	first_sectors = META_NOT_END_SECTORS_SIZE_GET(first_chunk);
+	total_bytes = CHUNK_DATA_BYTES(&first_chunk) + tail_bytes;
+	needed_sectors = ROUND_UP_DEV(total_bytes + sizeof(hel_metadata), fs->sector_size);
+
+	// Best option, the file keeps its id and becomes single chunk
+	if(hel_extents_free_sectors_from(fs, id + first_sectors) >= needed_sectors - first_sectors)
+	{
+		ret = hel_defrag_in_place(fs, id, first_chunk, tail_bytes);
+		if(ret != hel_mem_err)
+		{
+			return ret;
+		}
+	}
+
+	if(new_id != NULL)
+	{
+		fit_idx = hel_find_fitting_extent(fs, needed_sectors, hel_alloc_best_fit);
+		if(fit_idx != fs->free_extents_num)
+		{
+			hel_file_id new_chunk_id = fs->free_extents[fit_idx].id;
+
+			ret = hel_defrag_to_new_chunk(fs, id, first_chunk, total_bytes, new_chunk_id);
+			if(ret == hel_success)
+			{
+				*new_id = new_chunk_id;
+			}
+
+			if(ret != hel_mem_err)
+			{
+				return ret;
+			}
+		}
+	}
+
+	if(tail_chunks_num == 1)
+	{
+		// Two chunks is the best that can be done with the same id
+		return hel_success;
+	}
+
+	fit_idx = hel_find_fitting_extent(fs, ROUND_UP_DEV(tail_bytes + sizeof(hel_metadata), fs->sector_size), hel_alloc_best_fit);
+	if(fit_idx == fs->free_extents_num)
+	{
+		return hel_mem_err;
+	}
+
+	return hel_move_file_tail(fs, id, first_chunk, tail_bytes, fs->free_extents[fit_idx].id);
+}
+
+static hel_ret hel_compact_unlocked(hel_fs *fs, HEL_BASE_TYPE budget, bool *done)
+{
+	HEL_BASE_TYPE moved_bytes = 0;
+	hel_metadata first_chunk;
+	hel_file_id id;
+	hel_ret ret;
+
+	if(NULL == done)
+	{
+		return hel_param_err;
+	}
+
+	*done = false;
+
+	if((fs->compact_cursor != 0) && (fs->compact_generation == fs->chunks_generation))
+	{
+		// No file was changed since the last call, so the cursor is still the first chunk of file
+		id = fs->compact_cursor;
+		ret = hel_success;
+	}
+	else
+	{
+		// The file at the cursor may not exist anymore, so the walk starts again and the files before the cursor are skipped
+		ret = hel_get_first_file_unlocked(fs, &id);
+	}
+
+	while(ret == hel_success)
+	{
+		if(id >= fs->compact_cursor)
+		{
+			ret = READ_CHUNK_METADATA(id, &first_chunk);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			if(!META_IS_END_GET(first_chunk))
+			{
+				hel_file_id tail_id = META_NOT_END_NEXT_GET(first_chunk);
+				HEL_BASE_TYPE first_sectors = META_NOT_END_SECTORS_SIZE_GET(first_chunk);
+				HEL_BASE_TYPE tail_chunks_num, tail_bytes, needed_sectors, new_tail_idx;
+				bool in_place;
+
+				ret = hel_get_chain_info(fs, tail_id, &tail_chunks_num, &tail_bytes);
+				if(ret != hel_success)
+				{
+					return ret;
+				}
+
+				// Best option, the file becomes single chunk that fills the free sectors after its first chunk
+				needed_sectors = ROUND_UP_DEV(CHUNK_DATA_BYTES(&first_chunk) + tail_bytes + sizeof(hel_metadata), fs->sector_size);
+				in_place = (hel_extents_free_sectors_from(fs, id + first_sectors) >= needed_sectors - first_sectors);
+
+				// Otherwise the tail is moved to the lowest place it fits in
+				new_tail_idx = hel_find_fitting_extent(fs, ROUND_UP_DEV(tail_bytes + sizeof(hel_metadata), fs->sector_size), hel_alloc_first_fit);
+				if(in_place || ((new_tail_idx != fs->free_extents_num) && ((tail_chunks_num > 1) || (fs->free_extents[new_tail_idx].id < tail_id))))
+				{
+					if((budget != 0) && (moved_bytes != 0) && (moved_bytes + tail_bytes > budget))
+					{
+						// Continue from this file at the next call
+						fs->compact_cursor = id;
+						fs->compact_generation = fs->chunks_generation;
+						return hel_success;
+					}
+
+					ret = hel_mem_err;
+					if(in_place)
+					{
+						ret = hel_defrag_in_place(fs, id, first_chunk, tail_bytes);
+					}
+
+					if(ret == hel_mem_err)
+					{
+						// No room for the journal record, or the file can't grow in place
+						new_tail_idx = hel_find_fitting_extent(fs, ROUND_UP_DEV(tail_bytes + sizeof(hel_metadata), fs->sector_size), hel_alloc_first_fit);
+						if((new_tail_idx != fs->free_extents_num) && ((tail_chunks_num > 1) || (fs->free_extents[new_tail_idx].id < tail_id)))
+						{
+							ret = hel_move_file_tail(fs, id, first_chunk, tail_bytes, fs->free_extents[new_tail_idx].id);
+						}
+					}
+
+					if(ret != hel_success)
+					{
+						return ret;
+					}
+
+					moved_bytes += tail_bytes;
+
+#if HEL_LOCKFREE_READS
+					// The old tail is not linked anymore, so the next files can move to it if no reader started before
+					hel_lockfree_reclaim(fs, hel_success);
+#endif
+				}
+			}
+		}
+
+		ret = hel_iterate_files_unlocked(fs, &id);
+	}
+
+	if(ret != hel_file_not_exist_err)
+	{
+		return ret;
+	}
+
+	fs->compact_cursor = 0;
+	*done = true;
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for writing the data of new file to the chunks that were organized for it.
+ *
+ * @param [IN] new_chunks_arr - the chunks of the file, by their order in the file.
+ * @param [IN] chunks_num - number of chunks in new_chunks_arr.
+ * @param [IN] in - array of buffers to write the data from.
+ * @param [IN] size - array of sizes, of the buffers.
+ * @param [IN] num - the number of buffers.
+ * @param [IN] is_file_start - if the first chunk should be signed as start of file, otherwise all the chunks are free chunks on the memory till the caller links them.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the chunks are written from the last to the first, so when the first chunk is signed as start of file all the file is already written.
+ */
+static hel_ret hel_write_chunks_arr(hel_fs *fs, hel_chunk_data *new_chunks_arr, HEL_BASE_TYPE chunks_num, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, bool is_file_start)
+{
+	HEL_BASE_TYPE curr_idx;
+	hel_ret ret;
+
+	if(num == 0)
+	{
+		// Empty file, single chunk with just metadata
+		return hel_write_to_chunk(fs, 0, new_chunks_arr[0].id, NULL, NULL, 0, is_file_start, true, 0);
+	}
+
+	// We are writing from end to start (due to power down protection), so pointing to the end.
+	curr_idx = num - 1;
+
+	for(HEL_BASE_TYPE i = chunks_num - 1; i != (HEL_BASE_TYPE)-1; i--)
+	{
+		void *buffer_pointer_backup;
+		HEL_BASE_TYPE size_backup;
+		HEL_BASE_TYPE num_of_buffs_to_send = 0;
+		HEL_BASE_TYPE write_size = new_chunks_arr[i].size;
+		HEL_BASE_TYPE write_size_needed = write_size;
+		while(true)
+		{
+			num_of_buffs_to_send++;
+
+			if(write_size_needed > size[curr_idx])
+			{
+				write_size_needed -= size[curr_idx];
+				curr_idx --;
+			}
+			else 
+			{
+				size_backup = size[curr_idx] - write_size_needed;
+				buffer_pointer_backup = in[curr_idx];
+				size[curr_idx]  = write_size_needed;
+				in[curr_idx] = (uint8_t *)in[curr_idx] + size_backup;
+				break;
+			}
+		}
+
+		ret = hel_write_to_chunk(fs, write_size, new_chunks_arr[i].id, in + curr_idx, size + curr_idx, num_of_buffs_to_send, (i == 0) && is_file_start, i == chunks_num - 1, (i == chunks_num - 1)? 0: new_chunks_arr[i + 1].id);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(size_backup == 0)
+		{
+			curr_idx --;
+		}
+		else
+		{
+			size[curr_idx] = size_backup;
+			in[curr_idx] =buffer_pointer_backup;
+		}
+	}
+	
+	return hel_success;
+}
+
+#if HEL_ASYNC
+/*
+ * @brief internal function for starting asynchronous operation of the volume.
+ *
+ * @param [OUT] op - the operation.
+ */
+static void hel_async_init(hel_fs *fs, hel_async_op *op)
+{
+	op->fs = fs;
+	atomic_store(&op->pending, 0);
+	atomic_store(&op->ret, hel_success);
+	atomic_store(&op->finished, false);
+	op->has_start_request = false;
+	op->create = NULL;
+#if HEL_LOCKFREE_READS
+	op->has_reader = false;
+#endif
+	op->requests_num = 0;
+}
+
+/*
+ * @brief internal function for taking free create entry of the volume, for asynchronous create.
+ *        It should be called under the allocator lock (after hel_async_settle, so entries that were settled are free).
+ *
+ * @return the entry, NULL if HEL_ASYNC_MAX_CREATES creates are in progress.
+ */
+static hel_async_create *hel_async_create_get(hel_fs *fs)
+{
+	for(HEL_BASE_TYPE i = 0; i < HEL_ASYNC_MAX_CREATES; i++)
+	{
+		if(atomic_load(&fs->async_creates[i].state) == hel_async_create_free)
+		{
+			fs->async_creates[i].chunks_num = 0;
+			atomic_store(&fs->async_creates[i].state, hel_async_create_in_flight);
+
+			return &fs->async_creates[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * @brief internal function for settling the asynchronous creates that were done since the last call: the created files are counted
+ *        and the chunks of the files that were not created are released. It should be called under the allocator lock, or while
+ *        no other change is running.
+ *
+ * @note the chunks of file that was not created are free chunks on the memory, as its first chunk metadata was not written.
+ */
+static void hel_async_settle(hel_fs *fs)
+{
+	for(HEL_BASE_TYPE i = 0; i < HEL_ASYNC_MAX_CREATES; i++)
+	{
+		hel_async_create *create = &fs->async_creates[i];
+		int state = atomic_load(&create->state);
+
+		if(state == hel_async_create_done)
+		{
+			hel_file_account(fs, create->chunks_num, true);
+		}
+		else if(state == hel_async_create_failed)
+		{
+			hel_sign_chunks_arr(fs, create->chunks, create->chunks_num, false);
+		}
+		else
+		{
+			continue;
+		}
+
+		atomic_store(&create->state, hel_async_create_free);
+	}
+}
+
+/*
+ * @brief internal function for adding request to asynchronous operation.
+ *
+ * @param [INOUT] op - the operation.
+ *
+ * @return the request, NULL if the operation has HEL_ASYNC_MAX_REQUESTS requests.
+ */
+static hel_mem_request *hel_async_add_request(hel_async_op *op)
+{
+	hel_mem_request *request;
+
+	if(op->requests_num == HEL_ASYNC_MAX_REQUESTS)
+	{
+		return NULL;
+	}
+
+	request = &op->requests[op->requests_num];
+	op->requests_num++;
+
+	memset(request, 0, sizeof(*request));
+	request->op = op;
+
+	return request;
+}
+
+/*
+ * @brief internal function for submitting request to the memory driver.
+ *
+ * @param [IN] request - the request.
+ *
+ * @return hel_success if the request was submitted (then it is completed by hel_mem_request_done), hel_XXXX_err otherwise.
+ *
+ * @note if the driver has no asynchronous interface, the request is done and completed before returning.
+ */
+static hel_ret hel_mem_submit(hel_fs *fs, hel_mem_request *request)
+{
+	hel_ret ret;
+
+	if(fs->driver.mem_submit != NULL)
+	{
+		return fs->driver.mem_submit(fs->driver.arg, request);
+	}
+
+	if(request->is_write)
+	{
+		ret = MEM_WRITE(request->v_addr, request->atomic_write, &request->buff, &request->size, (request->buff != NULL) ? 1 : 0);
+	}
+	else
+	{
+		ret = MEM_READ(request->v_addr, request->size, request->buff);
+	}
+
+	hel_mem_request_done(request, ret);
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for completing request of asynchronous operation (or the submitting of all of them, see hel_async_start).
+ *
+ * @param [INOUT] op - the operation.
+ * @param [IN] ret - the result of the request.
+ *
+ * @note after the last request, the first chunk metadata of new file is submitted, and then the operation is done.
+ */
+static void hel_async_complete(hel_async_op *op, hel_ret ret)
+{
+	void (*done)(hel_async_op *op, hel_ret ret);
+	int expected = hel_success;
+
+	if(ret != hel_success)
+	{
+		// Just the first error is kept
+		atomic_compare_exchange_strong(&op->ret, &expected, ret);
+	}
+
+	if(atomic_fetch_sub(&op->pending, 1) != 1)
+	{
+		return;
+	}
+
+	ret = atomic_load(&op->ret);
+
+	if(op->has_start_request && (ret == hel_success))
+	{
+		// All the chunks are written, so the file can be signed as start
+		op->has_start_request = false;
+		atomic_store(&op->pending, 1);
+
+		ret = hel_mem_submit(op->fs, &op->start_request);
+		if(ret != hel_success)
+		{
+			hel_async_complete(op, ret);
+		}
+
+		return;
+	}
+
+	if(op->create != NULL)
+	{
+		// The volume may be used now by other context, so the file is counted or its chunks are released by the kernel later
+		int in_flight = hel_async_create_in_flight;
+
+		// hel_init and hel_format wait for the creates in progress, so the entry is still of this create
+		atomic_compare_exchange_strong(&op->create->state, &in_flight, (ret == hel_success) ? hel_async_create_done : hel_async_create_failed);
+	}
+
+#if HEL_LOCKFREE_READS
+	if(op->has_reader)
+	{
+		hel_lockfree_end_ctx(op->fs, &op->reader);
+	}
+#endif
+
+	// The operation may be reused by the user once it is finished, so nothing of it is used after that
+	done = op->done;
+	atomic_store(&op->finished, true);
+
+	if(done != NULL)
+	{
+		done(op, ret);
+	}
+}
+
+/*
+ * @brief internal function for submitting all the requests of asynchronous operation.
+ *
+ * @param [INOUT] op - the operation.
+ *
+ * @note failure of submit is given as the result of the operation, so done is called anyway.
+ */
+static void hel_async_start(hel_fs *fs, hel_async_op *op)
+{
+	// Additional pending request for the submitting itself, so the operation isn't done before all its requests were submitted
+	atomic_store(&op->pending, op->requests_num + 1);
+
+	for(HEL_BASE_TYPE i = 0; i < op->requests_num; i++)
+	{
+		hel_ret ret = hel_mem_submit(fs, &op->requests[i]);
+		if(ret != hel_success)
+		{
+			hel_async_complete(op, ret);
+		}
+	}
+
+	hel_async_complete(op, hel_success);
+}
+
+/*
+ * @brief internal function for adding the writes of new file to asynchronous operation.
+ *
+ * @param [INOUT] op - the operation.
+ * @param [IN] chunks_arr - the chunks of the file, by their order in the file.
+ * @param [IN] chunks_num - number of chunks in chunks_arr.
+ * @param [IN] in - array of buffers to write the data from.
+ * @param [IN] size - array of sizes, of the buffers.
+ * @param [IN] num - the number of buffers.
+ *
+ * @return hel_success upon success, hel_mem_err if the operation needs more than HEL_ASYNC_MAX_REQUESTS requests.
+ *
+ * @note each request writes part of single buffer, and the first chunk metadata is kept for the end (see hel_async_complete).
+ */
+static hel_ret hel_async_add_file_writes(hel_fs *fs, hel_async_op *op, hel_chunk_data *chunks_arr, HEL_BASE_TYPE chunks_num, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num)
+{
+	HEL_BASE_TYPE buff_idx = 0, buff_offset = 0;
+
+	for(HEL_BASE_TYPE i = 0; i < chunks_num; i++)
+	{
+		HEL_BASE_TYPE chunk_addr = chunks_arr[i].id * fs->sector_size;
+		HEL_BASE_TYPE written = 0;
+		hel_mem_request *request;
+
+		while(written < chunks_arr[i].size)
+		{
+			HEL_BASE_TYPE write_size;
+
+			assert(buff_idx < num);
+
+			if(buff_offset == size[buff_idx])
+			{
+				buff_idx++;
+				buff_offset = 0;
+				continue;
+			}
+
+			request = hel_async_add_request(op);
+			if(request == NULL)
+			{
+				return hel_mem_err;
+			}
+
+			write_size = HEL_MIN(chunks_arr[i].size - written, size[buff_idx] - buff_offset);
+
+			request->is_write = true;
+			request->v_addr = chunk_addr + sizeof(hel_metadata) + written;
+			request->buff = (uint8_t *)in[buff_idx] + buff_offset;
+			request->size = write_size;
+
+			written += write_size;
+			buff_offset += write_size;
+		}
+
+		if(i == 0)
+		{
+			request = &op->start_request;
+			memset(request, 0, sizeof(*request));
+			request->op = op;
+			op->has_start_request = true;
+		}
+		else
+		{
+			request = hel_async_add_request(op);
+			if(request == NULL)
+			{
+				return hel_mem_err;
+			}
+		}
+
+		// Till the first chunk is written as start, the chunks are free chunks on the memory
+		request->is_write = true;
+		request->v_addr = chunk_addr;
+		request->atomic_value = hel_make_chunk_metadata(fs, chunks_arr[i].size, i == 0, i == chunks_num - 1, (i == chunks_num - 1) ? 0 : chunks_arr[i + 1].id);
+		request->atomic_write = &request->atomic_value;
+	}
+
+	return hel_success;
+}
+#endif
+
+/*
+ * @brief internal function for choosing the allocation group of new file, called under the allocator lock.
+ *
+ * @param [IN] size - num of data bytes of the file.
+ *
+ * @return the index of the group, the first group (from next_alloc_group) that no other create uses and has enough free sectors for the file.
+ *         if there is no such group, the first group that no other create uses, and if all are used next_alloc_group.
+ */
+static HEL_BASE_TYPE hel_alloc_group_choose(hel_fs *fs, HEL_BASE_TYPE size)
+{
+	HEL_BASE_TYPE needed_sectors = ROUND_UP_DEV(size + sizeof(hel_metadata), fs->sector_size);
+	HEL_BASE_TYPE chosen = fs->alloc_groups_num, not_used = fs->alloc_groups_num;
+
+	for(HEL_BASE_TYPE i = 0; i < fs->alloc_groups_num; i++)
+	{
+		HEL_BASE_TYPE group_idx = (fs->next_alloc_group + i) % fs->alloc_groups_num;
+
+		if(fs->alloc_groups[group_idx].creators_num != 0)
+		{
+			continue;
+		}
+
+		if(fs->alloc_groups[group_idx].free_sectors_num >= needed_sectors)
+		{
+			chosen = group_idx;
+			break;
+		}
+
+		if(not_used == fs->alloc_groups_num)
+		{
+			not_used = group_idx;
+		}
+	}
+
+	if(chosen == fs->alloc_groups_num)
+	{
+		chosen = (not_used != fs->alloc_groups_num) ? not_used : fs->next_alloc_group;
+	}
+
+	fs->alloc_groups[chosen].creators_num++;
+	fs->next_alloc_group = (chosen + 1) % fs->alloc_groups_num;
+
+	return chosen;
+}
+
+/*
+ * @brief internal function for reserving the chunks of new file, called under the allocator lock and the lock of the group.
+ *
+ * @param [IN] group - the allocation group of the file.
+ * @param [IN] size - num of data bytes of the file.
+ * @param [OUT] chunks_num - number of chunks at the plan of the group.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note after it the chunks are signed as in use in RAM, so they can be written without the allocator lock.
+ */
+static hel_ret hel_alloc_group_reserve(hel_fs *fs, hel_alloc_group *group, HEL_BASE_TYPE size, HEL_BASE_TYPE *chunks_num)
+{
+	hel_ret ret;
+
+#if HEL_LOCKFREE_READS
+	// Readers that ended since the last change may release space for this file
+	hel_lockfree_reclaim(fs, hel_success);
+#endif
+
+	// Fail fast if the file won't fit even when it is split on all the free chunks
+	if(size > hel_get_free_bytes(fs))
+	{
+		return hel_mem_err;
+	}
+
+	ret = hel_chunks_plan_fit(fs, &group->chunks_plan, &group->chunks_plan_capacity);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_get_chunks_for_file(fs, size, group->first_sector, group->chunks_plan, chunks_num);
+	if((ret == hel_mem_err) && (group->first_sector != 0))
+	{
+		// The part of the extent before the group start was not used, so the file may fit when starting from the memory start
+		ret = hel_get_chunks_for_file(fs, size, 0, group->chunks_plan, chunks_num);
+	}
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_organize_chunks_arr(fs, group->chunks_plan, *chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	return hel_sign_chunks_arr(fs, group->chunks_plan, *chunks_num, true);
+}
+
+/*
+ * @brief internal function for creating file at allocation group, called under the lock of the group.
+ *
+ * @param [IN] group - the allocation group of the file.
+ * @param [IN] in - array of buffers to write file data from.
+ * @param [IN] size - array of the sizes of the buffers.
+ * @param [IN] num - the number of buffers.
+ * @param [IN] total_size - num of data bytes of the file.
+ * @param [OUT] out_id - the new file id.
+ * @param [OUT] chunks_num - number of chunks of the new file.
+ * @param [INOUT] op - asynchronous operation to add the writes to, NULL for writing the file now.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_create_in_group(hel_fs *fs, hel_alloc_group *group, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, HEL_BASE_TYPE total_size,
+	hel_file_id *out_id, HEL_BASE_TYPE *chunks_num, hel_async_op *op)
+{
+	hel_ret ret, unlock_ret;
+
+	ret = ALLOC_LOCK();
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_alloc_group_reserve(fs, group, total_size, chunks_num);
+	unlock_ret = ALLOC_UNLOCK();
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+	if(unlock_ret != hel_success)
+	{
+		return unlock_ret;
+	}
+
+#if HEL_ASYNC
+	if(op != NULL)
+	{
+		// The group plan is reused by the next create, so the requests keep their own copy of the chunks
+		ret = hel_async_add_file_writes(fs, op, group->chunks_plan, *chunks_num, in, size, num);
+		if(ret != hel_success)
+		{
+			unlock_ret = ALLOC_LOCK();
+			if(unlock_ret != hel_success)
+			{
+				return unlock_ret;
+			}
+
+			// Nothing was written, so the chunks are just signed back as free
+			hel_sign_chunks_arr(fs, group->chunks_plan, *chunks_num, false);
+			(void)ALLOC_UNLOCK();
+
+			return ret;
+		}
+
+		// The chunks are kept till the create is settled, see hel_async_settle
+		assert(*chunks_num <= HEL_ASYNC_MAX_REQUESTS + 1);
+		memcpy(op->create->chunks, group->chunks_plan, *chunks_num * sizeof(hel_chunk_data));
+		op->create->chunks_num = *chunks_num;
+		*out_id = group->chunks_plan[0].id;
+
+		return hel_success;
+	}
+#endif
+
+	ret = hel_write_chunks_arr(fs, group->chunks_plan, *chunks_num, in, size, num, true);
+	if(ret != hel_success)
+	{
+		/// No need to delete something in case of failure, if not all chunks written so nothing really done.
+
+		return ret;
+	}
+
+	*out_id = group->chunks_plan[0].id;
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for creating file, see hel_create_and_write and hel_create_and_write_async.
+ *
+ * @param [IN] in - array of buffers to write file data from.
+ * @param [IN] size - array of the sizes of the buffers.
+ * @param [IN] num - the number of buffers.
+ * @param [OUT] out_id - the new file id.
+ * @param [INOUT] op - asynchronous operation for the writes, NULL for writing the file now.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_create_file(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id, hel_async_op *op)
+{
+	HEL_BASE_TYPE total_size = 0;
+	HEL_BASE_TYPE chunks_num, group_idx;
+	bool created = false;
+	hel_ret ret, unlock_ret;
+
+	if(NULL == out_id)
+	{
+		return hel_param_err;
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < num; i++)
+	{
+		total_size += size[i];
+	}
+
+	ret = ALLOC_LOCK();
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+#if HEL_ASYNC
+	// The chunks of asynchronous creates that failed can be used by this create
+	hel_async_settle(fs);
+
+	if(op != NULL)
+	{
+		op->create = hel_async_create_get(fs);
+		if(NULL == op->create)
+		{
+			(void)ALLOC_UNLOCK();
+			return hel_busy_err;
+		}
+	}
+#endif
+
+	group_idx = hel_alloc_group_choose(fs, total_size);
+
+	ret = ALLOC_UNLOCK();
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = GROUP_LOCK(group_idx);
+	if(ret == hel_success)
+	{
+		ret = hel_create_in_group(fs, &fs->alloc_groups[group_idx], in, size, num, total_size, out_id, &chunks_num, op);
+		created = (ret == hel_success);
+
+		unlock_ret = GROUP_UNLOCK(group_idx);
+		if(ret == hel_success)
+		{
+			ret = unlock_ret;
+		}
+	}
+
+	// Releasing the group, even upon failure
+	unlock_ret = ALLOC_LOCK();
+	if(unlock_ret != hel_success)
+	{
+		return unlock_ret;
+	}
+
+	fs->alloc_groups[group_idx].creators_num--;
+	if(NULL == op)
+	{
+		if(created)
+		{
+			hel_file_account(fs, chunks_num, true);
+		}
+	}
+#if HEL_ASYNC
+	else if(!created)
+	{
+		atomic_store(&op->create->state, hel_async_create_free);
+	}
+#endif
+
+	unlock_ret = ALLOC_UNLOCK();
+
+	return (ret != hel_success) ? ret : unlock_ret;
+}
+
+static hel_ret hel_create_and_write_unlocked(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id)
+{
+	return hel_create_file(fs, in, size, num, out_id, NULL);
+}
+
+#if HEL_ASYNC
+static hel_ret hel_create_and_write_async_unlocked(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id, hel_async_op *op)
+{
+	hel_ret ret;
+
+	if(NULL == op)
+	{
+		return hel_param_err;
+	}
+
+	hel_async_init(fs, op);
+
+	ret = hel_create_file(fs, in, size, num, out_id, op);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	// The group was released already, so completions that run now don't wait for it
+	hel_async_start(fs, op);
+
+	return hel_success;
+}
+#endif
+
+/*
+ * @brief internal function for getting the number of data bytes of file in batch.
+ *
+ * @param [IN] file - the file.
+ *
+ * @return the number of data bytes.
+ */
+static HEL_BASE_TYPE hel_batch_file_size(hel_batch_file *file)
+{
+	HEL_BASE_TYPE total_size = 0;
+
+	for(HEL_BASE_TYPE i = 0; i < file->num; i++)
+	{
+		total_size += file->size[i];
+	}
+
+	return total_size;
+}
+
+/*
+ * @brief internal function for writing run of files that are created one after the other at start of free extent.
+ *
+ * @param [IN] files - the files of the run.
+ * @param [IN] files_num - number of files in the run.
+ * @param [IN] run_id - the first sector of the run, it should be the first sector of free extent.
+ * @param [IN] run_sectors - number of sectors of all the files in the run.
+ * @param [OUT] out_ids - the ids of the new files.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the free chunk metadata at the start of the run covers all the run till the first file is written, so the other
+ *       files are written first and all the files of the run appear together, by the atomic write of the first file metadata.
+ */
+static hel_ret hel_write_batch_run(hel_fs *fs, hel_batch_file *files, HEL_BASE_TYPE files_num, hel_file_id run_id, HEL_BASE_TYPE run_sectors, hel_file_id *out_ids)
+{
+	hel_chunk_data run = {run_id, (run_sectors * fs->sector_size) - sizeof(hel_metadata)};
+	hel_file_id file_id = run_id;
+	hel_ret ret;
+
+	ret = hel_organize_chunks_arr(fs, &run, 1);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_sign_sectors(fs, run_id, run_sectors, true);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < files_num; i++)
+	{
+		out_ids[i] = file_id;
+		file_id += ROUND_UP_DEV(hel_batch_file_size(&files[i]) + sizeof(hel_metadata), fs->sector_size);
+	}
+
+	// From the last to the first, so the first file is the commit of the run
+	for(HEL_BASE_TYPE i = files_num - 1; i != (HEL_BASE_TYPE)-1; i--)
+	{
+		hel_metadata new_file = 0;
+
+		META_END_BYTES_SIZE_SET(new_file, hel_batch_file_size(&files[i]) + sizeof(hel_metadata));
+		META_IS_END_SET(new_file, 1);
+		META_IS_START_SET(new_file, 1);
+
+		ret = MEM_WRITE(out_ids[i] * fs->sector_size, &new_file, files[i].in, files[i].size, files[i].num);
+		if(ret != hel_success)
+		{
+			// The run isn't committed, so on the memory it is still covered by the free chunk metadata at its start
+			hel_sign_sectors(fs, run_id, run_sectors, false);
+			return ret;
+		}
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < files_num; i++)
+	{
+		hel_file_account(fs, 1, true);
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_create_batch_unlocked(hel_fs *fs, hel_batch_file *files, HEL_BASE_TYPE files_num, hel_file_id *out_ids)
+{
+	HEL_BASE_TYPE extent_idx = 0, file_idx = 0;
+	hel_ret ret;
+
+	if(((NULL == files) || (NULL == out_ids)) && (files_num != 0))
+	{
+		return hel_param_err;
+	}
+
+	while(file_idx < files_num)
+	{
+		HEL_BASE_TYPE run_sectors = 0, run_files_num = 0;
+		HEL_BASE_TYPE file_sectors = ROUND_UP_DEV(hel_batch_file_size(&files[file_idx]) + sizeof(hel_metadata), fs->sector_size);
+
+		// The extents before extent_idx were already used or too small, so each extent is checked once for the whole batch
+		while((extent_idx < fs->free_extents_num) && (fs->free_extents[extent_idx].size < file_sectors))
+		{
+			extent_idx++;
+		}
+
+		if(extent_idx == fs->free_extents_num)
+		{
+			// No free extent fits the file, so it is split like any other file
+			ret = hel_create_and_write_unlocked(fs, files[file_idx].in, files[file_idx].size, files[file_idx].num, &out_ids[file_idx]);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			file_idx++;
+			extent_idx = 0; // The extents were changed
+			continue;
+		}
+
+		// Taking all the next files that fit one after the other in this extent
+		while(file_idx + run_files_num < files_num)
+		{
+			file_sectors = ROUND_UP_DEV(hel_batch_file_size(&files[file_idx + run_files_num]) + sizeof(hel_metadata), fs->sector_size);
+			if(run_sectors + file_sectors > fs->free_extents[extent_idx].size)
+			{
+				break;
+			}
+
+			run_sectors += file_sectors;
+			run_files_num++;
+		}
+
+		ret = hel_write_batch_run(fs, files + file_idx, run_files_num, fs->free_extents[extent_idx].id, run_sectors, out_ids + file_idx);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		// The rest of the extent (if any) stays at extent_idx
+		file_idx += run_files_num;
+	}
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for reserving chunk for streaming writer.
+ *
+ * @param [IN] wanted_sectors - number of sectors to reserve.
+ * @param [OUT] id - the id of the reserved chunk.
+ * @param [OUT] sectors - number of sectors reserved.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free space, hel_XXXX_err otherwise.
+ *
+ * @note the sectors are taken from the smallest free extent that fits them, if there is no such the whole largest free extent
+ *       is taken (it is smaller than wanted_sectors).
+ *       On the memory the reserved chunk is free chunk (with metadata that covers all its sectors), it is signed as in use only at the used map.
+ */
+static hel_ret hel_writer_reserve(hel_fs *fs, HEL_BASE_TYPE wanted_sectors, hel_file_id *id, HEL_BASE_TYPE *sectors)
+{
+	HEL_BASE_TYPE fit_idx;
+	hel_chunk_data chunk;
+	hel_ret ret;
+
+	fit_idx = hel_find_fitting_extent(fs, wanted_sectors, hel_alloc_best_fit);
+	if(fit_idx != fs->free_extents_num)
+	{
+		chunk.size = (wanted_sectors * fs->sector_size) - sizeof(hel_metadata);
+	}
+	else
+	{
+		fit_idx = hel_find_fitting_extent(fs, 1, hel_alloc_worst_fit);
+		if(fit_idx == fs->free_extents_num)
+		{
+			return hel_mem_err;
+		}
+
+		chunk.size = (fs->free_extents[fit_idx].size * fs->sector_size) - sizeof(hel_metadata);
+	}
+
+	chunk.id = fs->free_extents[fit_idx].id;
+
+	ret = hel_organize_chunks_arr(fs, &chunk, 1);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	*id = chunk.id;
+	*sectors = ROUND_UP_DEV(chunk.size + sizeof(hel_metadata), fs->sector_size);
+
+	return hel_sign_sectors(fs, *id, *sectors, true);
+}
+
+/*
+ * @brief internal function for checking that writer is open, and that it was opened after the last hel_init.
+ *
+ * @param [INOUT] writer - the writer, it is closed if it was opened before the last hel_init.
+ *
+ * @return hel_success if the writer can be used, hel_param_err otherwise.
+ *
+ * @note hel_init finds the chunks that the writer reserved free, so writer from before it can't continue.
+ */
+static hel_ret hel_writer_check(hel_fs *fs, hel_writer *writer)
+{
+	if((NULL == writer) || !writer->is_open)
+	{
+		return hel_param_err;
+	}
+
+	if(writer->init_generation != fs->init_generation)
+	{
+		writer->is_open = false;
+		return hel_param_err;
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_write_open_unlocked(hel_fs *fs, hel_writer *writer, HEL_BASE_TYPE size_hint)
+{
+	hel_ret ret;
+
+	if(NULL == writer)
+	{
+		return hel_param_err;
+	}
+
+	writer->is_open = false;
+
+	ret = hel_writer_reserve(fs, (size_hint != 0) ? ROUND_UP_DEV(size_hint + sizeof(hel_metadata), fs->sector_size) : HEL_WRITER_RESERVE_SECTORS,
+		&writer->first_id, &writer->first_sectors);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	writer->first_next = writer->first_id;
+	writer->chunk_id = writer->first_id;
+	writer->chunk_sectors = writer->first_sectors;
+	writer->chunk_bytes = 0;
+	writer->chunks_num = 1;
+	writer->init_generation = fs->init_generation;
+	writer->is_open = true;
+
+	return hel_success;
+}
+
+static hel_ret hel_write_append_unlocked(hel_fs *fs, hel_writer *writer, void *_in, HEL_BASE_TYPE size)
+{
+	uint8_t *in = _in;
+	hel_ret ret;
+
+	ret = hel_writer_check(fs, writer);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	while(size != 0)
+	{
+		HEL_BASE_TYPE chunk_room = (writer->chunk_sectors * fs->sector_size) - sizeof(hel_metadata) - writer->chunk_bytes;
+
+		if(chunk_room == 0)
+		{
+			hel_file_id next_id;
+			HEL_BASE_TYPE next_sectors = HEL_MIN(writer->chunk_sectors * 2, HEL_MAX(hel_get_largest_free_extent(fs) / 2, 1));
+
+			ret = hel_writer_reserve(fs, next_sectors, &next_id, &next_sectors);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			if(writer->chunk_id == writer->first_id)
+			{
+				// The first chunk metadata is written at commit
+				writer->first_next = next_id;
+			}
+			else
+			{
+				// Not start of file, so till commit it is still free chunk
+				hel_metadata full_chunk = 0;
+
+				META_NOT_END_SECTORS_SIZE_SET(full_chunk, writer->chunk_sectors);
+				META_NOT_END_NEXT_SET(full_chunk, next_id);
+				META_IS_END_SET(full_chunk, 0);
+				META_IS_START_SET(full_chunk, 0);
+
+				ret = MEM_WRITE(writer->chunk_id * fs->sector_size, &full_chunk, NULL, NULL, 0);
+				if(ret != hel_success)
+				{
+					return ret;
+				}
+			}
+
+			writer->chunk_id = next_id;
+			writer->chunk_sectors = next_sectors;
+			writer->chunk_bytes = 0;
+			writer->chunks_num++;
+			continue;
+		}
+
+		void *write_buff = in;
+		HEL_BASE_TYPE write_size = HEL_MIN(size, chunk_room);
+
+		ret = MEM_WRITE((writer->chunk_id * fs->sector_size) + sizeof(hel_metadata) + writer->chunk_bytes, NULL, &write_buff, &write_size, 1);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		in += write_size;
+		size -= write_size;
+		writer->chunk_bytes += write_size;
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_write_commit_unlocked(hel_fs *fs, hel_writer *writer, hel_file_id *out_id)
+{
+	HEL_BASE_TYPE needed_sectors;
+	hel_metadata last_chunk = 0;
+	hel_ret ret;
+
+	if(NULL == out_id)
+	{
+		return hel_param_err;
+	}
+
+	ret = hel_writer_check(fs, writer);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	needed_sectors = ROUND_UP_DEV(writer->chunk_bytes + sizeof(hel_metadata), fs->sector_size);
+	if(needed_sectors < writer->chunk_sectors)
+	{
+		// Give back the sectors that were not used, they are covered by the last chunk till its metadata is written
+		hel_metadata rest_chunk = 0;
+
+		META_NOT_END_SECTORS_SIZE_SET(rest_chunk, writer->chunk_sectors - needed_sectors);
+		META_IS_END_SET(rest_chunk, 0);
+		META_IS_START_SET(rest_chunk, 0);
+
+		ret = MEM_WRITE((writer->chunk_id + needed_sectors) * fs->sector_size, &rest_chunk, NULL, NULL, 0);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	META_END_BYTES_SIZE_SET(last_chunk, writer->chunk_bytes + sizeof(hel_metadata));
+	META_IS_END_SET(last_chunk, 1);
+
+	if(writer->chunk_id == writer->first_id)
+	{
+		META_IS_START_SET(last_chunk, 1);
+	}
+	else
+	{
+		hel_metadata first_chunk = 0;
+
+		META_IS_START_SET(last_chunk, 0);
+
+		ret = MEM_WRITE(writer->chunk_id * fs->sector_size, &last_chunk, NULL, NULL, 0);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		META_NOT_END_SECTORS_SIZE_SET(first_chunk, writer->first_sectors);
+		META_NOT_END_NEXT_SET(first_chunk, writer->first_next);
+		META_IS_END_SET(first_chunk, 0);
+		META_IS_START_SET(first_chunk, 1);
+		last_chunk = first_chunk;
+	}
+
+	// From here the file exists
+	ret = MEM_WRITE(writer->first_id * fs->sector_size, &last_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	writer->is_open = false;
+
+	if(needed_sectors < writer->chunk_sectors)
+	{
+		ret = hel_sign_sectors(fs, writer->chunk_id + needed_sectors, writer->chunk_sectors - needed_sectors, false);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	hel_extent_cache_invalidate(fs, writer->first_id);
+	hel_file_account(fs, writer->chunks_num, true);
+	*out_id = writer->first_id;
+
+	return hel_success;
+}
+
+static hel_ret hel_write_abort_unlocked(hel_fs *fs, hel_writer *writer)
+{
+	hel_file_id id, next_id;
+	HEL_BASE_TYPE sectors;
+	hel_ret ret;
+
+	ret = hel_writer_check(fs, writer);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	writer->is_open = false;
+
+	// On the memory all the chunks are already free, just the used map should be updated
+	id = writer->first_id;
+	sectors = writer->first_sectors;
+	next_id = writer->first_next;
+	while(true)
+	{
+		ret = hel_sign_sectors(fs, id, sectors, false);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(id == writer->chunk_id)
+		{
+			return hel_success;
+		}
+
+		id = next_id;
+		if(id == writer->chunk_id)
+		{
+			sectors = writer->chunk_sectors;
+		}
+		else
+		{
+			hel_metadata curr_chunk;
+
+			ret = READ_CHUNK_METADATA(id, &curr_chunk);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			sectors = META_NOT_END_SECTORS_SIZE_GET(curr_chunk);
+			next_id = META_NOT_END_NEXT_GET(curr_chunk);
+		}
+	}
+}
+
+/*
+ * @brief internal function for writing data that is spread over array of buffers, from position in the buffers.
+ *
+ * @param [IN] addr - the address to write to.
+ * @param [IN] len - number of bytes to write.
+ * @param [IN] in - array of buffers to write the data from.
+ * @param [IN] size - array of sizes, of the buffers.
+ * @param [INOUT] buff_idx - the index of the buffer to start from, it is moved after the written data.
+ * @param [INOUT] buff_offset - the offset in the buffer to start from, it is moved after the written data.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the data is written without metadata, so the destination should not be part of file.
+ */
+static hel_ret hel_write_buffs_part(hel_fs *fs, HEL_BASE_TYPE addr, HEL_BASE_TYPE len, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE *buff_idx, HEL_BASE_TYPE *buff_offset)
+{
+	hel_ret ret;
+
+	while(len != 0)
+	{
+		HEL_BASE_TYPE write_size = HEL_MIN(size[*buff_idx] - *buff_offset, len);
+
+		if(write_size != 0)
+		{
+			void *write_buff = (uint8_t *)in[*buff_idx] + *buff_offset;
+
+			ret = MEM_WRITE(addr, NULL, &write_buff, &write_size, 1);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			addr += write_size;
+			len -= write_size;
+			*buff_offset += write_size;
+		}
+
+		if(*buff_offset == size[*buff_idx])
+		{
+			(*buff_idx)++;
+			*buff_offset = 0;
+		}
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_append_unlocked(hel_fs *fs, hel_file_id id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num)
+{
+	HEL_BASE_TYPE total_size = 0, slack_bytes, slack_size, last_sectors, old_chunks_num = 1;
+	HEL_BASE_TYPE buff_idx = 0, buff_offset = 0, chunks_num = 0;
+	hel_chunk_data *new_chunks_arr = NULL;
+	hel_metadata first_chunk, last_chunk;
+	hel_file_id last_id = id;
+	hel_ret ret;
+
+	if(((NULL == in) || (NULL == size)) && (num != 0))
+	{
+		return hel_param_err;
+	}
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(id, &first_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(first_chunk))
+	{
+		return hel_not_file_err;
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < num; i++)
+	{
+		total_size += size[i];
+	}
+
+	if(total_size == 0)
+	{
+		return hel_success;
+	}
+
+	last_chunk = first_chunk;
+	while(!META_IS_END_GET(last_chunk))
+	{
+		last_id = META_NOT_END_NEXT_GET(last_chunk);
+		old_chunks_num++;
+
+		ret = READ_CHUNK_METADATA(last_id, &last_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	// The sectors of the end chunk are rounded up, so there may be room after its data
+	last_sectors = CHUNK_SIZE_IN_SECTORS(&last_chunk);
+	slack_bytes = (last_sectors * fs->sector_size) - META_END_BYTES_SIZE_GET(last_chunk);
+	slack_size = HEL_MIN(slack_bytes, total_size);
+
+	if(total_size > slack_size)
+	{
+		// Fail fast if the rest won't fit even when it is split on all the free chunks
+		if(total_size - slack_size > hel_get_free_bytes(fs))
+		{
+			return hel_mem_err;
+		}
+
+		ret = hel_chunks_plan_fit(fs, &fs->chunks_plan, &fs->chunks_plan_capacity);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		new_chunks_arr = fs->chunks_plan;
+		ret = hel_get_chunks_for_file(fs, total_size - slack_size, 0, new_chunks_arr, &chunks_num);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		ret = hel_organize_chunks_arr(fs, new_chunks_arr, chunks_num);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	hel_extent_cache_invalidate(fs, id);
+
+	// The slack is not part of the file till the end chunk metadata is rewritten
+	ret = hel_write_buffs_part(fs, (last_id * fs->sector_size) + META_END_BYTES_SIZE_GET(last_chunk), slack_size, in, size, &buff_idx, &buff_offset);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	// The new chunks are not signed as start of file, so till they are linked they are free chunks on the memory
+	for(HEL_BASE_TYPE i = 0; i < chunks_num; i++)
+	{
+		hel_metadata new_chunk = 0;
+
+		if(i == chunks_num - 1)
+		{
+			META_END_BYTES_SIZE_SET(new_chunk, new_chunks_arr[i].size + sizeof(hel_metadata));
+			META_IS_END_SET(new_chunk, 1);
+		}
+		else
+		{
+			META_NOT_END_SECTORS_SIZE_SET(new_chunk, ROUND_UP_DEV(new_chunks_arr[i].size + sizeof(hel_metadata), fs->sector_size));
+			META_NOT_END_NEXT_SET(new_chunk, new_chunks_arr[i + 1].id);
+			META_IS_END_SET(new_chunk, 0);
+		}
+
+		META_IS_START_SET(new_chunk, 0);
+
+		ret = hel_sign_area(fs, &new_chunk, new_chunks_arr[i].id, false, true, NULL);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		ret = hel_write_buffs_part(fs, (new_chunks_arr[i].id * fs->sector_size) + sizeof(hel_metadata), new_chunks_arr[i].size, in, size, &buff_idx, &buff_offset);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		ret = MEM_WRITE(new_chunks_arr[i].id * fs->sector_size, &new_chunk, NULL, NULL, 0);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	// Commit, the end chunk grows over its slack or points to the new chunks
+	if(chunks_num == 0)
+	{
+		META_END_BYTES_SIZE_SET(last_chunk, META_END_BYTES_SIZE_GET(last_chunk) + slack_size);
+	}
+	else
+	{
+		META_IS_END_SET(last_chunk, 0);
+		META_NOT_END_SECTORS_SIZE_SET(last_chunk, last_sectors);
+		META_NOT_END_NEXT_SET(last_chunk, new_chunks_arr[0].id);
+	}
+
+	ret = MEM_WRITE(last_id * fs->sector_size, &last_chunk, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(chunks_num != 0)
+	{
+		hel_file_account(fs, old_chunks_num, false);
+		hel_file_account(fs, old_chunks_num + chunks_num, true);
+	}
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for going over the chunks of file that a write to the file data touches.
+ *
+ * @param [IN] id - the id of the file.
+ * @param [IN] offset - offset of the write in the file data.
+ * @param [IN] in - buffer of the write data.
+ * @param [IN] size - number of bytes in the write.
+ * @param [INOUT] addr - if NULL the write pieces are just counted, otherwise each piece is added as write to the journal record from this address.
+ * @param [OUT] ops_num - number of pieces, one for each chunk that the write touches.
+ *
+ * @return hel_success upon success, hel_boundaries_err if the write passes the end of the file, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_write_at_pieces(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE offset, uint8_t *in, HEL_BASE_TYPE size, HEL_BASE_TYPE *addr, HEL_BASE_TYPE *ops_num)
+{
+	hel_metadata curr_chunk;
+	hel_ret ret;
+
+	*ops_num = 0;
+
+	while(true)
+	{
+		ret = READ_CHUNK_METADATA(id, &curr_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		HEL_BASE_TYPE chunk_data_bytes = CHUNK_DATA_BYTES(&curr_chunk);
+		if(offset < chunk_data_bytes)
+		{
+			journal_op op = {(id * fs->sector_size) + sizeof(hel_metadata) + offset, HEL_MIN(chunk_data_bytes - offset, size), in};
+
+			if(addr != NULL)
+			{
+				ret = hel_journal_add(fs, addr, &op);
+				if(ret != hel_success)
+				{
+					return ret;
+				}
+			}
+
+			(*ops_num)++;
+			in += op.len;
+			size -= op.len;
+			offset = 0;
+			if(size == 0)
+			{
+				return hel_success;
+			}
+		}
+		else
+		{
+			offset -= chunk_data_bytes;
+		}
+
+		if(META_IS_END_GET(curr_chunk))
+		{
+			return hel_boundaries_err;
+		}
+
+		id = META_NOT_END_NEXT_GET(curr_chunk);
+	}
+}
+
+static hel_ret hel_write_at_unlocked(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE offset, void *in, HEL_BASE_TYPE size)
+{
+	HEL_BASE_TYPE ops_num, addr;
+	hel_file_id journal_id;
+	hel_metadata first_chunk;
+	hel_ret ret;
+
+	if((NULL == in) && (size != 0))
+	{
+		return hel_param_err;
+	}
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(id, &first_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(first_chunk))
+	{
+		return hel_not_file_err;
+	}
+
+	if(size == 0)
+	{
+		return hel_success;
+	}
+
+	// First just counting, so the record size is known before it is written
+	ret = hel_write_at_pieces(fs, id, offset, in, size, NULL, &ops_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_journal_begin(fs, ops_num, size, &journal_id, &addr);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_write_at_pieces(fs, id, offset, in, size, &addr, &ops_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	// The chunks are not changed, just their data, so the extent cache and read cursors are still valid
+	return hel_journal_end(fs, journal_id, ops_num, size);
+}
+
+/*
+ * @brief internal function for writing new file that is not signed as start of file, so it is not file till the caller signs it.
+ *
+ * @param [IN] in - array of buffers to write the file data from.
+ * @param [IN] size - array of sizes, of the buffers.
+ * @param [IN] num - the number of buffers.
+ * @param [OUT] id - the id of the first chunk.
+ * @param [OUT] chunks_num - number of chunks of the file.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free space, hel_XXXX_err otherwise.
+ *
+ * @note on the memory the chunks are free chunks, they are signed as in use just in the used map (so power down or hel_init frees them).
+ */
+static hel_ret hel_stage_file(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *id, HEL_BASE_TYPE *chunks_num)
+{
+	HEL_BASE_TYPE total_size = 0;
+	hel_chunk_data *new_chunks_arr;
+	hel_ret ret;
+
+	for(HEL_BASE_TYPE i = 0; i < num; i++)
+	{
+		total_size += size[i];
+	}
+
+	// Fail fast if the file won't fit even when it is split on all the free chunks
+	if(total_size > hel_get_free_bytes(fs))
+	{
+		return hel_mem_err;
+	}
+
+	ret = hel_chunks_plan_fit(fs, &fs->chunks_plan, &fs->chunks_plan_capacity);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	new_chunks_arr = fs->chunks_plan;
+	ret = hel_get_chunks_for_file(fs, total_size, 0, new_chunks_arr, chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_organize_chunks_arr(fs, new_chunks_arr, *chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_sign_chunks_arr(fs, new_chunks_arr, *chunks_num, true);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_write_chunks_arr(fs, new_chunks_arr, *chunks_num, in, size, num, false);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	*id = new_chunks_arr[0].id;
+
+	return hel_success;
+}
+
+static hel_ret hel_replace_unlocked(hel_fs *fs, hel_file_id old_id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *new_id)
+{
+	HEL_BASE_TYPE old_chunks_num, chunks_num;
+	hel_metadata old_file, new_file;
+	journal_op ops[2];
+	hel_ret ret;
+
+	if(NULL == new_id)
+	{
+		return hel_param_err;
+	}
+
+	if(old_id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(old_id, &old_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(old_file))
+	{
+		return hel_not_file_err;
+	}
+
+	ret = hel_stage_file(fs, in, size, num, new_id, &chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = READ_CHUNK_METADATA(*new_id, &new_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	META_IS_START_SET(new_file, 1);
+	META_IS_START_SET(old_file, 0);
+
+	ops[0].addr = *new_id * fs->sector_size;
+	ops[0].len = sizeof(new_file);
+	ops[0].data = &new_file;
+	ops[1].addr = old_id * fs->sector_size;
+	ops[1].len = sizeof(old_file);
+	ops[1].data = &old_file;
+
+	ret = hel_journal_commit(fs, ops, 2);
+	if(ret != hel_success)
+	{
+		if(ret == hel_mem_err)
+		{
+			// Nothing committed
+			META_IS_START_SET(new_file, 0);
+			hel_sign_area(fs, &new_file, *new_id, true, false, NULL);
+		}
+
+		return ret;
+	}
+
+	hel_extent_cache_invalidate(fs, old_id);
+
+	META_IS_START_SET(old_file, 1);
+	ret = hel_sign_area(fs, &old_file, old_id, true, false, &old_chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	hel_file_account(fs, old_chunks_num, false);
+	hel_file_account(fs, chunks_num, true);
+
+	return hel_success;
+}
+
+static hel_ret hel_truncate_unlocked(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE new_size)
+{
+	HEL_BASE_TYPE chunks_num = 1, tail_chunks_num = 0, old_sectors, new_sectors;
+	hel_metadata first_chunk, end_chunk, tail_chunk = 0;
+	hel_file_id end_id = id, tail_id = NUM_OF_SECTORS;
+	hel_ret ret;
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(id, &first_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(first_chunk))
+	{
+		return hel_not_file_err;
+	}
+
+	// Finding the chunk that will be the new end chunk, and how many data bytes it keeps
+	end_chunk = first_chunk;
+	while(new_size > CHUNK_DATA_BYTES(&end_chunk))
+	{
+		if(META_IS_END_GET(end_chunk))
+		{
+			return hel_boundaries_err;
+		}
+
+		new_size -= CHUNK_DATA_BYTES(&end_chunk);
+		end_id = META_NOT_END_NEXT_GET(end_chunk);
+		chunks_num++;
+
+		ret = READ_CHUNK_METADATA(end_id, &end_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	if(META_IS_END_GET(end_chunk) && (new_size == CHUNK_DATA_BYTES(&end_chunk)))
+	{
+		// Nothing to truncate
+		return hel_success;
+	}
+
+	if(!META_IS_END_GET(end_chunk))
+	{
+		tail_id = META_NOT_END_NEXT_GET(end_chunk);
+
+		ret = READ_CHUNK_METADATA(tail_id, &tail_chunk);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	old_sectors = CHUNK_SIZE_IN_SECTORS(&end_chunk);
+	new_sectors = ROUND_UP_DEV(new_size + sizeof(hel_metadata), fs->sector_size);
+
+	META_END_BYTES_SIZE_SET(end_chunk, new_size + sizeof(hel_metadata));
+	META_IS_END_SET(end_chunk, 1);
+
+	hel_extent_cache_invalidate(fs, id);
+
+	if(new_sectors == old_sectors)
+	{
+		// From here the file ends at this chunk, and the chunks after it are free chunks on the memory
+		ret = MEM_WRITE(end_id * fs->sector_size, &end_chunk, NULL, NULL, 0);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+	else
+	{
+		hel_metadata split_chunk = 0;
+		journal_op ops[2];
+
+		META_NOT_END_SECTORS_SIZE_SET(split_chunk, old_sectors - new_sectors);
+		META_IS_END_SET(split_chunk, 0);
+		META_IS_START_SET(split_chunk, 0);
+
+		// The sectors after the new end become free chunk, its metadata is written while the old end chunk still covers it
+		ops[0].addr = (end_id + new_sectors) * fs->sector_size;
+		ops[0].len = sizeof(split_chunk);
+		ops[0].data = &split_chunk;
+		ops[1].addr = end_id * fs->sector_size;
+		ops[1].len = sizeof(end_chunk);
+		ops[1].data = &end_chunk;
+
+		ret = hel_journal_commit(fs, ops, 2);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		ret = hel_sign_sectors(fs, end_id + new_sectors, old_sectors - new_sectors, false);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	if(tail_id != NUM_OF_SECTORS)
+	{
+		ret = hel_sign_area(fs, &tail_chunk, tail_id, true, false, &tail_chunks_num);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	hel_file_account(fs, chunks_num + tail_chunks_num, false);
+	hel_file_account(fs, chunks_num, true);
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for checking that transaction is open, and that it was started after the last hel_init.
+ *
+ * @param [INOUT] txn - the transaction, it is closed if it was started before the last hel_init.
+ *
+ * @return hel_success if the transaction can be used, hel_param_err otherwise.
+ *
+ * @note hel_init finds the staged files free, so transaction from before it can't continue.
+ */
+static hel_ret hel_txn_check(hel_fs *fs, hel_txn *txn)
+{
+	if((NULL == txn) || !txn->is_open)
+	{
+		return hel_param_err;
+	}
+
+	if(txn->init_generation != fs->init_generation)
+	{
+		txn->is_open = false;
+		return hel_param_err;
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_txn_begin_unlocked(hel_fs *fs, hel_txn *txn)
+{
+	if(NULL == txn)
+	{
+		return hel_param_err;
+	}
+
+	txn->is_open = true;
+	txn->init_generation = fs->init_generation;
+	txn->creates_num = 0;
+	txn->deletes_num = 0;
+
+	return hel_success;
+}
+
+static hel_ret hel_txn_create_unlocked(hel_fs *fs, hel_txn *txn, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id)
+{
+	HEL_BASE_TYPE chunks_num;
+	hel_ret ret;
+
+	if(NULL == out_id)
+	{
+		return hel_param_err;
+	}
+
+	ret = hel_txn_check(fs, txn);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(txn->creates_num == HEL_TXN_MAX_FILES)
+	{
+		return hel_mem_err;
+	}
+
+	ret = hel_stage_file(fs, in, size, num, out_id, &chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	txn->creates[txn->creates_num++] = *out_id;
+
+	return hel_success;
+}
+
+static hel_ret hel_txn_delete_unlocked(hel_fs *fs, hel_txn *txn, hel_file_id id)
+{
+	hel_metadata del_file;
+	hel_ret ret;
+
+	ret = hel_txn_check(fs, txn);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(id, &del_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(del_file))
+	{
+		return hel_not_file_err;
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < txn->deletes_num; i++)
+	{
+		if(txn->deletes[i] == id)
+		{
+			return hel_param_err;
+		}
+	}
+
+	if(txn->deletes_num == HEL_TXN_MAX_FILES)
+	{
+		return hel_mem_err;
+	}
+
+	txn->deletes[txn->deletes_num++] = id;
+
+	return hel_success;
+}
+
+static hel_ret hel_txn_commit_unlocked(hel_fs *fs, hel_txn *txn)
+{
+	hel_metadata metas[2 * HEL_TXN_MAX_FILES];
+	journal_op ops[2 * HEL_TXN_MAX_FILES];
+	HEL_BASE_TYPE ops_num = 0, chunks_num;
+	hel_ret ret;
+
+	ret = hel_txn_check(fs, txn);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < txn->creates_num; i++)
+	{
+		ret = READ_CHUNK_METADATA(txn->creates[i], &metas[ops_num]);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		META_IS_START_SET(metas[ops_num], 1);
+		ops[ops_num].addr = txn->creates[i] * fs->sector_size;
+		ops[ops_num].len = sizeof(hel_metadata);
+		ops[ops_num].data = &metas[ops_num];
+		ops_num++;
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < txn->deletes_num; i++)
+	{
+		ret = READ_CHUNK_METADATA(txn->deletes[i], &metas[ops_num]);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		// The file may be deleted since it was staged
+		if(!META_IS_START_GET(metas[ops_num]))
+		{
+			return hel_not_file_err;
+		}
+
+		META_IS_START_SET(metas[ops_num], 0);
+		ops[ops_num].addr = txn->deletes[i] * fs->sector_size;
+		ops[ops_num].len = sizeof(hel_metadata);
+		ops[ops_num].data = &metas[ops_num];
+		ops_num++;
+	}
+
+	ret = hel_success;
+	if(ops_num == 1)
+	{
+		// Single metadata write is atomic by itself
+		ret = MEM_WRITE(ops[0].addr, ops[0].data, NULL, NULL, 0);
+	}
+	else if(ops_num > 1)
+	{
+		ret = hel_journal_commit(fs, ops, ops_num);
+	}
+
+	if(ret != hel_success)
+	{
+		// Upon hel_mem_err nothing committed, and the transaction is still open
+		return ret;
+	}
+
+	txn->is_open = false;
+
+	for(HEL_BASE_TYPE i = 0; i < txn->creates_num; i++)
+	{
+		ret = hel_get_chain_info(fs, txn->creates[i], &chunks_num, NULL);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		hel_file_account(fs, chunks_num, true);
+	}
+
+	for(HEL_BASE_TYPE i = 0; i < txn->deletes_num; i++)
+	{
+		hel_metadata *del_file = &metas[txn->creates_num + i];
+
+		hel_extent_cache_invalidate(fs, txn->deletes[i]);
+
+		ret = hel_sign_area(fs, del_file, txn->deletes[i], true, false, &chunks_num);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		hel_file_account(fs, chunks_num, false);
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_txn_abort_unlocked(hel_fs *fs, hel_txn *txn)
+{
+	hel_metadata staged_file;
+	hel_ret ret;
+
+	ret = hel_txn_check(fs, txn);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	txn->is_open = false;
+
+	// On the memory the staged files are already free chunks, just the used map should be updated
+	for(HEL_BASE_TYPE i = 0; i < txn->creates_num; i++)
+	{
+		ret = READ_CHUNK_METADATA(txn->creates[i], &staged_file);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		ret = hel_sign_area(fs, &staged_file, txn->creates[i], true, false, NULL);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_read_unlocked(hel_fs *fs, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+{
+	hel_metadata read_file;
+	hel_ret ret;
+
+	if(id > NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+#if HEL_EXTENT_CACHE_ENTRIES > 0
+	if(id < NUM_OF_SECTORS)
+	{
+		hel_extent_cache_entry loaded, *entry;
+		HEL_BASE_TYPE idx = 0;
+
+		ret = CACHE_LOCK();
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		entry = hel_extent_cache_find(fs, id);
+		if(entry != NULL)
+		{
+			idx = hel_extent_cache_chunk_idx(entry, begin);
+#if HEL_THREAD_SAFE
+			// Other reader may replace the entry while reading the data, so the chunks that are read are copied
+			hel_extent_cache_copy_range(entry, idx, begin, size, &loaded);
+			entry = &loaded;
+#endif
+		}
+
+		ret = CACHE_UNLOCK();
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(NULL == entry)
+		{
+			ret = hel_extent_cache_load(fs, id, &loaded);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			ret = CACHE_LOCK();
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			hel_extent_cache_install(fs, &loaded);
+
+			ret = CACHE_UNLOCK();
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			entry = &loaded;
+			idx = hel_extent_cache_chunk_idx(entry, begin);
+		}
+
+		return hel_extent_cache_read(fs, entry, idx, out, begin, size);
+	}
+#endif
+
+	ret = READ_CHUNK_METADATA(id, &read_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(read_file))
+	{
+		return hel_not_file_err;
+	}
+
+	return hel_read_chain(fs, id, read_file, out, begin, size);
+}
+
+#if HEL_ASYNC
+static hel_ret hel_read_async_unlocked(hel_fs *fs, hel_file_id id, void *_out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size, hel_async_op *op)
+{
+	uint8_t *out = _out;
+	hel_metadata read_file;
+	hel_ret ret;
+
+	if(NULL == op)
+	{
+		return hel_param_err;
+	}
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	hel_async_init(fs, op);
+
+	ret = READ_CHUNK_METADATA(id, &read_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(read_file))
+	{
+		return hel_not_file_err;
+	}
+
+	// Like hel_read_chain, just the data of each chunk is read by request
+	while(size != 0)
+	{
+		HEL_BASE_TYPE chunk_data_bytes = CHUNK_DATA_BYTES(&read_file);
+		HEL_BASE_TYPE begin_offset = HEL_MIN(chunk_data_bytes, begin);
+		begin -= begin_offset;
+		HEL_BASE_TYPE read_len = (size > chunk_data_bytes - begin_offset) ? chunk_data_bytes - begin_offset: size;
+
+		if(read_len != 0)
+		{
+			hel_mem_request *request = hel_async_add_request(op);
+			if(request == NULL)
+			{
+				return hel_mem_err;
+			}
+
+			request->is_write = false;
+			request->v_addr = (id * fs->sector_size) + sizeof(read_file) + begin_offset;
+			request->buff = out;
+			request->size = read_len;
+		}
+
+		out += read_len;
+		size -= read_len;
+		if(META_IS_END_GET(read_file))
+		{
+			if(size != 0)
+			{
+				return hel_boundaries_err;
+			}
+		}
+		else
+		{
+			id = META_NOT_END_NEXT_GET(read_file);
+			ret = READ_CHUNK_METADATA(id, &read_file);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+		}
+	}
+
+#if HEL_LOCKFREE_READS
+	// The file may be deleted after the lock is released, so its chunks are kept till the operation is done
+	ret = hel_lockfree_begin_ctx(fs, &op->reader);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	op->has_reader = true;
+#endif
+
+	hel_async_start(fs, op);
+
+	return hel_success;
+}
+#endif
+
+/*
+ * @brief internal function for moving read cursor to offset in the file.
+ *
+ * @param [INOUT] cursor - the read cursor.
+ * @param [IN] pos - offset in the file data.
+ *
+ * @return hel_success upon success, hel_not_file_err if the file was deleted, hel_boundaries_err if pos is after the end of the file, hel_XXXX_err otherwise.
+ */
+static hel_ret hel_cursor_seek(hel_fs *fs, hel_read_cursor *cursor, HEL_BASE_TYPE pos)
+{
+	hel_ret ret;
+
+	if((cursor->generation != fs->chunks_generation) || (pos < cursor->chunk_start))
+	{
+		// Start again from the first chunk
+		ret = READ_CHUNK_METADATA(cursor->id, &cursor->chunk_meta);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(!META_IS_START_GET(cursor->chunk_meta))
+		{
+			return hel_not_file_err;
+		}
+
+		cursor->chunk_id = cursor->id;
+		cursor->chunk_start = 0;
+		cursor->generation = fs->chunks_generation;
+	}
+
+	while((pos >= cursor->chunk_start + CHUNK_DATA_BYTES(&cursor->chunk_meta)) && !META_IS_END_GET(cursor->chunk_meta))
+	{
+		cursor->chunk_start += CHUNK_DATA_BYTES(&cursor->chunk_meta);
+		cursor->chunk_id = META_NOT_END_NEXT_GET(cursor->chunk_meta);
+
+		ret = READ_CHUNK_METADATA(cursor->chunk_id, &cursor->chunk_meta);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	if(pos > cursor->chunk_start + CHUNK_DATA_BYTES(&cursor->chunk_meta))
+	{
+		// The cursor stays at its last position, which may be before the current chunk, so the next read starts from the first chunk
+		cursor->generation = fs->chunks_generation - 1;
+		return hel_boundaries_err;
+	}
+
+	cursor->pos = pos;
+
+	return hel_success;
+}
+
+static hel_ret hel_open_read_unlocked(hel_fs *fs, hel_file_id id, hel_read_cursor *cursor)
+{
+	if(NULL == cursor)
+	{
+		return hel_param_err;
+	}
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	cursor->id = id;
+	cursor->generation = fs->chunks_generation - 1; // So the seek will start from the first chunk
+
+	return hel_cursor_seek(fs, cursor, 0);
+}
+
+static hel_ret hel_seek_unlocked(hel_fs *fs, hel_read_cursor *cursor, HEL_BASE_TYPE pos)
+{
+	if(NULL == cursor)
+	{
+		return hel_param_err;
+	}
+
+	return hel_cursor_seek(fs, cursor, pos);
+}
+
+static hel_ret hel_read_next_unlocked(hel_fs *fs, hel_read_cursor *cursor, void *_out, HEL_BASE_TYPE size, HEL_BASE_TYPE *read_size)
+{
+	uint8_t *out = _out;
+	hel_ret ret;
+
+	if((NULL == cursor) || (NULL == read_size))
+	{
+		return hel_param_err;
+	}
+
+	*read_size = 0;
+
+	if(cursor->generation != fs->chunks_generation)
+	{
+		ret = hel_cursor_seek(fs, cursor, cursor->pos);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	while(size != 0)
+	{
+		HEL_BASE_TYPE chunk_data_bytes = CHUNK_DATA_BYTES(&cursor->chunk_meta);
+		HEL_BASE_TYPE chunk_offset = cursor->pos - cursor->chunk_start;
+
+		if(chunk_offset == chunk_data_bytes)
+		{
+			if(META_IS_END_GET(cursor->chunk_meta))
+			{
+				// End of file
+				break;
+			}
+
+			// The next chunk metadata is read only when it is needed
+			cursor->chunk_start += chunk_data_bytes;
+			cursor->chunk_id = META_NOT_END_NEXT_GET(cursor->chunk_meta);
+
+			ret = READ_CHUNK_METADATA(cursor->chunk_id, &cursor->chunk_meta);
+			if(ret != hel_success)
+			{
+				return ret;
+			}
+
+			continue;
+		}
+
+		HEL_BASE_TYPE read_len = HEL_MIN(size, chunk_data_bytes - chunk_offset);
+		ret = MEM_READ((cursor->chunk_id * fs->sector_size) + sizeof(hel_metadata) + chunk_offset, read_len, out);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		out += read_len;
+		size -= read_len;
+		cursor->pos += read_len;
+		*read_size += read_len;
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_delete_unlocked(hel_fs *fs, hel_file_id id)
+{
+	hel_metadata del_file, sign_chunk;
+	HEL_BASE_TYPE chunks_num;
+	hel_ret ret;
+
+	if(id > NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(id, &del_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(del_file))
+	{
+		return hel_not_file_err;
+	}
+
+	META_IS_START_SET(del_file, 0);
+
+	hel_extent_cache_invalidate(fs, id);
+
+	// hel_sign_area walks the chain with the chunk it gets, so give it a copy
+	sign_chunk = del_file;
+	ret = hel_sign_area(fs, &sign_chunk, id, true, false, &chunks_num);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = MEM_WRITE(id * fs->sector_size, &del_file, NULL, NULL, 0);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	hel_file_account(fs, chunks_num, false);
+
+	return hel_success;
+}
+
+/*
+ * @brief internal function for comparing files ids, for sorting them.
+ *
+ * @param [IN] a - pointer to first id.
+ * @param [IN] b - pointer to second id.
+ *
+ * @return negative if a is before b, positive if a is after b, 0 if they are equal.
+ */
+static int hel_file_id_compare(const void *a, const void *b)
+{
+	hel_file_id id_a = *(const hel_file_id *)a, id_b = *(const hel_file_id *)b;
+
+	return (id_a > id_b) - (id_a < id_b);
+}
+
+/*
+ * @brief internal function for writing single free chunk metadata over all the free extent that was freed by batch delete.
+ *
+ * @param [IN] extent_idx - the index of the extent.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the metadata of the chunks in the extent are not changed, so every chunk that is not deleted yet can still be read.
+ */
+static hel_ret hel_write_merged_free_chunk(hel_fs *fs, HEL_BASE_TYPE extent_idx)
+{
+	hel_metadata curr_chunk, merged_chunk = 0;
+	hel_ret ret;
+
+	ret = READ_CHUNK_METADATA(fs->free_extents[extent_idx].id, &curr_chunk);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	META_NOT_END_SECTORS_SIZE_SET(merged_chunk, fs->free_extents[extent_idx].size);
+	META_IS_END_SET(merged_chunk, 0);
+	META_IS_START_SET(merged_chunk, 0);
+
+	if(!META_IS_START_GET(curr_chunk) && (CHUNK_SIZE_IN_SECTORS(&curr_chunk) == fs->free_extents[extent_idx].size))
+	{
+		// Already single free chunk
+		return hel_success;
+	}
+
+	return MEM_WRITE(fs->free_extents[extent_idx].id * fs->sector_size, &merged_chunk, NULL, NULL, 0);
+}
+
+static hel_ret hel_delete_batch_unlocked(hel_fs *fs, hel_file_id *ids, HEL_BASE_TYPE ids_num)
+{
+	hel_metadata del_file;
+	HEL_BASE_TYPE chunks_num;
+	hel_ret ret;
+
+	if((NULL == ids) && (ids_num != 0))
+	{
+		return hel_param_err;
+	}
+
+	if(0 == ids_num)
+	{
+		return hel_success;
+	}
+
+	// Checking all the files before changing anything
+	for(HEL_BASE_TYPE i = 0; i < ids_num; i++)
+	{
+		if(ids[i] >= NUM_OF_SECTORS)
+		{
+			return hel_boundaries_err;
+		}
+
+		ret = READ_CHUNK_METADATA(ids[i], &del_file);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		if(!META_IS_START_GET(del_file))
+		{
+			return hel_not_file_err;
+		}
+	}
+
+	qsort(ids, ids_num, sizeof(hel_file_id), hel_file_id_compare);
+
+	for(HEL_BASE_TYPE i = 1; i < ids_num; i++)
+	{
+		if(ids[i] == ids[i - 1])
+		{
+			return hel_param_err;
+		}
+	}
+
+#if HEL_LOCKFREE_READS
+	/*
+	 * The merged free chunks metadata are written over chunks of the deleted files, which lock-free readers may still follow,
+	 * so the files are deleted one by one, which changes just their first chunk.
+	 */
+	for(HEL_BASE_TYPE i = 0; i < ids_num; i++)
+	{
+		ret = hel_delete_unlocked(fs, ids[i]);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	return hel_success;
+#endif
+
+	// First all the chunks are freed at the used map, so the free extents show how the freed chunks merge with their neighbours
+	for(HEL_BASE_TYPE i = 0; i < ids_num; i++)
+	{
+		ret = READ_CHUNK_METADATA(ids[i], &del_file);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		hel_extent_cache_invalidate(fs, ids[i]);
+
+		ret = hel_sign_area(fs, &del_file, ids[i], true, false, &chunks_num);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		hel_file_account(fs, chunks_num, false);
+	}
+
+	// The files that are not at start of free extent are deleted one by one
+	for(HEL_BASE_TYPE i = 0; i < ids_num; i++)
+	{
+		if(fs->free_extents[hel_extents_lower_bound(fs, ids[i], false)].id == ids[i])
+		{
+			continue;
+		}
+
+		ret = READ_CHUNK_METADATA(ids[i], &del_file);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+
+		META_IS_START_SET(del_file, 0);
+		ret = MEM_WRITE(ids[i] * fs->sector_size, &del_file, NULL, NULL, 0);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	/*
+	 * Each extent gets single free chunk metadata. First the extents that start with file, which is deleted by this write,
+	 * and then the rest, as their first chunk may be part of file that was deleted just now.
+	 */
+	for(uint8_t pass = 0; pass < 2; pass++)
+	{
+		HEL_BASE_TYPE i = 0;
+
+		while(i < ids_num)
+		{
+			HEL_BASE_TYPE extent_idx = hel_extents_lower_bound(fs, ids[i], false);
+			bool starts_with_file = (fs->free_extents[extent_idx].id == ids[i]);
+
+			if(starts_with_file == (pass == 0))
+			{
+				ret = hel_write_merged_free_chunk(fs, extent_idx);
+				if(ret != hel_success)
+				{
+					return ret;
+				}
+			}
+
+			while((i < ids_num) && (ids[i] < FREE_EXTENT_END(extent_idx)))
+			{
+				i++;
+			}
+		}
+	}
+
+	return hel_success;
+}
+
+static hel_ret hel_get_first_file_unlocked(hel_fs *fs, hel_file_id *id)
+{
+	hel_ret ret;
+	hel_metadata curr_file;
+
+	ret = READ_CHUNK_METADATA(0, &curr_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+	
+	*id = 0;
+
+	if(META_IS_START_GET(curr_file))
+	{
+		return hel_success;
+	}
+
+	return hel_iterate_files_unlocked(fs, id);
+}
+
+static hel_ret hel_iterate_files_unlocked(hel_fs *fs, hel_file_id *id)
+{
+	hel_ret ret;
+	hel_metadata curr_file;
+	hel_file_id curr_id;
+
+	if(*id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	ret = READ_CHUNK_METADATA(*id, &curr_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	curr_id = *id;
+
+	while(true)
+	{
+		ret = hel_iterator(fs, &curr_file, &curr_id);
+		if(ret != hel_success)
+		{
+			if(ret == hel_mem_err)
+			{
+				return hel_file_not_exist_err;
+			}
+			else
+			{
+				return ret;
+			}
+		}
+
+		if(META_IS_START_GET(curr_file))
+		{
+			*id = curr_id;
+			return hel_success;
+		}
+	}
+}
+
+hel_ret hel_fs_setup(hel_fs *fs, const hel_driver *driver)
+{
+	if((NULL == fs) || (NULL == driver))
+	{
+		return hel_param_err;
+	}
+
+	memset(fs, 0, sizeof(*fs));
+	fs->driver = *driver;
+	fs->alloc_policy = HEL_DEFAULT_ALLOC_POLICY;
+	fs->alloc_groups_num = HEL_DEFAULT_ALLOC_GROUPS;
+
+	return hel_success;
+}
+
+/*
+ * API functions of given volume, see hel_kernel.h.
+ */
+hel_ret hel_format_ctx(hel_fs *fs)
+{
+	HEL_EXCLUSIVE_CALL(hel_format_unlocked(fs));
+}
+
+hel_ret hel_init_ctx(hel_fs *fs)
+{
+	HEL_EXCLUSIVE_CALL(hel_init_unlocked(fs));
+}
+
+hel_ret hel_close_ctx(hel_fs *fs)
+{
+	HEL_EXCLUSIVE_CALL(hel_close_unlocked(fs));
+}
+
+hel_ret hel_get_space_info_ctx(hel_fs *fs, hel_space_info *info)
+{
+	HEL_EXCLUSIVE_CALL(hel_get_space_info_unlocked(fs, info));
+}
+
+hel_ret hel_set_alloc_policy_ctx(hel_fs *fs, hel_alloc_policy policy)
+{
+	HEL_EXCLUSIVE_CALL(hel_set_alloc_policy_unlocked(fs, policy));
+}
+
+hel_ret hel_set_alloc_groups_ctx(hel_fs *fs, HEL_BASE_TYPE groups_num)
+{
+	HEL_EXCLUSIVE_CALL(hel_set_alloc_groups_unlocked(fs, groups_num));
+}
+
+hel_ret hel_get_frag_stats_ctx(hel_fs *fs, hel_frag_stats *stats)
+{
+	HEL_EXCLUSIVE_CALL(hel_get_frag_stats_unlocked(fs, stats));
+}
+
+hel_ret hel_compact_ctx(hel_fs *fs, HEL_BASE_TYPE budget, bool *done)
+{
+	HEL_EXCLUSIVE_CALL(hel_compact_unlocked(fs, budget, done));
+}
+
+hel_ret hel_defrag_file_ctx(hel_fs *fs, hel_file_id id, hel_file_id *new_id)
+{
+	HEL_EXCLUSIVE_CALL(hel_defrag_file_unlocked(fs, id, new_id));
+}
+
+hel_ret hel_create_and_write_ctx(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id)
+{
+	// Creates change the free space state under the allocator lock, so they run in parallel
+	HEL_SHARED_CALL(hel_create_and_write_unlocked(fs, in, size, num, out_id));
+}
+
+#if HEL_ASYNC
+hel_ret hel_create_and_write_async_ctx(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id, hel_async_op *op)
+{
+	HEL_SHARED_CALL(hel_create_and_write_async_unlocked(fs, in, size, num, out_id, op));
+}
+#endif
+
+hel_ret hel_create_batch_ctx(hel_fs *fs, hel_batch_file *files, HEL_BASE_TYPE files_num, hel_file_id *out_ids)
+{
+	HEL_EXCLUSIVE_CALL(hel_create_batch_unlocked(fs, files, files_num, out_ids));
+}
+
+hel_ret hel_write_open_ctx(hel_fs *fs, hel_writer *writer, HEL_BASE_TYPE size_hint)
+{
+	HEL_EXCLUSIVE_CALL(hel_write_open_unlocked(fs, writer, size_hint));
+}
+
+hel_ret hel_write_append_ctx(hel_fs *fs, hel_writer *writer, void *in, HEL_BASE_TYPE size)
+{
+	HEL_EXCLUSIVE_CALL(hel_write_append_unlocked(fs, writer, in, size));
+}
+
+hel_ret hel_write_commit_ctx(hel_fs *fs, hel_writer *writer, hel_file_id *out_id)
+{
+	HEL_EXCLUSIVE_CALL(hel_write_commit_unlocked(fs, writer, out_id));
+}
+
+hel_ret hel_write_abort_ctx(hel_fs *fs, hel_writer *writer)
+{
+	HEL_EXCLUSIVE_CALL(hel_write_abort_unlocked(fs, writer));
+}
+
+hel_ret hel_append_ctx(hel_fs *fs, hel_file_id id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num)
+{
+	HEL_EXCLUSIVE_CALL(hel_append_unlocked(fs, id, in, size, num));
+}
+
+hel_ret hel_write_at_ctx(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE offset, void *in, HEL_BASE_TYPE size)
+{
+	HEL_EXCLUSIVE_CALL(hel_write_at_unlocked(fs, id, offset, in, size));
+}
+
+hel_ret hel_replace_ctx(hel_fs *fs, hel_file_id old_id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *new_id)
+{
+	HEL_EXCLUSIVE_CALL(hel_replace_unlocked(fs, old_id, in, size, num, new_id));
+}
+
+hel_ret hel_truncate_ctx(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE new_size)
+{
+	HEL_EXCLUSIVE_CALL(hel_truncate_unlocked(fs, id, new_size));
+}
+
+hel_ret hel_txn_begin_ctx(hel_fs *fs, hel_txn *txn)
+{
+	HEL_EXCLUSIVE_CALL(hel_txn_begin_unlocked(fs, txn));
+}
+
+hel_ret hel_txn_create_ctx(hel_fs *fs, hel_txn *txn, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id)
+{
+	HEL_EXCLUSIVE_CALL(hel_txn_create_unlocked(fs, txn, in, size, num, out_id));
+}
+
+hel_ret hel_txn_delete_ctx(hel_fs *fs, hel_txn *txn, hel_file_id id)
+{
+	HEL_EXCLUSIVE_CALL(hel_txn_delete_unlocked(fs, txn, id));
+}
+
+hel_ret hel_txn_commit_ctx(hel_fs *fs, hel_txn *txn)
+{
+	HEL_EXCLUSIVE_CALL(hel_txn_commit_unlocked(fs, txn));
+}
+
+hel_ret hel_txn_abort_ctx(hel_fs *fs, hel_txn *txn)
+{
+	HEL_EXCLUSIVE_CALL(hel_txn_abort_unlocked(fs, txn));
+}
+
+hel_ret hel_read_ctx(hel_fs *fs, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+{
+	HEL_SHARED_CALL(hel_read_unlocked(fs, id, out, begin, size));
+}
+
+#if HEL_ASYNC
+hel_ret hel_read_async_ctx(hel_fs *fs, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size, hel_async_op *op)
+{
+	HEL_SHARED_CALL(hel_read_async_unlocked(fs, id, out, begin, size, op));
+}
+#endif
+
+hel_ret hel_open_read_ctx(hel_fs *fs, hel_file_id id, hel_read_cursor *cursor)
+{
+	HEL_SHARED_CALL(hel_open_read_unlocked(fs, id, cursor));
+}
+
+hel_ret hel_read_next_ctx(hel_fs *fs, hel_read_cursor *cursor, void *out, HEL_BASE_TYPE size, HEL_BASE_TYPE *read_size)
+{
+	HEL_SHARED_CALL(hel_read_next_unlocked(fs, cursor, out, size, read_size));
+}
+
+hel_ret hel_seek_ctx(hel_fs *fs, hel_read_cursor *cursor, HEL_BASE_TYPE pos)
+{
+	HEL_SHARED_CALL(hel_seek_unlocked(fs, cursor, pos));
+}
+
+#if HEL_LOCKFREE_READS
+/*
+ * The lock-free reading functions take no lock, they read just the memory and the counters of the readers.
+ */
+hel_ret hel_lockfree_begin_ctx(hel_fs *fs, hel_lockfree_reader *reader)
+{
+	if((NULL == fs) || (NULL == reader))
+	{
+		return hel_param_err;
+	}
+
+	// Even if the epoch advances meanwhile, the next two advances wait for this reader, so no retry is needed
+	reader->readers_idx = atomic_load(&fs->lockfree_epoch) & 1;
+	atomic_fetch_add(&fs->lockfree_readers[reader->readers_idx], 1);
+
+	return hel_success;
+}
+
+hel_ret hel_lockfree_read_ctx(hel_fs *fs, hel_lockfree_reader *reader, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+{
+	hel_metadata read_file;
+	hel_ret ret;
+
+	if((NULL == fs) || (NULL == reader))
+	{
+		return hel_param_err;
+	}
+
+	if(id >= NUM_OF_SECTORS)
+	{
+		return hel_boundaries_err;
+	}
+
+	// The extent cache is changed under lock, so the chunks are found from the memory
+	ret = READ_CHUNK_METADATA(id, &read_file);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	if(!META_IS_START_GET(read_file))
+	{
+		return hel_not_file_err;
+	}
+
+	return hel_read_chain(fs, id, read_file, out, begin, size);
+}
+
+hel_ret hel_lockfree_end_ctx(hel_fs *fs, hel_lockfree_reader *reader)
+{
+	if((NULL == fs) || (NULL == reader))
+	{
+		return hel_param_err;
+	}
+
+	atomic_fetch_sub(&fs->lockfree_readers[reader->readers_idx], 1);
+
+	return hel_success;
+}
+#endif
+
+hel_ret hel_delete_ctx(hel_fs *fs, hel_file_id id)
+{
+	HEL_EXCLUSIVE_CALL(hel_delete_unlocked(fs, id));
+}
+
+hel_ret hel_delete_batch_ctx(hel_fs *fs, hel_file_id *ids, HEL_BASE_TYPE ids_num)
+{
+	HEL_EXCLUSIVE_CALL(hel_delete_batch_unlocked(fs, ids, ids_num));
+}
+
+hel_ret hel_get_first_file_ctx(hel_fs *fs, hel_file_id *id)
+{
+	HEL_SHARED_CALL(hel_get_first_file_unlocked(fs, id));
+}
+
+hel_ret hel_iterate_files_ctx(hel_fs *fs, hel_file_id *id)
+{
+	HEL_SHARED_CALL(hel_iterate_files_unlocked(fs, id));
+}
+
+#if HEL_ASYNC
+/*
+ * The asynchronous operations know their volume, they take no lock as they may be completed from interrupt.
+ */
+hel_ret hel_async_poll(hel_async_op *op, bool *done)
+{
+	if((NULL == op) || (NULL == done))
+	{
+		return hel_param_err;
+	}
+
+	*done = atomic_load(&op->finished);
+
+	return *done ? (hel_ret)atomic_load(&op->ret) : hel_success;
+}
+
+void hel_mem_request_done(hel_mem_request *request, hel_ret ret)
+{
+	hel_async_complete(request->op, ret);
+}
+#endif
+
+#if HEL_DEFAULT_FS
+/*
+ * The default volume uses the link time drivers of mem_driver.h and os_driver.h, they don't need the arg.
+ */
+static hel_ret hel_default_mem_init(void *arg, HEL_BASE_TYPE *size, HEL_BASE_TYPE *sector_size)
+{
+	(void)arg;
+	return mem_driver_init(size, sector_size);
+}
+
+static hel_ret hel_default_mem_close(void *arg)
+{
+	(void)arg;
+	return mem_driver_close();
+}
+
+static hel_ret hel_default_mem_write(void *arg, HEL_BASE_TYPE v_addr, HEL_BASE_TYPE *atomic_write, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE buffs_num)
+{
+	(void)arg;
+	return mem_driver_write(v_addr, atomic_write, in, size, buffs_num);
+}
+
+static hel_ret hel_default_mem_read(void *arg, HEL_BASE_TYPE v_addr, HEL_BASE_TYPE size, void *out)
+{
+	(void)arg;
+	return mem_driver_read(v_addr, size, out);
+}
+
+#if HEL_ASYNC
+static hel_ret hel_default_mem_submit(void *arg, hel_mem_request *request)
+{
+	(void)arg;
+	return mem_driver_submit(request);
+}
+#endif
+
+#if HEL_THREAD_SAFE
+static hel_ret hel_default_lock_shared(void *arg)
+{
+	(void)arg;
+	return os_driver_lock_shared();
+}
+
+static hel_ret hel_default_unlock_shared(void *arg)
+{
+	(void)arg;
+	return os_driver_unlock_shared();
+}
+
+static hel_ret hel_default_lock_exclusive(void *arg)
+{
+	(void)arg;
+	return os_driver_lock_exclusive();
+}
+
+static hel_ret hel_default_unlock_exclusive(void *arg)
+{
+	(void)arg;
+	return os_driver_unlock_exclusive();
+}
+
+static hel_ret hel_default_cache_lock(void *arg)
+{
+	(void)arg;
+	return os_driver_cache_lock();
+}
+
+static hel_ret hel_default_cache_unlock(void *arg)
+{
+	(void)arg;
+	return os_driver_cache_unlock();
+}
+
+static hel_ret hel_default_alloc_lock(void *arg)
+{
+	(void)arg;
+	return os_driver_alloc_lock();
+}
+
+static hel_ret hel_default_alloc_unlock(void *arg)
+{
+	(void)arg;
+	return os_driver_alloc_unlock();
+}
+
+static hel_ret hel_default_group_lock(void *arg, HEL_BASE_TYPE group)
+{
+	(void)arg;
+	return os_driver_group_lock(group);
+}
+
+static hel_ret hel_default_group_unlock(void *arg, HEL_BASE_TYPE group)
+{
+	(void)arg;
+	return os_driver_group_unlock(group);
+}
+#endif
+
+static hel_fs default_fs =
+{
+	.driver =
+	{
+		.arg = NULL,
+		.mem_init = hel_default_mem_init,
+		.mem_close = hel_default_mem_close,
+		.mem_write = hel_default_mem_write,
+		.mem_read = hel_default_mem_read,
+#if HEL_ASYNC
+		.mem_submit = hel_default_mem_submit,
+#endif
+#if HEL_THREAD_SAFE
+		.lock_shared = hel_default_lock_shared,
+		.unlock_shared = hel_default_unlock_shared,
+		.lock_exclusive = hel_default_lock_exclusive,
+		.unlock_exclusive = hel_default_unlock_exclusive,
+		.cache_lock = hel_default_cache_lock,
+		.cache_unlock = hel_default_cache_unlock,
+		.alloc_lock = hel_default_alloc_lock,
+		.alloc_unlock = hel_default_alloc_unlock,
+		.group_lock = hel_default_group_lock,
+		.group_unlock = hel_default_group_unlock,
+#endif
+	},
+	.alloc_policy = HEL_DEFAULT_ALLOC_POLICY,
+	.alloc_groups_num = HEL_DEFAULT_ALLOC_GROUPS,
+};
+
+/*
+ * API functions of the default volume, see hel_kernel.h.
+ */
+hel_ret hel_format()
+{
+	return hel_format_ctx(&default_fs);
+}
+
+hel_ret hel_init()
+{
+	return hel_init_ctx(&default_fs);
+}
+
+hel_ret hel_close()
+{
+	return hel_close_ctx(&default_fs);
+}
+
+hel_ret hel_get_space_info(hel_space_info *info)
+{
+	return hel_get_space_info_ctx(&default_fs, info);
+}
+
+hel_ret hel_set_alloc_policy(hel_alloc_policy policy)
+{
+	return hel_set_alloc_policy_ctx(&default_fs, policy);
+}
+
+hel_ret hel_set_alloc_groups(HEL_BASE_TYPE groups_num)
+{
+	return hel_set_alloc_groups_ctx(&default_fs, groups_num);
+}
+
+hel_ret hel_get_frag_stats(hel_frag_stats *stats)
+{
+	return hel_get_frag_stats_ctx(&default_fs, stats);
+}
+
+hel_ret hel_compact(HEL_BASE_TYPE budget, bool *done)
+{
+	return hel_compact_ctx(&default_fs, budget, done);
+}
+
+hel_ret hel_defrag_file(hel_file_id id, hel_file_id *new_id)
+{
+	return hel_defrag_file_ctx(&default_fs, id, new_id);
+}
+
+hel_ret hel_create_and_write(void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id)
+{
+	return hel_create_and_write_ctx(&default_fs, in, size, num, out_id);
+}
+
+#if HEL_ASYNC
+hel_ret hel_create_and_write_async(void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id, hel_async_op *op)
+{
+	return hel_create_and_write_async_ctx(&default_fs, in, size, num, out_id, op);
+}
+#endif
+
+hel_ret hel_create_batch(hel_batch_file *files, HEL_BASE_TYPE files_num, hel_file_id *out_ids)
+{
+	return hel_create_batch_ctx(&default_fs, files, files_num, out_ids);
+}
+
+hel_ret hel_write_open(hel_writer *writer, HEL_BASE_TYPE size_hint)
+{
+	return hel_write_open_ctx(&default_fs, writer, size_hint);
+}
+
+hel_ret hel_write_append(hel_writer *writer, void *in, HEL_BASE_TYPE size)
+{
+	return hel_write_append_ctx(&default_fs, writer, in, size);
+}
+
+hel_ret hel_write_commit(hel_writer *writer, hel_file_id *out_id)
+{
+	return hel_write_commit_ctx(&default_fs, writer, out_id);
+}
+
+hel_ret hel_write_abort(hel_writer *writer)
+{
+	return hel_write_abort_ctx(&default_fs, writer);
+}
+
+hel_ret hel_append(hel_file_id id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num)
+{
+	return hel_append_ctx(&default_fs, id, in, size, num);
+}
+
+hel_ret hel_write_at(hel_file_id id, HEL_BASE_TYPE offset, void *in, HEL_BASE_TYPE size)
+{
+	return hel_write_at_ctx(&default_fs, id, offset, in, size);
+}
+
+hel_ret hel_replace(hel_file_id old_id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *new_id)
+{
+	return hel_replace_ctx(&default_fs, old_id, in, size, num, new_id);
+}
+
+hel_ret hel_truncate(hel_file_id id, HEL_BASE_TYPE new_size)
+{
+	return hel_truncate_ctx(&default_fs, id, new_size);
+}
+
+hel_ret hel_txn_begin(hel_txn *txn)
+{
+	return hel_txn_begin_ctx(&default_fs, txn);
+}
+
+hel_ret hel_txn_create(hel_txn *txn, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id)
+{
+	return hel_txn_create_ctx(&default_fs, txn, in, size, num, out_id);
+}
+
+hel_ret hel_txn_delete(hel_txn *txn, hel_file_id id)
+{
+	return hel_txn_delete_ctx(&default_fs, txn, id);
+}
+
+hel_ret hel_txn_commit(hel_txn *txn)
+{
+	return hel_txn_commit_ctx(&default_fs, txn);
+}
+
+hel_ret hel_txn_abort(hel_txn *txn)
+{
+	return hel_txn_abort_ctx(&default_fs, txn);
+}
+
+hel_ret hel_read(hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+{
+	return hel_read_ctx(&default_fs, id, out, begin, size);
+}
+
+#if HEL_ASYNC
+hel_ret hel_read_async(hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size, hel_async_op *op)
+{
+	return hel_read_async_ctx(&default_fs, id, out, begin, size, op);
+}
+#endif
+
+hel_ret hel_open_read(hel_file_id id, hel_read_cursor *cursor)
+{
+	return hel_open_read_ctx(&default_fs, id, cursor);
+}
+
+hel_ret hel_read_next(hel_read_cursor *cursor, void *out, HEL_BASE_TYPE size, HEL_BASE_TYPE *read_size)
+{
+	return hel_read_next_ctx(&default_fs, cursor, out, size, read_size);
+}
+
+hel_ret hel_seek(hel_read_cursor *cursor, HEL_BASE_TYPE pos)
+{
+	return hel_seek_ctx(&default_fs, cursor, pos);
+}
+
+#if HEL_LOCKFREE_READS
+hel_ret hel_lockfree_begin(hel_lockfree_reader *reader)
+{
+	return hel_lockfree_begin_ctx(&default_fs, reader);
+}
+
+hel_ret hel_lockfree_read(hel_lockfree_reader *reader, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size)
+{
+	return hel_lockfree_read_ctx(&default_fs, reader, id, out, begin, size);
+}
+
+hel_ret hel_lockfree_end(hel_lockfree_reader *reader)
+{
+	return hel_lockfree_end_ctx(&default_fs, reader);
+}
+#endif
+
+hel_ret hel_delete(hel_file_id id)
+{
+	return hel_delete_ctx(&default_fs, id);
+}
+
+hel_ret hel_delete_batch(hel_file_id *ids, HEL_BASE_TYPE ids_num)
+{
+	return hel_delete_batch_ctx(&default_fs, ids, ids_num);
+}
+
+hel_ret hel_get_first_file(hel_file_id *id)
+{
+	return hel_get_first_file_ctx(&default_fs, id);
+}
+
+hel_ret hel_iterate_files(hel_file_id *id)
+{
+	return hel_iterate_files_ctx(&default_fs, id);
+}
+#endif
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "hel_kernel_user_defines.h"
 
@@ -15,6 +16,7 @@ typedef enum
 	hel_out_of_heap_err, // memory allocation from heap failed
 	hel_file_already_exist_err,
 	hel_file_not_exist_err,
+	hel_busy_err, // Too many operations in progress
 }hel_ret;
 
 #ifndef HEL_BASE_TYPE_BITS
@@ -33,12 +35,421 @@ typedef enum
 
 #define ATOMIC_WRITE_SIZE sizeof(HEL_BASE_TYPE)
 
+#ifndef HEL_THREAD_SAFE
+#define HEL_THREAD_SAFE 0
+#endif
+
+#ifndef HEL_LOCKFREE_READS
+#define HEL_LOCKFREE_READS 0
+#endif
+
+#ifndef HEL_ASYNC
+#define HEL_ASYNC 0
+#endif
+
+#if HEL_LOCKFREE_READS || HEL_ASYNC
+#include <stdatomic.h>
+#endif
+
 typedef HEL_BASE_TYPE hel_file_id;
 
+/*
+ * Policies for choosing where new file is created.
+ */
+typedef enum
+{
+	hel_alloc_first_fit, // Takes the free chunks by their order in memory.
+	hel_alloc_next_fit, // Like first fit, but continues from where the last allocation ended.
+	hel_alloc_best_fit, // Takes the smallest free chunk that the whole file fits in.
+	hel_alloc_worst_fit, // Takes the largest free chunk.
+	hel_alloc_min_chunks, // Splits the file to minimal number of chunks, if the whole file fits in single free chunk it is like best fit.
+}hel_alloc_policy;
+
+/*
+ * Information about the free space of the file system.
+ */
+typedef struct
+{
+	HEL_BASE_TYPE free_sectors; // Number of free sectors.
+	HEL_BASE_TYPE free_chunks_num; // Number of free chunks (runs of consecutive free sectors).
+	HEL_BASE_TYPE largest_free_sectors; // Size in sectors of the largest free chunk.
+	HEL_BASE_TYPE max_file_size; // Max bytes that new file can have (when it is split over all the free chunks).
+	HEL_BASE_TYPE max_contiguous_file_size; // Max bytes that new file can have without being split.
+}hel_space_info;
+
+#ifndef HEL_FREE_HIST_BUCKETS
+#define HEL_FREE_HIST_BUCKETS 16
+#endif
+
+/*
+ * Fragmentation statistics of the file system.
+ */
+typedef struct
+{
+	HEL_BASE_TYPE free_chunks_hist[HEL_FREE_HIST_BUCKETS]; // Bucket i counts the free chunks of [2^i, 2^(i+1)) sectors, the last bucket counts also all the bigger ones.
+	HEL_BASE_TYPE largest_free_sectors; // Size in sectors of the largest free chunk.
+	HEL_BASE_TYPE files_num; // Number of files.
+	HEL_BASE_TYPE files_chunks_num; // Total number of chunks of all the files.
+	HEL_BASE_TYPE avg_chunks_per_file_x100; // Average number of chunks per file, multiplied by 100.
+	HEL_BASE_TYPE max_chunks_per_file; // Max number of chunks of single file.
+	HEL_BASE_TYPE frag_index; // 0-100, the percent of free sectors that are not in the largest free chunk, 0 means all the free space is contiguous.
+}hel_frag_stats;
+
+/*
+ * Cursor for sequential reading of file, it keeps the current chunk so each read continues from where the last one ended.
+ * The fields are internal, use hel_open_read, hel_read_next and hel_seek.
+ */
+typedef struct
+{
+	hel_file_id id; // The file id.
+	hel_file_id chunk_id; // The current chunk.
+	HEL_BASE_TYPE chunk_meta; // The metadata of the current chunk.
+	HEL_BASE_TYPE chunk_start; // Offset in the file data of the current chunk.
+	HEL_BASE_TYPE pos; // Offset in the file data of the next read.
+	HEL_BASE_TYPE generation; // For knowing if files were changed since the last read.
+}hel_read_cursor;
+
+/*
+ * Streaming writer, for creating file without having all its data at once.
+ * The fields are internal, use hel_write_open, hel_write_append, hel_write_commit and hel_write_abort.
+ */
+typedef struct
+{
+	bool is_open;
+	HEL_BASE_TYPE init_generation; // The hel_init of the volume that the writer was opened after.
+	hel_file_id first_id; // The first chunk, which will be the file id.
+	HEL_BASE_TYPE first_sectors; // Number of sectors of the first chunk.
+	hel_file_id first_next; // The chunk after the first one (its metadata is written at commit).
+	hel_file_id chunk_id; // The chunk that is written now.
+	HEL_BASE_TYPE chunk_sectors; // Number of sectors reserved for the current chunk.
+	HEL_BASE_TYPE chunk_bytes; // Number of data bytes written to the current chunk.
+	HEL_BASE_TYPE chunks_num;
+}hel_writer;
+
+/*
+ * File for hel_create_batch, the same buffers as of hel_create_and_write.
+ */
+typedef struct
+{
+	void **in; // Array of buffers to write the file data from.
+	HEL_BASE_TYPE *size; // Array of number of bytes of each buffer.
+	HEL_BASE_TYPE num; // Number of buffers.
+}hel_batch_file;
+
+#ifndef HEL_TXN_MAX_FILES
+#define HEL_TXN_MAX_FILES 8
+#endif
+
+#ifndef HEL_WRITER_RESERVE_SECTORS
+#define HEL_WRITER_RESERVE_SECTORS 4
+#endif
+
+/*
+ * Transaction, for creating and deleting few files as one atomic operation.
+ * The fields are internal, use hel_txn_begin, hel_txn_create, hel_txn_delete, hel_txn_commit and hel_txn_abort.
+ */
+typedef struct
+{
+	bool is_open;
+	HEL_BASE_TYPE init_generation; // The hel_init of the volume that the transaction was started after.
+	HEL_BASE_TYPE creates_num;
+	hel_file_id creates[HEL_TXN_MAX_FILES]; // The staged files, on the memory they are free chunks till commit.
+	HEL_BASE_TYPE deletes_num;
+	hel_file_id deletes[HEL_TXN_MAX_FILES];
+}hel_txn;
+
+#ifndef HEL_DEFAULT_ALLOC_POLICY
+#define HEL_DEFAULT_ALLOC_POLICY hel_alloc_first_fit
+#endif
+
+#ifndef HEL_DEFAULT_FS
+#define HEL_DEFAULT_FS 1
+#endif
+
+#ifndef HEL_MAX_ALLOC_GROUPS
+#define HEL_MAX_ALLOC_GROUPS 8
+#endif
+
+#ifndef HEL_DEFAULT_ALLOC_GROUPS
+#define HEL_DEFAULT_ALLOC_GROUPS 1
+#endif
+
+#ifndef HEL_EXTENT_CACHE_ENTRIES
+#define HEL_EXTENT_CACHE_ENTRIES 4
+#endif
+
+#ifndef HEL_ASYNC_MAX_REQUESTS
+#define HEL_ASYNC_MAX_REQUESTS 16
+#endif
+
+#ifndef HEL_ASYNC_MAX_CREATES
+#define HEL_ASYNC_MAX_CREATES 4
+#endif
+
+#ifndef HEL_EXTENT_CACHE_MAX_CHUNKS
+#define HEL_EXTENT_CACHE_MAX_CHUNKS 16
+#endif
+
+typedef struct hel_async_op hel_async_op;
+
+#if HEL_ASYNC
+/*
+ * Request of the asynchronous memory driver, see mem_driver_submit at mem_driver.h.
+ */
+typedef struct
+{
+	bool is_write;
+	HEL_BASE_TYPE v_addr;
+	HEL_BASE_TYPE *atomic_write; // For write, like at mem_driver_write, NULL if there is no atomic write
+	void *buff; // The data to write, or the buffer to read into
+	HEL_BASE_TYPE size; // Number of bytes at buff
+	HEL_BASE_TYPE atomic_value; // Internal, the storage of the atomic write
+	hel_async_op *op; // Internal, the operation that the request is part of
+}hel_mem_request;
+#endif
+
+/*
+ * Drivers of single volume, the same functions as at mem_driver.h (and os_driver.h when HEL_THREAD_SAFE is set),
+ * with additional arg that is passed to all of them, so the same functions can serve multiple volumes.
+ */
+typedef struct
+{
+	void *arg; // Passed to all the functions, e.g. the memory partition of the volume.
+	hel_ret (*mem_init)(void *arg, HEL_BASE_TYPE *size, HEL_BASE_TYPE *sector_size);
+	hel_ret (*mem_close)(void *arg);
+	hel_ret (*mem_write)(void *arg, HEL_BASE_TYPE v_addr, HEL_BASE_TYPE *atomic_write, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE buffs_num);
+	hel_ret (*mem_read)(void *arg, HEL_BASE_TYPE v_addr, HEL_BASE_TYPE size, void *out);
+#if HEL_ASYNC
+	hel_ret (*mem_submit)(void *arg, hel_mem_request *request); // May be NULL, then the asynchronous functions use mem_read/mem_write
+#endif
+#if HEL_THREAD_SAFE
+	hel_ret (*lock_shared)(void *arg);
+	hel_ret (*unlock_shared)(void *arg);
+	hel_ret (*lock_exclusive)(void *arg);
+	hel_ret (*unlock_exclusive)(void *arg);
+	hel_ret (*cache_lock)(void *arg);
+	hel_ret (*cache_unlock)(void *arg);
+	hel_ret (*alloc_lock)(void *arg);
+	hel_ret (*alloc_unlock)(void *arg);
+	hel_ret (*group_lock)(void *arg, HEL_BASE_TYPE group);
+	hel_ret (*group_unlock)(void *arg, HEL_BASE_TYPE group);
+#endif
+}hel_driver;
+
+/*
+ * The used map holds bit per sector, it is stored in 64 bit words so the scans can skip whole words at a time.
+ * The bits after the last sector (in the last word) are always signed as used, so scans stops there naturally.
+ */
+typedef uint64_t hel_map_word;
+
+typedef struct
+{
+	hel_file_id id;
+	HEL_BASE_TYPE size;
+}hel_chunk_data;
+
+/*
+ * The free extents index, sorted array of all the runs of free sectors (by their first sector id).
+ * It is built at hel_init and updated with the used map, so allocation doesn't need to scan the used map.
+ */
+typedef struct
+{
+	hel_file_id id; // first sector of the run
+	HEL_BASE_TYPE size; // number of sectors in the run
+}hel_free_extent;
+
+/*
+ * Allocation group, range of sectors where new files are created first, so creators from different threads allocate at different places.
+ * Each group has its own lock, its own free sectors counter and its own plan array, so the creators share only the short reservation of the chunks.
+ */
+typedef struct
+{
+	hel_file_id first_sector;
+	hel_file_id end_sector;
+	HEL_BASE_TYPE free_sectors_num;
+	HEL_BASE_TYPE creators_num; // Creators that chose the group and not finished yet
+	hel_chunk_data *chunks_plan; // Like the chunks plan of the volume, grows upon need while the group lock is held
+	HEL_BASE_TYPE chunks_plan_capacity;
+}hel_alloc_group;
+
+#if HEL_LOCKFREE_READS
+/*
+ * Range of sectors that was freed while lock-free readers may still read it, see hel_lockfree_begin.
+ * It is signed as free at the used map only after all the readers that started before it was freed have ended.
+ */
+typedef struct
+{
+	hel_file_id id;
+	HEL_BASE_TYPE size;
+	unsigned int epoch; // The epoch of the volume when the range was freed
+}hel_retired_range;
+
+/*
+ * Lock-free reader of volume, see hel_lockfree_begin.
+ */
+typedef struct
+{
+	unsigned int readers_idx; // The readers counter of the volume that this reader is counted at
+}hel_lockfree_reader;
+#endif
+
+/*
+ * The extent cache holds the chunks of recently read files, so read can find the chunk of some offset without reading
+ * the metadata of all the chunks before it. Files with more chunks than HEL_EXTENT_CACHE_MAX_CHUNKS are cached partially.
+ * Every operation that changes the chunks of file removes it from the cache.
+ */
+typedef struct
+{
+	bool valid;
+	bool complete; // false if the file has more chunks after the last cached one
+	hel_file_id id;
+	HEL_BASE_TYPE chunks_num;
+	HEL_BASE_TYPE last_use;
+	hel_file_id chunks_ids[HEL_EXTENT_CACHE_MAX_CHUNKS];
+	HEL_BASE_TYPE chunks_ends[HEL_EXTENT_CACHE_MAX_CHUNKS]; // Offset in the file data of the end of each chunk
+}hel_extent_cache_entry;
+
+#if HEL_ASYNC
+typedef enum
+{
+	hel_async_create_free,
+	hel_async_create_in_flight,
+	hel_async_create_done, // The file was created, it is not counted yet
+	hel_async_create_failed, // The file was not created, its chunks are still reserved
+}hel_async_create_state;
+
+/*
+ * Asynchronous create that the volume tracks till its reservation is settled. The operation is done from the completion of the
+ * last request (may be interrupt) and then it may be reused, so the completion just sets the state, and the kernel counts the file
+ * or releases its chunks at its next call.
+ */
+typedef struct
+{
+	atomic_int state; // hel_async_create_state
+	HEL_BASE_TYPE chunks_num;
+	hel_chunk_data chunks[HEL_ASYNC_MAX_REQUESTS + 1]; // Each chunk but the first has request for its metadata
+}hel_async_create;
+#endif
+
+/*
+ * Volume of the file system, all the RAM state of the kernel for single memory.
+ * The fields are internal, set it up with hel_fs_setup and then use the _ctx functions.
+ * Different volumes share nothing, so they can be used from different threads also without HEL_THREAD_SAFE.
+ */
+typedef struct
+{
+	hel_driver driver;
+
+	HEL_BASE_TYPE mem_size;
+	HEL_BASE_TYPE sector_size;
+
+	hel_map_word *used_map;
+
+	/*
+	 * Summary of the used map, with bit per used map word, so scans can skip whole regions of full/empty words.
+	 * The bits after the last used map word are always set at the full words map and unset at the empty words map.
+	 */
+	hel_map_word *full_words_map; // Bit is set if all the sectors of the used map word are in use
+	hel_map_word *empty_words_map; // Bit is set if all the sectors of the used map word are free
+
+	hel_free_extent *free_extents;
+	HEL_BASE_TYPE free_extents_num;
+	HEL_BASE_TYPE free_extents_capacity;
+
+	/*
+	 * Scratch array for the chunks of file that being created, as every free extent is used at most once for file,
+	 * it is grown to the capacity of the free extents index before planning. It is never moved while planned chunks are
+	 * used, though signing them may grow the index.
+	 */
+	hel_chunk_data *chunks_plan;
+	HEL_BASE_TYPE chunks_plan_capacity;
+
+	/*
+	 * Counters of the free space, updated with the free extents index.
+	 * The largest extent can't be updated in O(1) when it shrinks, so then it is marked as dirty and found again upon need.
+	 */
+	HEL_BASE_TYPE free_sectors_num;
+	HEL_BASE_TYPE largest_free_extent;
+	bool largest_free_extent_dirty;
+	HEL_BASE_TYPE free_extents_hist[HEL_FREE_HIST_BUCKETS]; // Bucket i counts the extents of [2^i, 2^(i+1)) sectors
+
+	/*
+	 * Counters of the files, updated upon each create/delete.
+	 * Like the largest extent, the max chunks per file is found again (by walking the files) only after file with max chunks deleted.
+	 */
+	HEL_BASE_TYPE files_num;
+	HEL_BASE_TYPE files_chunks_num;
+	HEL_BASE_TYPE max_file_chunks;
+	bool max_file_chunks_dirty;
+
+	hel_alloc_policy alloc_policy;
+	hel_file_id next_fit_sector; // where the next fit policy continues from
+
+	hel_alloc_group alloc_groups[HEL_MAX_ALLOC_GROUPS];
+	HEL_BASE_TYPE alloc_groups_num;
+	HEL_BASE_TYPE alloc_group_sectors; // Number of sectors at each group, the last group may be smaller
+	HEL_BASE_TYPE next_alloc_group; // Where the search for not busy group starts, so the creates are spread over the groups
+
+	hel_file_id compact_cursor; // where hel_compact continues from, files before it were already handled at the current pass
+	HEL_BASE_TYPE compact_generation; // chunks_generation when hel_compact stopped, if it wasn't changed the walk continues from the cursor
+
+	HEL_BASE_TYPE chunks_generation; // Changed upon every change of files chunks, so read cursors know they should find their place again
+	HEL_BASE_TYPE init_generation; // Changed upon every hel_init, so writers and transactions from before it are rejected
+
+#if HEL_EXTENT_CACHE_ENTRIES > 0
+	hel_extent_cache_entry extent_cache[HEL_EXTENT_CACHE_ENTRIES];
+	HEL_BASE_TYPE extent_cache_clock;
+#endif
+
+#if HEL_LOCKFREE_READS
+	/*
+	 * Lock-free readers are counted by the parity of the epoch when they started. The epoch advances only when no reader
+	 * is counted at the other parity, so after two advances all the readers that started before some range was freed have ended.
+	 */
+	atomic_uint lockfree_epoch;
+	atomic_uint lockfree_readers[2];
+	hel_retired_range *retired;
+	HEL_BASE_TYPE retired_num;
+	HEL_BASE_TYPE retired_capacity;
+#endif
+
+#if HEL_ASYNC
+	hel_async_create async_creates[HEL_ASYNC_MAX_CREATES];
+#endif
+}hel_fs;
+
+#if HEL_ASYNC
+/*
+ * Asynchronous operation, see hel_read_async and hel_create_and_write_async.
+ * Set done and context before starting the operation, the other fields are internal.
+ * done is called from the context that completed the last request (may be interrupt, or the starting call itself when the driver
+ * has no mem_submit), so it should not call the functions of the volume.
+ */
+struct hel_async_op
+{
+	void (*done)(hel_async_op *op, hel_ret ret); // Called with the result when the operation is done, may be NULL when polling by hel_async_poll
+	void *context; // For the user of the operation
+
+	hel_fs *fs;
+	atomic_uint pending; // Requests that were not completed yet
+	atomic_int ret; // The first error of the requests
+	atomic_bool finished;
+	bool has_start_request;
+	hel_mem_request start_request; // The first chunk metadata of new file, submitted after all the other requests are done
+	hel_async_create *create; // The create that the operation writes, NULL for read
+#if HEL_LOCKFREE_READS
+	bool has_reader;
+	hel_lockfree_reader reader; // Keeps the chunks of the file that is read from reuse till the operation is done
+#endif
+	HEL_BASE_TYPE requests_num;
+	hel_mem_request requests[HEL_ASYNC_MAX_REQUESTS];
+};
+#endif
+
 /*
  * @brief formats the file system
  * 
- * @return hel_success upon success, hel_XXXX_err otherwise.
+ * @return hel_success upon success, hel_busy_err if asynchronous create is in progress (HEL_ASYNC), hel_XXXX_err otherwise.
  *
  * @note there is no need to run hel_init after running this.
  */
@@ -47,17 +458,108 @@ hel_ret hel_format();
 /*
  * @brief init the file system data, it should be called before using the file system,
  *
- * @return hel_success upon success, hel_XXXX_err otherwise.
+ * @return hel_success upon success, hel_busy_err if asynchronous create is in progress (HEL_ASYNC), hel_XXXX_err otherwise.
  */
 hel_ret hel_init();
 
 /*
  * @brief free all memory allocated at hel_init.
  *
- * @return hel_success upon success, hel_XXXX_err otherwise.
+ * @return hel_success upon success, hel_busy_err if asynchronous create is in progress (HEL_ASYNC), hel_XXXX_err otherwise.
  */
 hel_ret hel_close();
 
+/*
+ * @brief get information about the free space.
+ *
+ * @param [OUT] info - the free space information.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the counters are updated upon each create/delete, so this is O(1) except after the largest free chunk was used,
+ *       then it is searched again over the free chunks.
+ */
+hel_ret hel_get_space_info(hel_space_info *info);
+
+/*
+ * @brief set the policy of choosing where new files are created.
+ *
+ * @param [IN] policy - the allocation policy.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the policy resets to HEL_DEFAULT_ALLOC_POLICY at hel_init.
+ *
+ * @note policies (except hel_alloc_min_chunks) that cannot fit the file in single free chunk falls back to splitting it on the free chunks by their order.
+ */
+hel_ret hel_set_alloc_policy(hel_alloc_policy policy);
+
+/*
+ * @brief set the number of allocation groups, the memory is split to equal ranges of sectors and each create chooses a group
+ *        that no other create uses now (by round robin), so creates from different threads write to different places in parallel.
+ *
+ * @param [IN] groups_num - number of groups, between 1 and HEL_MAX_ALLOC_GROUPS.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the number resets to HEL_DEFAULT_ALLOC_GROUPS at hel_init.
+ *
+ * @note the group is used by the first fit policy, the file starts at the first free sector of the group and spills to the next groups
+ *       only if it doesn't fit there. Other policies choose over the whole memory.
+ */
+hel_ret hel_set_alloc_groups(HEL_BASE_TYPE groups_num);
+
+/*
+ * @brief get fragmentation statistics.
+ *
+ * @param [OUT] stats - the fragmentation statistics.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the counters are updated upon each create/delete, except the max chunks per file which is found again
+ *       by walking all the files after the file with max chunks was deleted.
+ */
+hel_ret hel_get_frag_stats(hel_frag_stats *stats);
+
+/*
+ * @brief compact the file system, moves the chunks of files so each file has at most two chunks.
+ *
+ * @param [IN] budget - max number of data bytes to move at this call (at least one file is moved), 0 for no limit.
+ * @param [OUT] done - true if the compaction finished, false if it stopped due to the budget and should be called again.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the first chunk of file is never moved as it is the file id. If the sectors after it are free the file grows
+ *       over them into single chunk (like hel_defrag_file), otherwise the rest of its chunks are moved into single chunk
+ *       at the lowest free place that fits them. So the free sectors between first chunks of files are not gathered.
+ *
+ * @note it is safe for power down, the file is switched to its new chunks by single atomic write of its first chunk metadata.
+ *
+ * @note the budget counts just the moved data bytes, the metadata reads of walking the files are not counted. The next call
+ *       continues the walk from the file it stopped at. Creating files between calls is allowed, and so is changing or deleting
+ *       them, but then the next call walks the files before that place again (without moving them).
+ */
+hel_ret hel_compact(HEL_BASE_TYPE budget, bool *done);
+
+/*
+ * @brief defragment file, rewrites it into the fewest possible chunks.
+ *
+ * @param [IN] id - the id of the file.
+ * @param [OUT] new_id - if not NULL, the file may be moved to new place and this is its new id (it is the same id if it was not moved).
+ *                       if NULL the file keeps its id.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free space to improve file with more than two chunks, hel_XXXX_err otherwise.
+ *
+ * @note the options by their order:
+ *       1. the free sectors after the first chunk are enough for the rest of the file, then the file becomes single chunk with the same id.
+ *       2. new_id is not NULL and there is free chunk that fits the whole file, then the file is copied there and gets new id.
+ *       3. the rest of the chunks are moved into single chunk (as in hel_compact), so the file has two chunks.
+ *
+ * @note it is safe for power down, the file is switched to its new chunks by single atomic write (options 1, 2 use small journal
+ *       record, that is finished at hel_init if power down happens after it was written).
+ */
+hel_ret hel_defrag_file(hel_file_id id, hel_file_id *new_id);
+
 /*
  * @brief create file and writes to it.
  *
@@ -71,9 +573,234 @@ hel_ret hel_close();
  * @note the motivation behind adding the write with the create is to reduce number of writes to the memory.
  * 
  * @note the motivation behind giving the option to write multiple buffers is to reduce writes overheads.
+ *
+ * @note there are no heap allocations in this function, the RAM it needs is allocated at hel_init and grows upon deletions
+ *       (except the plan of the allocation group, which grows at the first create in the group after the free chunks number grew).
+ *
+ * @note when HEL_THREAD_SAFE is set, creates run in parallel with each other and with the reading functions, just the reservation
+ *       of the chunks is done one at a time, the data is written under the lock of the allocation group (see hel_set_alloc_groups).
  */
 hel_ret hel_create_and_write(void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id);
 
+#if HEL_ASYNC
+/*
+ * @brief create file and writes to it, like hel_create_and_write, without waiting for the memory transfers.
+ *
+ * @param [IN] in - array of buffers to write file data from, they should be valid till the operation is done.
+ * @param [IN] size - array of number of bytes to write to the file, each one correspand to the align buffer on the buffers array.
+ * @param [IN] num - the number of buffers.
+ * @param [OUT] out_id - the new file id, the file exists after the operation is done with hel_success.
+ * @param [INOUT] op - the operation, done is called with the result when all the transfers are done.
+ *
+ * @return hel_success if the transfers were submitted (the result is given by done or hel_async_poll), hel_mem_err if the file
+ *         needs more than HEL_ASYNC_MAX_REQUESTS transfers, hel_busy_err if HEL_ASYNC_MAX_CREATES creates are in progress,
+ *         hel_XXXX_err otherwise (then done is not called).
+ *
+ * @note the chunks are reserved and all their transfers are submitted by this call, so the transfer of each chunk is queued while
+ *       the previous ones are still moving. The first chunk metadata is submitted only after all the other transfers are done,
+ *       so upon power down or failed transfer the file is not created.
+ *
+ * @note the file is counted (see hel_get_frag_stats) after it is created, and upon failed transfer the reserved chunks are
+ *       released. Both are done by the next call that changes the volume (or gets its stats), as the completion may be interrupt.
+ */
+hel_ret hel_create_and_write_async(void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id, hel_async_op *op);
+#endif
+
+/*
+ * @brief create many files at once.
+ *
+ * @param [IN] files - array of the files to create.
+ * @param [IN] files_num - number of files.
+ * @param [OUT] out_ids - array of files_num ids, for the new files ids by the order of files.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise. Then just the runs (see the notes) that were committed before the
+ *         failure exist, none of the files of the run that failed exists and their out_ids are not valid.
+ *
+ * @note the files are placed one after the other at free extents, the free extents are checked by their order once for all
+ *       the batch, so it is much faster than creating each file by itself. The allocation policy is not used, and file that
+ *       doesn't fit any of the rest of the extents is created as at hel_create_and_write.
+ *
+ * @note it is safe for power down, each run of files that are placed at the same free extent appears by single atomic write
+ *       of the first file metadata.
+ */
+hel_ret hel_create_batch(hel_batch_file *files, HEL_BASE_TYPE files_num, hel_file_id *out_ids);
+
+/*
+ * @brief start creating file with streaming writer.
+ *
+ * @param [OUT] writer - the writer.
+ * @param [IN] size_hint - the expected size of the file, 0 if unknown.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the writer reserves part of free chunk: size_hint bytes (or HEL_WRITER_RESERVE_SECTORS sectors if it is 0) from the
+ *       smallest free chunk that fits them, or the largest free chunk if there is no such. When it is full the next reservation
+ *       is twice bigger, but at most half of the largest free chunk, so other files can be created meanwhile.
+ *       The part that is not used is given back at commit.
+ *
+ * @note the file doesn't exist till hel_write_commit, power down before it leaves the memory as it was (the reservation is just in RAM).
+ *       Also hel_init (or hel_format) cancels writers that were not committed, using them after it returns hel_param_err.
+ */
+hel_ret hel_write_open(hel_writer *writer, HEL_BASE_TYPE size_hint);
+
+/*
+ * @brief write data to the end of file that being created with streaming writer.
+ *
+ * @param [INOUT] writer - the writer.
+ * @param [IN] in - buffer to write the data from.
+ * @param [IN] size - number of bytes to write.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free space, hel_XXXX_err otherwise.
+ *
+ * @note the data is written to the memory at this call, so the buffer can be reused after it.
+ */
+hel_ret hel_write_append(hel_writer *writer, void *in, HEL_BASE_TYPE size);
+
+/*
+ * @brief finish creating file with streaming writer, from here the file exists.
+ *
+ * @param [INOUT] writer - the writer, it is closed after this call.
+ * @param [OUT] out_id - the new file id.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the file is created by writing the metadata of its first chunk last, as at hel_create_and_write.
+ */
+hel_ret hel_write_commit(hel_writer *writer, hel_file_id *out_id);
+
+/*
+ * @brief cancel creating file with streaming writer, the reserved chunks are free again.
+ *
+ * @param [INOUT] writer - the writer, it is closed after this call.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret hel_write_abort(hel_writer *writer);
+
+/*
+ * @brief write data to the end of existing file.
+ *
+ * @param [IN] id - the id of file.
+ * @param [IN] in - array of buffers to write the data from.
+ * @param [IN] size - array of number of bytes to write, each one correspand to the align buffer on the buffers array.
+ * @param [IN] num - the number of buffers.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free space, hel_XXXX_err otherwise.
+ *
+ * @note the data that was already written is not touched: the unused bytes at the last sector of the file are filled first,
+ *       and the rest is written to new chunks that are linked after the last chunk.
+ *
+ * @note it is safe for power down, the new data is added to the file by single atomic write of the last chunk metadata.
+ */
+hel_ret hel_append(hel_file_id id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num);
+
+/*
+ * @brief overwrite part of the data of existing file.
+ *
+ * @param [IN] id - the id of file.
+ * @param [IN] offset - index of byte in the file to start write from.
+ * @param [IN] in - buffer to write the data from.
+ * @param [IN] size - number of bytes to write, the write should not pass the end of the file (see hel_append).
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free chunk that fits size (and little more) bytes, hel_XXXX_err otherwise.
+ *
+ * @note it is safe for power down, the new data is written first to journal record that is committed by single atomic write,
+ *       and then it is written at its place at the file chunks. So the file has either the old or the new data, and the number
+ *       of bytes that are written depends just on size (about twice of it) and not on the size of the file.
+ */
+hel_ret hel_write_at(hel_file_id id, HEL_BASE_TYPE offset, void *in, HEL_BASE_TYPE size);
+
+/*
+ * @brief replace all the content of existing file with new content.
+ *
+ * @param [IN] old_id - the id of the file.
+ * @param [IN] in - array of buffers to write the new file data from.
+ * @param [IN] size - array of number of bytes to write to the file, each one correspand to the align buffer on the buffers array.
+ * @param [IN] num - the number of buffers.
+ * @param [OUT] new_id - the new file id, old_id is not valid anymore.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free space for the new content (and small journal record), hel_XXXX_err otherwise.
+ *
+ * @note it is safe for power down, the new content is written to free chunks, and then the new file is signed as start of file
+ *       and the old one as not start of file with single journal commit. So after power down there is exactly one of them.
+ *
+ * @note the old content is freed just after the new one is written, so there should be free space for the new content.
+ */
+hel_ret hel_replace(hel_file_id old_id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *new_id);
+
+/*
+ * @brief shrink existing file, the data after new_size is removed.
+ *
+ * @param [IN] id - the id of file.
+ * @param [IN] new_size - the new number of data bytes of the file, should not be bigger than the current one.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free chunk for small journal record, hel_XXXX_err otherwise.
+ *
+ * @note the data is not copied, the chunk with the new end becomes end chunk and the chunks after it are freed.
+ *
+ * @note it is safe for power down, the file is shrunk by single atomic write of the new end chunk metadata. When sectors
+ *       at the new end chunk are freed too, their free chunk metadata is written with it by small journal record.
+ */
+hel_ret hel_truncate(hel_file_id id, HEL_BASE_TYPE new_size);
+
+/*
+ * @brief start transaction.
+ *
+ * @param [OUT] txn - the transaction.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the creates and deletes of the transaction are done together at hel_txn_commit, power down before it leaves all
+ *       the files as they were. Also hel_init (or hel_format) cancels transactions that were not committed, using them
+ *       after it returns hel_param_err.
+ */
+hel_ret hel_txn_begin(hel_txn *txn);
+
+/*
+ * @brief stage creation of file at transaction, the data is written now but the file exists only after hel_txn_commit.
+ *
+ * @param [INOUT] txn - the transaction.
+ * @param [IN] in - array of buffers to write file data from.
+ * @param [IN] size - array of number of bytes to write to the file, each one correspand to the align buffer on the buffers array.
+ * @param [IN] num - the number of buffers.
+ * @param [OUT] out_id - the id the file will have.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free space or the transaction has HEL_TXN_MAX_FILES creates, hel_XXXX_err otherwise.
+ */
+hel_ret hel_txn_create(hel_txn *txn, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id);
+
+/*
+ * @brief stage deletion of file at transaction, the file can be used till hel_txn_commit.
+ *
+ * @param [INOUT] txn - the transaction.
+ * @param [IN] id - the id of the file.
+ *
+ * @return hel_success upon success, hel_mem_err if the transaction has HEL_TXN_MAX_FILES deletes, hel_XXXX_err otherwise.
+ */
+hel_ret hel_txn_delete(hel_txn *txn, hel_file_id id);
+
+/*
+ * @brief commit transaction, all its creates and deletes are done together.
+ *
+ * @param [INOUT] txn - the transaction, it is closed upon success.
+ *
+ * @return hel_success upon success, hel_mem_err if there is no free chunk for small journal record (the transaction stays open),
+ *         hel_XXXX_err otherwise.
+ *
+ * @note the start of file flags of all the files are changed with single journal record, which is committed by single
+ *       atomic write, so after power down either all the changes are done or none of them.
+ */
+hel_ret hel_txn_commit(hel_txn *txn);
+
+/*
+ * @brief cancel transaction, the staged files are freed and the files staged for deletion are not changed.
+ *
+ * @param [INOUT] txn - the transaction, it is closed after this call.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret hel_txn_abort(hel_txn *txn);
+
 /*
  * @brief read content of file.
  *
@@ -86,6 +813,134 @@ hel_ret hel_create_and_write(void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num,
  */
 hel_ret hel_read(hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size);
 
+#if HEL_ASYNC
+/*
+ * @brief read content of file, like hel_read, without waiting for the memory transfers.
+ *
+ * @param [IN]  id - the id of file.
+ * @param [OUT] out - buffer to read into it, it should be valid till the operation is done.
+ * @param [IN]  begin - index of byte in the file to start read from.
+ * @param [IN]  size - number of bytes to read.
+ * @param [INOUT] op - the operation, done is called with the result when all the transfers are done.
+ *
+ * @return hel_success if the transfers were submitted (the result is given by done or hel_async_poll), hel_mem_err if
+ *         the read needs more than HEL_ASYNC_MAX_REQUESTS transfers, hel_XXXX_err otherwise (then done is not called).
+ *
+ * @note the chunks metadata are read by this call, and then the data transfers of all the chunks are submitted together.
+ *
+ * @note the file should not be changed till the operation is done. When HEL_LOCKFREE_READS is set it may be deleted, replaced
+ *       or moved meanwhile, as its chunks are not reused till the operation is done.
+ */
+hel_ret hel_read_async(hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size, hel_async_op *op);
+
+/*
+ * @brief check if asynchronous operation is done.
+ *
+ * @param [IN]  op - the operation.
+ * @param [OUT] done - true if all the transfers of the operation are done.
+ *
+ * @return the result of the operation if it is done, hel_success if not.
+ *
+ * @note it can be used instead of the done callback, e.g. from main loop.
+ */
+hel_ret hel_async_poll(hel_async_op *op, bool *done);
+
+/*
+ * @brief called by the memory driver upon completion of request, see mem_driver_submit at mem_driver.h.
+ *
+ * @param [IN] request - the request.
+ * @param [IN] ret - the result of the request.
+ *
+ * @note can be called from interrupt, it calls the done callback of the operation after the last request.
+ */
+void hel_mem_request_done(hel_mem_request *request, hel_ret ret);
+#endif
+
+/*
+ * @brief open read cursor at the start of file.
+ *
+ * @param [IN]  id - the id of file.
+ * @param [OUT] cursor - the read cursor.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note there is nothing to close, the cursor holds no resources.
+ */
+hel_ret hel_open_read(hel_file_id id, hel_read_cursor *cursor);
+
+/*
+ * @brief read the next bytes of file, from where the last read ended.
+ *
+ * @param [INOUT] cursor - the read cursor.
+ * @param [OUT] out - buffer to read into it.
+ * @param [IN]  size - number of bytes to read.
+ * @param [OUT] read_size - number of bytes that were read, less than size if the end of file reached.
+ *
+ * @return hel_success upon success, hel_not_file_err if the file was deleted, hel_XXXX_err otherwise.
+ *
+ * @note sequential reads need single metadata read per chunk of the file.
+ *
+ * @note if files chunks were changed since the last read (create/delete/compact etc.) the cursor finds its place again from the first chunk.
+ */
+hel_ret hel_read_next(hel_read_cursor *cursor, void *out, HEL_BASE_TYPE size, HEL_BASE_TYPE *read_size);
+
+/*
+ * @brief move read cursor to offset in the file.
+ *
+ * @param [INOUT] cursor - the read cursor.
+ * @param [IN] pos - offset in the file data, may be the file size.
+ *
+ * @return hel_success upon success, hel_boundaries_err if pos is after the end of the file, hel_XXXX_err otherwise.
+ *
+ * @note seeking forward walks from the current chunk, seeking backward walks from the first chunk.
+ */
+hel_ret hel_seek(hel_read_cursor *cursor, HEL_BASE_TYPE pos);
+
+#if HEL_LOCKFREE_READS
+/*
+ * @brief start lock-free reading, for reading files without taking any lock (e.g. from interrupt).
+ *
+ * @param [OUT] reader - the reader.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note it takes two atomic operations and never waits for the writers, so it can be called while other thread changes the files.
+ *
+ * @note until hel_lockfree_end freed chunks are not reused, so read of file that is deleted, replaced or moved (compact/defrag)
+ *       in the middle still returns the data the file had when the read started. Sectors freed meanwhile are counted as used by hel_get_space_info.
+ *
+ * @note should not be called while hel_init/hel_format/hel_close are running.
+ */
+hel_ret hel_lockfree_begin(hel_lockfree_reader *reader);
+
+/*
+ * @brief read content of file without taking any lock, like hel_read.
+ *
+ * @param [IN]  reader - the reader, that was started by hel_lockfree_begin.
+ * @param [IN]  id - the id of file.
+ * @param [OUT] out - buffer to read into it.
+ * @param [IN]  begin - index of byte in the file to start read from.
+ * @param [IN]  size - number of bytes to read.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note it reads just the memory (not the RAM state of the volume), so the read function of the memory driver should be
+ *       callable at the same time with its write function.
+ *
+ * @note data of file that is changed in place at the same time (hel_write_at, hel_append, hel_truncate) may be read partly changed.
+ */
+hel_ret hel_lockfree_read(hel_lockfree_reader *reader, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size);
+
+/*
+ * @brief end lock-free reading, the chunks that were freed during it can be reused from the next change of the files.
+ *
+ * @param [IN] reader - the reader, that was started by hel_lockfree_begin.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret hel_lockfree_end(hel_lockfree_reader *reader);
+#endif
+
 /*
  * @brief delete file.
  *
@@ -95,6 +950,21 @@ hel_ret hel_read(hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE s
  */
 hel_ret hel_delete(hel_file_id id);
 
+/*
+ * @brief delete many files at once.
+ *
+ * @param [INOUT] ids - array of the ids of the files, it is sorted by this function.
+ * @param [IN] ids_num - number of files.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise (nothing is deleted if one of the ids is not file).
+ *
+ * @note the freed chunks that are next to each other (or to free chunks) get single free chunk metadata, so the walks over
+ *       the memory are shorter, and file that is at the start of such area is deleted by this write.
+ *
+ * @note it is safe for power down, each file is deleted by single atomic write, so power down may leave part of the files not deleted.
+ */
+hel_ret hel_delete_batch(hel_file_id *ids, HEL_BASE_TYPE ids_num);
+
 /*
  * @brief get the id of the first file in the memory.
  *
@@ -118,3 +988,63 @@ hel_ret hel_get_first_file(hel_file_id *id);
  * @note in case of creation/deletion of file, the iteration process should be re-started.
  */
 hel_ret hel_iterate_files(hel_file_id *id);
+
+/*
+ * @brief set up volume with its drivers, should be called before any other function of the volume.
+ *
+ * @param [OUT] fs - the volume.
+ * @param [IN] driver - the drivers of the volume, copied into it.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note the volume is not formatted/initialized, call hel_format_ctx or hel_init_ctx after it.
+ */
+hel_ret hel_fs_setup(hel_fs *fs, const hel_driver *driver);
+
+/*
+ * The same functions as above for given volume (see hel_fs), the functions above use the default volume.
+ * The default volume exists when HEL_DEFAULT_FS is set, it uses the link time drivers of mem_driver.h and os_driver.h.
+ */
+hel_ret hel_format_ctx(hel_fs *fs);
+hel_ret hel_init_ctx(hel_fs *fs);
+hel_ret hel_close_ctx(hel_fs *fs);
+hel_ret hel_get_space_info_ctx(hel_fs *fs, hel_space_info *info);
+hel_ret hel_set_alloc_policy_ctx(hel_fs *fs, hel_alloc_policy policy);
+hel_ret hel_set_alloc_groups_ctx(hel_fs *fs, HEL_BASE_TYPE groups_num);
+hel_ret hel_get_frag_stats_ctx(hel_fs *fs, hel_frag_stats *stats);
+hel_ret hel_compact_ctx(hel_fs *fs, HEL_BASE_TYPE budget, bool *done);
+hel_ret hel_defrag_file_ctx(hel_fs *fs, hel_file_id id, hel_file_id *new_id);
+hel_ret hel_create_and_write_ctx(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id);
+#if HEL_ASYNC
+hel_ret hel_create_and_write_async_ctx(hel_fs *fs, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id, hel_async_op *op);
+#endif
+hel_ret hel_create_batch_ctx(hel_fs *fs, hel_batch_file *files, HEL_BASE_TYPE files_num, hel_file_id *out_ids);
+hel_ret hel_write_open_ctx(hel_fs *fs, hel_writer *writer, HEL_BASE_TYPE size_hint);
+hel_ret hel_write_append_ctx(hel_fs *fs, hel_writer *writer, void *in, HEL_BASE_TYPE size);
+hel_ret hel_write_commit_ctx(hel_fs *fs, hel_writer *writer, hel_file_id *out_id);
+hel_ret hel_write_abort_ctx(hel_fs *fs, hel_writer *writer);
+hel_ret hel_append_ctx(hel_fs *fs, hel_file_id id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num);
+hel_ret hel_write_at_ctx(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE offset, void *in, HEL_BASE_TYPE size);
+hel_ret hel_replace_ctx(hel_fs *fs, hel_file_id old_id, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *new_id);
+hel_ret hel_truncate_ctx(hel_fs *fs, hel_file_id id, HEL_BASE_TYPE new_size);
+hel_ret hel_txn_begin_ctx(hel_fs *fs, hel_txn *txn);
+hel_ret hel_txn_create_ctx(hel_fs *fs, hel_txn *txn, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE num, hel_file_id *out_id);
+hel_ret hel_txn_delete_ctx(hel_fs *fs, hel_txn *txn, hel_file_id id);
+hel_ret hel_txn_commit_ctx(hel_fs *fs, hel_txn *txn);
+hel_ret hel_txn_abort_ctx(hel_fs *fs, hel_txn *txn);
+hel_ret hel_read_ctx(hel_fs *fs, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size);
+#if HEL_ASYNC
+hel_ret hel_read_async_ctx(hel_fs *fs, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size, hel_async_op *op);
+#endif
+hel_ret hel_open_read_ctx(hel_fs *fs, hel_file_id id, hel_read_cursor *cursor);
+hel_ret hel_read_next_ctx(hel_fs *fs, hel_read_cursor *cursor, void *out, HEL_BASE_TYPE size, HEL_BASE_TYPE *read_size);
+hel_ret hel_seek_ctx(hel_fs *fs, hel_read_cursor *cursor, HEL_BASE_TYPE pos);
+#if HEL_LOCKFREE_READS
+hel_ret hel_lockfree_begin_ctx(hel_fs *fs, hel_lockfree_reader *reader);
+hel_ret hel_lockfree_read_ctx(hel_fs *fs, hel_lockfree_reader *reader, hel_file_id id, void *out, HEL_BASE_TYPE begin, HEL_BASE_TYPE size);
+hel_ret hel_lockfree_end_ctx(hel_fs *fs, hel_lockfree_reader *reader);
+#endif
+hel_ret hel_delete_ctx(hel_fs *fs, hel_file_id id);
+hel_ret hel_delete_batch_ctx(hel_fs *fs, hel_file_id *ids, HEL_BASE_TYPE ids_num);
+hel_ret hel_get_first_file_ctx(hel_fs *fs, hel_file_id *id);
+hel_ret hel_iterate_files_ctx(hel_fs *fs, hel_file_id *id);
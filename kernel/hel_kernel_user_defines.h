@@ -12,3 +12,73 @@
  *      64: max memory size - ((1 << 62) - 1), max sectors num - ((1 << 31) - 1)
  */
 // #define HEL_BASE_TYPE_BITS 32
+
+/*
+ * The default policy for choosing where new files are created, see hel_alloc_policy at hel_kernel.h.
+ */
+// #define HEL_DEFAULT_ALLOC_POLICY hel_alloc_first_fit
+
+/*
+ * Max and default number of allocation groups, see hel_set_alloc_groups at hel_kernel.h.
+ * Each group takes its lock at the os driver and its plan array at the heap, so creates from different threads run in parallel.
+ */
+// #define HEL_MAX_ALLOC_GROUPS 8
+// #define HEL_DEFAULT_ALLOC_GROUPS 1
+
+/*
+ * Number of buckets of the free chunks sizes histogram, see hel_frag_stats at hel_kernel.h.
+ */
+// #define HEL_FREE_HIST_BUCKETS 16
+
+/*
+ * Size in bytes of the stack buffer used for copying data inside the memory (e.g. at hel_compact).
+ * Bigger buffer means less reads/writes calls for the memory driver.
+ */
+// #define HEL_COPY_BUFF_SIZE 64
+
+/*
+ * The extent cache keeps the chunks list of recently read files, so reading from the middle of file doesn't need to read
+ * the metadata of all the chunks before. It takes about HEL_EXTENT_CACHE_ENTRIES * HEL_EXTENT_CACHE_MAX_CHUNKS * 2 * sizeof(HEL_BASE_TYPE) bytes of RAM.
+ * Set HEL_EXTENT_CACHE_ENTRIES to 0 for disabling it.
+ */
+// #define HEL_EXTENT_CACHE_ENTRIES 4
+// #define HEL_EXTENT_CACHE_MAX_CHUNKS 16
+
+/*
+ * Max number of creates and max number of deletes in single transaction, see hel_txn at hel_kernel.h.
+ */
+// #define HEL_TXN_MAX_FILES 8
+
+/*
+ * Number of sectors that streaming writer reserves when the size of the file is unknown, see hel_write_open at hel_kernel.h.
+ * When the reservation is full the next one is twice bigger, but at most half of the largest free chunk.
+ */
+// #define HEL_WRITER_RESERVE_SECTORS 4
+
+/*
+ * Set to 1 for calling the kernel functions from multiple threads, the locks are taken by the os driver (see os_driver.h).
+ * Reading functions (hel_read, the read cursors and the files iteration) and hel_create_and_write run in parallel, all others one at a time.
+ */
+// #define HEL_THREAD_SAFE 0
+
+/*
+ * Set to 1 for reading files without any lock (e.g. from interrupt) by hel_lockfree_begin/hel_lockfree_read/hel_lockfree_end,
+ * also without HEL_THREAD_SAFE. Needs C11 atomics, and freed chunks are kept from reuse till the readers that may read them end.
+ */
+// #define HEL_LOCKFREE_READS 0
+
+/*
+ * Set to 1 for hel_read_async and hel_create_and_write_async, that submit the memory transfers to the asynchronous interface of
+ * the memory driver (mem_driver_submit at mem_driver.h) and complete by callback or polling. Needs C11 atomics.
+ * HEL_ASYNC_MAX_REQUESTS is the max number of transfers of single operation, each one takes about 6 * sizeof(HEL_BASE_TYPE) bytes of hel_async_op.
+ * HEL_ASYNC_MAX_CREATES is the max number of asynchronous creates in progress at each volume, each one takes about
+ * 2 * HEL_ASYNC_MAX_REQUESTS * sizeof(HEL_BASE_TYPE) bytes of hel_fs.
+ */
+// #define HEL_ASYNC 0
+// #define HEL_ASYNC_MAX_REQUESTS 16
+// #define HEL_ASYNC_MAX_CREATES 4
+
+/*
+ * Set to 0 for removing the default volume, so only the _ctx functions exist and mem_driver.h/os_driver.h are not needed.
+ */
+// #define HEL_DEFAULT_FS 1
@@ -6,6 +6,15 @@
 
 #include "hel_kernel.h"
 
+/*
+ * The memory driver of the default volume (see HEL_DEFAULT_FS), other volumes get their drivers at hel_fs_setup.
+ *
+ * When HEL_THREAD_SAFE is set, the read and write functions are called from multiple threads in parallel, creates write new chunks
+ * while other threads read and write other chunks. File data is never read and written in parallel, but the metadata of a chunk
+ * may be read (e.g. by hel_iterator) while a create writes it, so the read should return the metadata written by atomic_write
+ * either before or after the write.
+ */
+
 /*
  * @brief Init the memory driver for hel-fs usage, return memory sizes.
  *
@@ -53,5 +62,28 @@ hel_ret mem_driver_write(HEL_BASE_TYPE v_addr, HEL_BASE_TYPE *atomic_write, void
  * @param [OUT] out - buffer to read the data to.
  * 
  * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note when HEL_LOCKFREE_READS is set it may be called from hel_lockfree_read while mem_driver_write runs (e.g. from interrupt),
+ *       and should return the metadata written by atomic_write either before or after the write.
+ *
+ * @note when HEL_THREAD_SAFE is set it may be called in parallel with other reads and writes, see above.
+ */
+hel_ret mem_driver_read(HEL_BASE_TYPE v_addr, HEL_BASE_TYPE size, void *out);
+
+#if HEL_ASYNC
+/*
+ * @brief submit asynchronous read/write request, the request is queued and this function returns without waiting for it.
+ *
+ * @param [IN] request - the request, valid till it is completed. For write it is like mem_driver_write with single buffer
+ *                       (when atomic_write is not NULL, buff is written after it and *atomic_write is written last).
+ *
+ * @return hel_success if the request was queued, hel_XXXX_err otherwise (then it should not be completed).
+ *
+ * @note upon completion of the request call hel_mem_request_done (see hel_kernel.h), it may be called from interrupt.
+ *
+ * @note it may be called from hel_mem_request_done, so it should not wait for other requests to complete.
+ *
+ * @note the requests may be done in any order, the kernel submits request that should be done after others only after they completed.
  */
-hel_ret mem_driver_read(HEL_BASE_TYPE v_addr, HEL_BASE_TYPE size, void *out);
\ No newline at end of file
+hel_ret mem_driver_submit(hel_mem_request *request);
+#endif
@@ -0,0 +1,90 @@
+
+
+#pragma once
+
+#include "hel_kernel.h"
+
+/*
+ * The os driver of the default volume (see HEL_DEFAULT_FS), it is needed only when HEL_THREAD_SAFE is set, the kernel uses it for protecting its RAM state.
+ * The locks are used by the kernel only, they are never taken recursively, and they should exist before hel_format/hel_init is called.
+ * When HEL_THREAD_SAFE is set, mem_driver_read and mem_driver_write should support being called from multiple threads in parallel,
+ * creates write while other threads read and create, see mem_driver.h.
+ */
+
+/*
+ * @brief take the kernel lock shared, multiple threads may hold it shared together.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_lock_shared();
+
+/*
+ * @brief release the kernel lock that was taken shared.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_unlock_shared();
+
+/*
+ * @brief take the kernel lock exclusive, no other thread holds it (shared or exclusive) until it is released.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_lock_exclusive();
+
+/*
+ * @brief release the kernel lock that was taken exclusive.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_unlock_exclusive();
+
+/*
+ * @brief take the cache lock, a mutex that protects the RAM caches that readers update while holding the kernel lock shared.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note it is held only for short time, without memory driver writes.
+ */
+hel_ret os_driver_cache_lock();
+
+/*
+ * @brief release the cache lock.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_cache_unlock();
+
+/*
+ * @brief take the allocator lock, a mutex that protects the free space state while creates (that hold the kernel lock shared) reserve chunks.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ *
+ * @note it is held only for short time, with just the memory driver writes of the free chunks headers.
+ */
+hel_ret os_driver_alloc_lock();
+
+/*
+ * @brief release the allocator lock.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_alloc_unlock();
+
+/*
+ * @brief take the lock of allocation group, a mutex per group that is held while creating file in the group.
+ *
+ * @param [IN] group - the index of the group, less than HEL_MAX_ALLOC_GROUPS.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_group_lock(HEL_BASE_TYPE group);
+
+/*
+ * @brief release the lock of allocation group.
+ *
+ * @param [IN] group - the index of the group.
+ *
+ * @return hel_success upon success, hel_XXXX_err otherwise.
+ */
+hel_ret os_driver_group_unlock(HEL_BASE_TYPE group);
@@ -1,9 +1,36 @@
 
 #include "acutest_hel_port.h"
 
+#include "../kernel/hel_kernel.h"
+
 #define ADD_TEST(func) \
 		extern void func();
 
+#if HEL_THREAD_SAFE
+#define THREAD_SAFE_TESTS_ADDER \
+	ADD_TEST(concurrent_read_write_test)\
+	ADD_TEST(concurrent_read_benchmark)\
+	ADD_TEST(concurrent_create_test)\
+	ADD_TEST(concurrent_create_benchmark)\
+	ADD_TEST(concurrent_volumes_test)
+#else
+#define THREAD_SAFE_TESTS_ADDER
+#endif
+
+#if HEL_LOCKFREE_READS
+#define LOCKFREE_TESTS_ADDER \
+	ADD_TEST(lockfree_read_test)
+#else
+#define LOCKFREE_TESTS_ADDER
+#endif
+
+#if HEL_ASYNC
+#define ASYNC_TESTS_ADDER \
+	ADD_TEST(async_test)
+#else
+#define ASYNC_TESTS_ADDER
+#endif
+
 #define MULTIPLE_TESTS_ADDER \
 	ADD_TEST(basic_test)\
 	ADD_TEST(write_too_big_test)\
@@ -36,6 +63,41 @@
 	ADD_TEST(get_first_file_when_empty_test)\
 	ADD_TEST(basic_creation_2_buffs_test)\
 	ADD_TEST(random_multi_buffer_creation_test)\
+	ADD_TEST(map_word_boundaries_test)\
+	ADD_TEST(free_extents_random_test)\
+	ADD_TEST(alloc_policies_test)\
+	ADD_TEST(alloc_min_chunks_test)\
+	ADD_TEST(alloc_groups_test)\
+	ADD_TEST(summary_map_big_volume_test)\
+	ADD_TEST(space_info_test)\
+	ADD_TEST(frag_stats_test)\
+	ADD_TEST(compaction_test)\
+	ADD_TEST(power_down_in_compaction_test)\
+	ADD_TEST(defrag_file_test)\
+	ADD_TEST(power_down_in_defrag_file_test)\
+	ADD_TEST(extent_cache_test)\
+	ADD_TEST(read_cursor_test)\
+	ADD_TEST(streaming_writer_test)\
+	ADD_TEST(power_down_in_streaming_writer_test)\
+	ADD_TEST(append_test)\
+	ADD_TEST(power_down_in_append_test)\
+	ADD_TEST(write_at_test)\
+	ADD_TEST(power_down_in_write_at_test)\
+	ADD_TEST(replace_test)\
+	ADD_TEST(power_down_in_replace_test)\
+	ADD_TEST(truncate_test)\
+	ADD_TEST(power_down_in_truncate_test)\
+	ADD_TEST(create_batch_test)\
+	ADD_TEST(power_down_in_create_batch_test)\
+	ADD_TEST(delete_batch_test)\
+	ADD_TEST(power_down_in_delete_batch_test)\
+	ADD_TEST(txn_test)\
+	ADD_TEST(power_down_in_txn_test)\
+	ADD_TEST(chunks_plan_growth_test)\
+	ADD_TEST(ctx_volumes_test)\
+	THREAD_SAFE_TESTS_ADDER\
+	LOCKFREE_TESTS_ADDER\
+	ASYNC_TESTS_ADDER\
 	\
 	ADD_TEST(naming_basic_test)\
 	ADD_TEST(naming_file_recreation_test)\
@@ -11,6 +11,13 @@
 #include "../kernel/hel_kernel.h"
 #include "test_utils.h"
 
+#if HEL_THREAD_SAFE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
 
 #define MY_STR1 "hello world!\n"
 #define MY_STR2 "world hello\n"
@@ -1188,3 +1195,4208 @@ void random_multi_buffer_creation_test()
 	}
 
 }
+
+// Number of sectors that is not multiple of the map word, so the last word is partial
+#define WORD_TEST_SECTORS_NUM 100
+
+void map_word_boundaries_test()
+{
+	hel_file_id ids[WORD_TEST_SECTORS_NUM];
+	hel_file_id id;
+	hel_ret ret;
+	uint8_t buff[100];
+
+	mem_driver_init_test(DEFAULT_SECTOR_SIZE * WORD_TEST_SECTORS_NUM, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	// Fill all sectors with single sector files
+	for(int i = 0; i < WORD_TEST_SECTORS_NUM; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d, file %d", ret, i);
+		TEST_ASSERT_(ids[i] == i, "expected id %d got %d", i, ids[i]);
+	}
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	// Free sectors around the words boundaries
+	ret = hel_delete(ids[63]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[64]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[99]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// File that needs two sectors should take the two sectors hole around the words boundary
+	ret = test_create_and_write_one_helper(BIG_STR1, DEFAULT_SECTOR_SIZE, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 63, "expected id 63 got %d", id);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 99, "expected id 99 got %d", id);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_read(63, buff, 0, DEFAULT_SECTOR_SIZE);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	TEST_ASSERT(memcmp(buff, BIG_STR1, DEFAULT_SECTOR_SIZE) == 0);
+}
+
+#define RANDOM_FILES_NUM 12
+
+void free_extents_random_test()
+{
+	hel_file_id ids[RANDOM_FILES_NUM], id, id_after_init;
+	HEL_BASE_TYPE sizes[RANDOM_FILES_NUM];
+	bool exist[RANDOM_FILES_NUM] = {false};
+	uint8_t buffs[RANDOM_FILES_NUM][DEFAULT_SECTOR_SIZE * 3];
+	uint8_t buff[DEFAULT_SECTOR_SIZE * 3];
+	hel_space_info info, info_after_init;
+	hel_frag_stats stats, stats_after_init;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	for(int round = 0; round < 500; round++)
+	{
+		int i = rand() % RANDOM_FILES_NUM;
+
+		if(exist[i])
+		{
+			ret = hel_delete(ids[i]);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, round);
+			exist[i] = false;
+		}
+		else
+		{
+			sizes[i] = 1 + rand() % sizeof(buffs[i]);
+			fill_rand_buff(buffs[i], sizes[i]);
+			ret = test_create_and_write_one_helper(buffs[i], sizes[i], &ids[i]);
+			TEST_ASSERT_(ret == hel_success || ret == hel_mem_err, "got error %d, round %d", ret, round);
+			exist[i] = (ret == hel_success);
+		}
+
+		// Ensure that the index after init chooses same place as the index updated on the fly
+		if(round % 50 == 0)
+		{
+			ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+			TEST_ASSERT_(ret == hel_success || ret == hel_mem_err, "got error %d, round %d", ret, round);
+			if(ret == hel_success)
+			{
+				ret = hel_delete(id);
+				TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, round);
+			}
+
+			ret = hel_get_space_info(&info);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+			ret = hel_get_frag_stats(&stats);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+			ret = hel_close();
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+			ret = hel_init();
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+			ret = hel_get_space_info(&info_after_init);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+			TEST_ASSERT_(memcmp(&info, &info_after_init, sizeof(info)) == 0, "space info changed after init, round %d", round);
+
+			ret = hel_get_frag_stats(&stats_after_init);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+			TEST_ASSERT_(memcmp(&stats, &stats_after_init, sizeof(stats)) == 0, "fragmentation stats changed after init, round %d", round);
+
+			ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id_after_init);
+			TEST_ASSERT_(ret == hel_success || ret == hel_mem_err, "got error %d, round %d", ret, round);
+			if(ret == hel_success)
+			{
+				TEST_ASSERT_(id == id_after_init, "expected id %d got %d, round %d", id, id_after_init, round);
+
+				ret = hel_delete(id_after_init);
+				TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, round);
+			}
+		}
+
+		for(int j = 0; j < RANDOM_FILES_NUM; j++)
+		{
+			if(exist[j])
+			{
+				ret = hel_read(ids[j], buff, 0, sizes[j]);
+				TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, round);
+				TEST_ASSERT_(memcmp(buff, buffs[j], sizes[j]) == 0, "compare failed round %d file %d", round, j);
+			}
+		}
+	}
+}
+
+void alloc_policies_test()
+{
+	hel_file_id ids[7], id;
+	hel_ret ret;
+	uint8_t buff[DEFAULT_SECTOR_SIZE * 3];
+	// Sizes of files in sectors, with holes of 3, 1 and 2 sectors after deleting files 1, 3 and 5
+	int sectors[7] = {1, 3, 1, 1, 1, 2, 1};
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_set_alloc_policy((hel_alloc_policy)-1);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	for(int i = 0; i < 7; i++)
+	{
+		ret = test_create_and_write_one_helper(BIG_STR1, sectors[i] * DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE, &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_delete(ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[3]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[5]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	struct
+	{
+		hel_alloc_policy policy;
+		hel_file_id expected_id;
+	}cases[] = {
+		{hel_alloc_first_fit, 1},
+		{hel_alloc_best_fit, 5},
+		{hel_alloc_worst_fit, 10},
+	};
+
+	for(int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		ret = hel_set_alloc_policy(cases[i].policy);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(id == cases[i].expected_id, "policy %d expected id %d got %d", cases[i].policy, cases[i].expected_id, id);
+
+		ret = hel_read(id, buff, 0, sizeof(MY_STR1));
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff, MY_STR1, sizeof(MY_STR1)) == 0);
+
+		ret = hel_delete(id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	// Next fit continues from the free chunk after the last allocation (the first fit one at sector 1)
+	ret = hel_set_alloc_policy(hel_alloc_next_fit);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 5, "expected id 5 got %d", id);
+
+	ret = hel_delete(id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 7, "expected id 7 got %d", id);
+
+	// Policy resets upon init
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 1, "expected id 1 got %d", id);
+}
+
+void alloc_min_chunks_test()
+{
+	hel_file_id ids[8], id;
+	hel_ret ret;
+	uint8_t buff[DEFAULT_SECTOR_SIZE * 5];
+	uint8_t buff_out[sizeof(buff)];
+	// Sizes of files in sectors, with holes of 3, 1 and 2 sectors after deleting files 1, 3 and 5
+	int sectors[8] = {1, 3, 1, 1, 1, 2, 1, 2};
+	HEL_BASE_TYPE big_size = 5 * DEFAULT_SECTOR_SIZE - 2 * MIN_FILE_SIZE; // Fits exactly in the 3 and 2 sectors holes
+
+	mem_driver_init_test(DEFAULT_SECTOR_SIZE * 12, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	for(int i = 0; i < 8; i++)
+	{
+		ret = test_create_and_write_one_helper(BIG_STR1, sectors[i] * DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE, &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_delete(ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[3]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[5]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_set_alloc_policy(hel_alloc_min_chunks);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Small file should be like best fit
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 5, "expected id 5 got %d", id);
+
+	ret = hel_delete(id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Big file should take just the 3 and 2 sectors holes
+	fill_rand_buff(buff, big_size);
+	ret = test_create_and_write_one_helper(buff, big_size, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 1, "expected id 1 got %d", id);
+
+	ret = hel_read(id, buff_out, 0, big_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff, buff_out, big_size) == 0);
+
+	ret = hel_set_alloc_policy(hel_alloc_first_fit);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 5, "expected id 5 got %d", id);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+}
+
+void alloc_groups_test()
+{
+	hel_file_id ids[4], id;
+	hel_space_info info, info_after_init;
+	hel_ret ret;
+	uint8_t buff[DEFAULT_SECTOR_SIZE * 10];
+	uint8_t buff_out[sizeof(buff)];
+	HEL_BASE_TYPE sector_size = DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE;
+
+	// 32 sectors, 8 sectors at each group
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_set_alloc_groups(0);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_set_alloc_groups(HEL_MAX_ALLOC_GROUPS + 1);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_set_alloc_groups(4);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	fill_rand_buff(buff, sizeof(buff));
+
+	// The creates are spread over the groups, each file at the start of its group
+	for(int i = 0; i < 4; i++)
+	{
+		ret = test_create_and_write_one_helper(buff + i, sector_size, &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(ids[i] == i * 8, "expected id %d got %d", i * 8, ids[i]);
+	}
+
+	for(int i = 0; i < 4; i++)
+	{
+		ret = hel_read(ids[i], buff_out, 0, sector_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, buff + i, sector_size) == 0);
+	}
+
+	// Fills the rest of the first group
+	ret = test_create_and_write_one_helper(buff, 7 * DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 1, "expected id 1 got %d", id);
+
+	ret = hel_delete(id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// No group has 10 free sectors, so the file starts at the next group and spills to the group after it
+	ret = test_create_and_write_one_helper(buff, sizeof(buff) - MIN_FILE_SIZE, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 9, "expected id 9 got %d", id);
+
+	ret = hel_read(id, buff_out, 0, sizeof(buff) - MIN_FILE_SIZE);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, buff, sizeof(buff) - MIN_FILE_SIZE) == 0);
+
+	// The third group has just the 3 sectors after the spilled chunk, so the file goes to the last group
+	ret = test_create_and_write_one_helper(buff, 7 * DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 25, "expected id 25 got %d", id);
+
+	// The delete freed the first group
+	ret = test_create_and_write_one_helper(buff, 7 * DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 1, "expected id 1 got %d", id);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// The chunks that start at the middle of the groups are valid chunks on the memory
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info_after_init);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_after_init, sizeof(info)) == 0);
+
+	for(int i = 0; i < 4; i++)
+	{
+		ret = hel_read(ids[i], buff_out, 0, sector_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, buff + i, sector_size) == 0);
+	}
+
+	// The groups reset at hel_init, so it is first fit over the whole memory
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id == 21, "expected id 21 got %d", id);
+}
+
+// Enough sectors for few words of the used map summary
+#define BIG_VOLUME_SECTOR_SIZE 16
+#define BIG_VOLUME_SECTORS_NUM 20000
+
+void summary_map_big_volume_test()
+{
+#if HEL_BASE_TYPE_BITS != 16
+	HEL_BASE_TYPE first_size = 4200 * BIG_VOLUME_SECTOR_SIZE - MIN_FILE_SIZE;
+	HEL_BASE_TYPE second_size = 10000 * BIG_VOLUME_SECTOR_SIZE - MIN_FILE_SIZE;
+	hel_file_id id1, id2, id3;
+	hel_ret ret;
+	uint8_t *buff = malloc(second_size);
+	uint8_t *buff_out = malloc(second_size);
+
+	TEST_ASSERT(buff != NULL && buff_out != NULL);
+
+	mem_driver_init_test(BIG_VOLUME_SECTOR_SIZE * BIG_VOLUME_SECTORS_NUM, BIG_VOLUME_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	fill_rand_buff(buff, second_size);
+
+	ret = test_create_and_write_one_helper(buff, first_size, &id1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id1 == 0, "expected id 0 got %d", id1);
+
+	ret = test_create_and_write_one_helper(MY_STR1, 1, &id2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id2 == 4200, "expected id 4200 got %d", id2);
+
+	ret = test_create_and_write_one_helper(buff, second_size, &id3);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id3 == 4201, "expected id 4201 got %d", id3);
+
+	ret = hel_delete(id1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id3, buff_out, 0, second_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff, buff_out, second_size) == 0);
+
+	// The hole at the start and the space after the second file are not enough
+	ret = test_create_and_write_one_helper(buff, second_size, &id1);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	// But together they are
+	ret = test_create_and_write_one_helper(buff, first_size + (BIG_VOLUME_SECTORS_NUM - 14201) * BIG_VOLUME_SECTOR_SIZE - MIN_FILE_SIZE, &id1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(id1 == 0, "expected id 0 got %d", id1);
+
+	ret = test_create_and_write_one_helper(MY_STR1, 1, &id2);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	free(buff);
+	free(buff_out);
+#endif
+}
+
+void space_info_test()
+{
+	hel_file_id id1, id2, id3;
+	hel_space_info info;
+	hel_ret ret;
+	uint8_t buff[DEFAULT_MEM_SIZE];
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_get_space_info(NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE);
+	TEST_ASSERT(info.free_chunks_num == 1);
+	TEST_ASSERT(info.largest_free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE);
+	TEST_ASSERT(info.max_file_size == DEFAULT_MEM_SIZE - MIN_FILE_SIZE);
+	TEST_ASSERT(info.max_contiguous_file_size == DEFAULT_MEM_SIZE - MIN_FILE_SIZE);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR2, sizeof(MY_STR2), &id2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR3, sizeof(MY_STR3), &id3);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(id2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Now there is one sector hole and the rest of the memory after the third file
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE - 2);
+	TEST_ASSERT(info.free_chunks_num == 2);
+	TEST_ASSERT(info.largest_free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE - 3);
+	TEST_ASSERT(info.max_file_size == DEFAULT_MEM_SIZE - 2 * DEFAULT_SECTOR_SIZE - 2 * MIN_FILE_SIZE);
+	TEST_ASSERT(info.max_contiguous_file_size == DEFAULT_MEM_SIZE - 3 * DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE);
+
+	// File bigger than the free space should fail, and file of exactly the free space should succeed
+	ret = test_create_and_write_one_helper(buff, info.max_file_size + 1, &id2);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = test_create_and_write_one_helper(buff, info.max_file_size, &id2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == 0);
+	TEST_ASSERT(info.free_chunks_num == 0);
+	TEST_ASSERT(info.largest_free_sectors == 0);
+	TEST_ASSERT(info.max_file_size == 0);
+	TEST_ASSERT(info.max_contiguous_file_size == 0);
+}
+
+void frag_stats_test()
+{
+	hel_file_id ids[4], split_id;
+	hel_frag_stats stats, stats_after_init;
+	hel_ret ret;
+	uint8_t buff[DEFAULT_SECTOR_SIZE];
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_get_frag_stats(NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.free_chunks_hist[5] == 1); // 32 sectors
+	TEST_ASSERT(stats.largest_free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE);
+	TEST_ASSERT(stats.files_num == 0);
+	TEST_ASSERT(stats.files_chunks_num == 0);
+	TEST_ASSERT(stats.avg_chunks_per_file_x100 == 0);
+	TEST_ASSERT(stats.max_chunks_per_file == 0);
+	TEST_ASSERT(stats.frag_index == 0);
+
+	for(int i = 0; i < 4; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, 1, &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_delete(ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Free chunks are sector 1 and sectors 4-31
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.free_chunks_hist[0] == 1);
+	TEST_ASSERT(stats.free_chunks_hist[4] == 1);
+	TEST_ASSERT(stats.free_chunks_hist[5] == 0);
+	TEST_ASSERT(stats.largest_free_sectors == 28);
+	TEST_ASSERT(stats.files_num == 3);
+	TEST_ASSERT(stats.files_chunks_num == 3);
+	TEST_ASSERT(stats.avg_chunks_per_file_x100 == 100);
+	TEST_ASSERT(stats.max_chunks_per_file == 1);
+	TEST_ASSERT(stats.frag_index == 3); // 1 of 29 free sectors is not in the largest chunk
+
+	// File that needs 2 sectors, so it is split between sector 1 and sector 4
+	ret = test_create_and_write_one_helper(buff, sizeof(buff), &split_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.free_chunks_hist[0] == 0);
+	TEST_ASSERT(stats.free_chunks_hist[4] == 1);
+	TEST_ASSERT(stats.largest_free_sectors == 27);
+	TEST_ASSERT(stats.files_num == 4);
+	TEST_ASSERT(stats.files_chunks_num == 5);
+	TEST_ASSERT(stats.avg_chunks_per_file_x100 == 125);
+	TEST_ASSERT(stats.max_chunks_per_file == 2);
+	TEST_ASSERT(stats.frag_index == 0);
+
+	// Stats that built at init should be the same as the ones that were updated
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_frag_stats(&stats_after_init);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&stats, &stats_after_init, sizeof(stats)) == 0);
+
+	// Deleting the file with max chunks, the max should be found again
+	ret = hel_delete(split_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 3);
+	TEST_ASSERT(stats.files_chunks_num == 3);
+	TEST_ASSERT(stats.max_chunks_per_file == 1);
+	TEST_ASSERT(stats.free_chunks_hist[0] == 1);
+	TEST_ASSERT(stats.free_chunks_hist[4] == 1);
+}
+
+#define SECTOR_DATA_SIZE (DEFAULT_SECTOR_SIZE - MIN_FILE_SIZE)
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_x_data[SECTOR_DATA_SIZE * 3], g_y_data[SECTOR_DATA_SIZE * 2];
+static hel_file_id g_x_id, g_y_id;
+static int g_round;
+
+/*
+ * Creates file X with chunks at sectors 1, 3, 5 and file Y with chunks at sectors 6, 8,
+ * where sectors 0, 2, 4, 7 are single chunk files and the memory after sector 8 is free.
+ */
+static void fragmented_layout_helper()
+{
+	hel_file_id ids[8];
+	hel_ret ret;
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	for(int i = 0; i < 8; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, 1, &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_delete(ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[3]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[5]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	fill_rand_buff(g_x_data, sizeof(g_x_data));
+	ret = test_create_and_write_one_helper(g_x_data, sizeof(g_x_data), &g_x_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(ids[6]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	fill_rand_buff(g_y_data, sizeof(g_y_data));
+	ret = test_create_and_write_one_helper(g_y_data, sizeof(g_y_data), &g_y_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+}
+
+static void check_fragmented_layout_files()
+{
+	uint8_t buff_out[sizeof(g_x_data)];
+	hel_ret ret;
+
+	ret = hel_read(g_x_id, buff_out, 0, sizeof(g_x_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+	TEST_ASSERT_(memcmp(buff_out, g_x_data, sizeof(g_x_data)) == 0, "round %d", g_round);
+
+	ret = hel_read(g_y_id, buff_out, 0, sizeof(g_y_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+	TEST_ASSERT_(memcmp(buff_out, g_y_data, sizeof(g_y_data)) == 0, "round %d", g_round);
+}
+
+static void check_compacted_layout()
+{
+	hel_frag_stats stats;
+	hel_ret ret;
+
+	check_fragmented_layout_files();
+
+	// X tail moved to sectors 9-10, then Y tail moved to the hole at sector 3
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 6);
+	TEST_ASSERT(stats.files_chunks_num == 8);
+	TEST_ASSERT(stats.max_chunks_per_file == 2);
+	TEST_ASSERT(stats.free_chunks_hist[0] == 2);
+	TEST_ASSERT(stats.free_chunks_hist[4] == 1);
+	TEST_ASSERT(stats.largest_free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE - 11);
+}
+
+void compaction_test()
+{
+	uint8_t buff_out[sizeof(g_x_data)];
+	hel_frag_stats stats;
+	bool done;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	fragmented_layout_helper();
+
+	ret = hel_compact(0, NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_chunks_num == 9);
+	TEST_ASSERT(stats.max_chunks_per_file == 3);
+
+	// Budget of one byte, the first file is moved anyway and the second waits for the next call
+	ret = hel_compact(1, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(!done);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_chunks_num == 8);
+	TEST_ASSERT(stats.max_chunks_per_file == 2);
+
+	check_fragmented_layout_files();
+
+	ret = hel_compact(1, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(done);
+
+	check_compacted_layout();
+
+	// Nothing more to do
+	ret = hel_compact(0, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(done);
+
+	check_compacted_layout();
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	check_compacted_layout();
+
+	// The sectors after the first chunk of X are free now, so X grows over them into single chunk
+	ret = hel_delete(2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(g_y_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_compact(0, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(done);
+
+	ret = hel_read(g_x_id, buff_out, 0, sizeof(g_x_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, g_x_data, sizeof(g_x_data)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 4);
+	TEST_ASSERT(stats.files_chunks_num == 4);
+	TEST_ASSERT(stats.max_chunks_per_file == 1);
+	TEST_ASSERT(stats.largest_free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE - 8);
+}
+
+void power_down_in_compaction_test()
+{
+	hel_ret ret;
+	bool done;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		check_fragmented_layout_files();
+
+		ret = hel_compact(0, &done);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+		TEST_ASSERT(done);
+
+		check_compacted_layout();
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		fragmented_layout_helper();
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_compact(0, &done);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+		TEST_ASSERT(done);
+
+		power_down = PD_NONE;
+
+		check_compacted_layout();
+	}
+}
+
+void defrag_file_test()
+{
+	uint8_t buff_out[sizeof(g_x_data)];
+	hel_frag_stats stats;
+	hel_file_id new_id, single_id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	fragmented_layout_helper();
+
+	ret = hel_defrag_file(DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE, NULL);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_defrag_file(g_y_id + 2, NULL); // Y second chunk
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	// Single chunk file stays as is
+	ret = hel_defrag_file(0, &new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(new_id == 0);
+
+	// X can't grow (sector 2 is in use), with the same id it can just move its tail
+	ret = hel_defrag_file(g_x_id, NULL);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	check_fragmented_layout_files();
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_chunks_num == 8);
+	TEST_ASSERT(stats.max_chunks_per_file == 2);
+
+	// With new id X is copied into single chunk
+	ret = hel_defrag_file(g_x_id, &new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(new_id != g_x_id);
+
+	ret = hel_read(g_x_id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	g_x_id = new_id;
+	check_fragmented_layout_files();
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 6);
+	TEST_ASSERT(stats.files_chunks_num == 7);
+
+	// Free the sector after Y first chunk, so Y grows there and keeps its id
+	ret = hel_delete(7);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_defrag_file(g_y_id, &new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(new_id == g_y_id);
+
+	check_fragmented_layout_files();
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 5);
+	TEST_ASSERT(stats.files_chunks_num == 5);
+	TEST_ASSERT(stats.max_chunks_per_file == 1);
+
+	// The memory is valid after init, and new file can be created in the freed sectors
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	check_fragmented_layout_files();
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 5);
+	TEST_ASSERT(stats.files_chunks_num == 5);
+
+	ret = test_create_and_write_one_helper(MY_STR1, 1, &single_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(single_id == 1);
+}
+
+/*
+ * Finds X by its data, as it may be moved to new id.
+ */
+static void find_x_file_helper()
+{
+	uint8_t buff_out[sizeof(g_x_data)];
+	hel_file_id id;
+	int found = 0;
+	hel_ret ret;
+
+	ret = hel_get_first_file(&id);
+	while(ret == hel_success)
+	{
+		if((hel_read(id, buff_out, 0, sizeof(buff_out)) == hel_success) && (memcmp(buff_out, g_x_data, sizeof(g_x_data)) == 0))
+		{
+			g_x_id = id;
+			found++;
+		}
+
+		ret = hel_iterate_files(&id);
+	}
+
+	TEST_ASSERT_(ret == hel_file_not_exist_err, "got error %d", ret);
+	TEST_ASSERT_(found == 1, "found %d copies of X, round %d", found, g_round);
+}
+
+static void check_defragmented_layout()
+{
+	hel_frag_stats stats;
+	hel_ret ret;
+
+	check_fragmented_layout_files();
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 5);
+	TEST_ASSERT(stats.files_chunks_num == 5);
+	TEST_ASSERT(stats.max_chunks_per_file == 1);
+}
+
+void power_down_in_defrag_file_test()
+{
+	hel_frag_stats stats;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		find_x_file_helper();
+		check_fragmented_layout_files();
+
+		ret = hel_get_frag_stats(&stats);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(stats.files_num == 5, "got %d files, round %d", (int)stats.files_num, g_round);
+
+		ret = hel_defrag_file(g_x_id, &g_x_id);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		ret = hel_defrag_file(g_y_id, NULL);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		check_defragmented_layout();
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		fragmented_layout_helper();
+
+		ret = hel_delete(7);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_defrag_file(g_x_id, &g_x_id);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		ret = hel_defrag_file(g_y_id, NULL);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		check_defragmented_layout();
+	}
+}
+
+#define CACHE_TEST_SECTORS_NUM 120
+#define CACHE_TEST_HOLES_NUM 20
+
+/*
+ * Creates file that its first chunks are single sector holes, so it has CACHE_TEST_HOLES_NUM + 1 chunks.
+ */
+static void create_many_chunks_file_helper(uint8_t *data, HEL_BASE_TYPE size, hel_file_id *id)
+{
+	hel_file_id ids[CACHE_TEST_HOLES_NUM * 2];
+	hel_ret ret;
+
+	for(int i = 0; i < CACHE_TEST_HOLES_NUM * 2; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, 1, &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	for(int i = 0; i < CACHE_TEST_HOLES_NUM * 2; i += 2)
+	{
+		ret = hel_delete(ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	fill_rand_buff(data, size);
+	ret = test_create_and_write_one_helper(data, size, id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+}
+
+void extent_cache_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * (CACHE_TEST_HOLES_NUM + 4)];
+	uint8_t buff_out[sizeof(data)];
+	hel_file_id id, new_id;
+	hel_frag_stats stats;
+	bool done;
+	hel_ret ret;
+
+	mem_driver_init_test(CACHE_TEST_SECTORS_NUM * DEFAULT_SECTOR_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	create_many_chunks_file_helper(data, sizeof(data), &id);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.max_chunks_per_file == CACHE_TEST_HOLES_NUM + 1);
+
+	// Random reads, the first one loads the file into the cache
+	for(int i = 0; i < 200; i++)
+	{
+		HEL_BASE_TYPE begin = rand() % sizeof(data);
+		HEL_BASE_TYPE size = rand() % (sizeof(data) - begin + 1);
+
+		ret = hel_read(id, buff_out, begin, size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(memcmp(buff_out, data + begin, size) == 0, "begin %d size %d", (int)begin, (int)size);
+	}
+
+	ret = hel_read(id, buff_out, sizeof(data) - 1, 2);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_read(id, buff_out, sizeof(data), 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(2, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+#if HEL_EXTENT_CACHE_ENTRIES > 0 && HEL_EXTENT_CACHE_MAX_CHUNKS > 2
+	// Reading inside the cached chunks needs no metadata reads
+	mem_driver_reads_num = 0;
+	ret = hel_read(id, buff_out, SECTOR_DATA_SIZE + 1, 2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(mem_driver_reads_num == 1);
+	TEST_ASSERT(memcmp(buff_out, data + SECTOR_DATA_SIZE + 1, 2) == 0);
+#endif
+
+	// Changing the file chunks should remove it from the cache
+	ret = hel_compact(0, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(done);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_defrag_file(id, &new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	if(new_id != id)
+	{
+		ret = hel_read(id, buff_out, 0, 1);
+		TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+	}
+
+	ret = hel_read(new_id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	// New file in the place of deleted one
+	ret = hel_delete(new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(new_id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	fill_rand_buff(data, sizeof(data));
+	ret = test_create_and_write_one_helper(data, SECTOR_DATA_SIZE, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, SECTOR_DATA_SIZE);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, SECTOR_DATA_SIZE) == 0);
+}
+
+#define CURSOR_TEST_PIECE_SIZE 7
+
+void read_cursor_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * (CACHE_TEST_HOLES_NUM + 4)];
+	uint8_t buff_out[sizeof(data)];
+	hel_read_cursor cursor;
+	HEL_BASE_TYPE read_size, total_read = 0;
+	hel_file_id id;
+	bool done;
+	hel_ret ret;
+
+	mem_driver_init_test(CACHE_TEST_SECTORS_NUM * DEFAULT_SECTOR_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	create_many_chunks_file_helper(data, sizeof(data), &id);
+
+	ret = hel_open_read(id, NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_open_read(2, &cursor); // Second chunk of the file
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_open_read(id, &cursor);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Each piece needs single data read, plus single metadata read for each chunk
+	mem_driver_reads_num = 0;
+	while(true)
+	{
+		ret = hel_read_next(&cursor, buff_out + total_read, CURSOR_TEST_PIECE_SIZE, &read_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		total_read += read_size;
+		if(read_size < CURSOR_TEST_PIECE_SIZE)
+		{
+			break;
+		}
+	}
+
+	TEST_ASSERT(total_read == sizeof(data));
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+	TEST_ASSERT_(mem_driver_reads_num <= (int)((sizeof(data) / CURSOR_TEST_PIECE_SIZE) + 2 + (CACHE_TEST_HOLES_NUM + 2) * 2), "%d reads", mem_driver_reads_num);
+
+	ret = hel_read_next(&cursor, buff_out, 1, &read_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(read_size == 0);
+
+	// Seek backward and forward
+	ret = hel_seek(&cursor, SECTOR_DATA_SIZE + 3);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read_next(&cursor, buff_out, SECTOR_DATA_SIZE, &read_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(read_size == SECTOR_DATA_SIZE);
+	TEST_ASSERT(memcmp(buff_out, data + SECTOR_DATA_SIZE + 3, SECTOR_DATA_SIZE) == 0);
+
+	ret = hel_seek(&cursor, sizeof(data) - 5);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read_next(&cursor, buff_out, 10, &read_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(read_size == 5);
+	TEST_ASSERT(memcmp(buff_out, data + sizeof(data) - 5, 5) == 0);
+
+	ret = hel_seek(&cursor, sizeof(data) + 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// The cursor stays at its last place
+	ret = hel_seek(&cursor, 2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_seek(&cursor, sizeof(data) + 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_read_next(&cursor, buff_out, 3, &read_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(read_size == 3);
+	TEST_ASSERT(memcmp(buff_out, data + 2, 3) == 0);
+
+	// Chunks of the file are moved, the cursor should find its place again
+	ret = hel_compact(0, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(done);
+
+	ret = hel_read_next(&cursor, buff_out, sizeof(data) - 5, &read_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(read_size == sizeof(data) - 5);
+	TEST_ASSERT(memcmp(buff_out, data + 5, sizeof(data) - 5) == 0);
+
+	ret = hel_delete(id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read_next(&cursor, buff_out, 1, &read_size);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+}
+
+static hel_ret test_stream_write_helper(hel_writer *writer, uint8_t *data, HEL_BASE_TYPE size, HEL_BASE_TYPE piece_size)
+{
+	for(HEL_BASE_TYPE offset = 0; offset < size; offset += piece_size)
+	{
+		HEL_BASE_TYPE len = (size - offset < piece_size) ? size - offset : piece_size;
+		hel_ret ret = hel_write_append(writer, data + offset, len);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	return hel_success;
+}
+
+void streaming_writer_test()
+{
+	uint8_t data[DEFAULT_SECTOR_SIZE * 3], small_data[SECTOR_DATA_SIZE];
+	uint8_t buff_out[DEFAULT_MEM_SIZE];
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_writer writer;
+	hel_file_id id, small_id, hinted_id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_write_open(NULL, 0);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	// Unknown size, the reservation grows while writing and the rest is given back at commit
+	fill_rand_buff(data, sizeof(data));
+
+	ret = hel_write_open(&writer, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_stream_write_helper(&writer, data, sizeof(data), 7);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_commit(&writer, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_append(&writer, data, 1);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE - 4);
+	TEST_ASSERT(info.free_chunks_num == 1);
+
+	// Writer with size hint, while it is open other file is created, then the hint is passed
+	ret = hel_write_open(&writer, SECTOR_DATA_SIZE);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	fill_rand_buff(small_data, sizeof(small_data));
+	ret = test_create_and_write_one_helper(small_data, sizeof(small_data), &small_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(small_id == 5);
+
+	ret = test_stream_write_helper(&writer, data, sizeof(data), 5);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_commit(&writer, &hinted_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(hinted_id == 4);
+
+	ret = hel_read(hinted_id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_read(small_id, buff_out, 0, sizeof(small_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, small_data, sizeof(small_data)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 3);
+	TEST_ASSERT(stats.files_chunks_num == 5); // Chunks of 1, 2 and 4 sectors for the hinted file
+
+	// Abort gives back all the reserved chunks
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_open(&writer, SECTOR_DATA_SIZE);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_stream_write_helper(&writer, data, sizeof(data), sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_abort(&writer);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_abort(&writer);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	// More than the free space
+	ret = hel_write_open(&writer, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_stream_write_helper(&writer, buff_out, sizeof(buff_out), sizeof(buff_out));
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_write_abort(&writer);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	// Empty file
+	ret = hel_write_open(&writer, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_commit(&writer, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// The memory is valid after init
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(hinted_id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	// Init cancels the open writer, its reserved chunks are free again
+	ret = hel_write_open(&writer, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_stream_write_helper(&writer, data, sizeof(data), 7);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_append(&writer, data, 1);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_write_commit(&writer, &id);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_write_abort(&writer);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	// Writer that was opened before init but used at the first time after it
+	ret = hel_write_open(&writer, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_commit(&writer, &id);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	// Open writer doesn't take all the free space, so other files are created and appended meanwhile
+	ret = hel_write_open(&writer, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == info_before.free_sectors - HEL_WRITER_RESERVE_SECTORS);
+
+	ret = test_create_and_write_one_helper(small_data, sizeof(small_data), &small_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_stream_write_helper(&writer, data, sizeof(data), 7);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_append(small_id, (void *[]){small_data}, (HEL_BASE_TYPE[]){sizeof(small_data)}, 1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_write_commit(&writer, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_read(small_id, buff_out, sizeof(small_data), sizeof(small_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, small_data, sizeof(small_data)) == 0);
+}
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_stream_data[SECTOR_DATA_SIZE * 10];
+static HEL_BASE_TYPE g_stream_size;
+static hel_space_info g_info_before_stream;
+
+void power_down_in_streaming_writer_test()
+{
+	uint8_t buff_out[sizeof(g_stream_data)];
+	hel_space_info info;
+	hel_frag_stats stats;
+	hel_writer writer;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		// The small file is at sector 0, the streamed file either exists with all its data or doesn't exist
+		ret = hel_read(0, buff_out, 0, 1);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		ret = hel_get_frag_stats(&stats);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		id = 0;
+		if(stats.files_num == 2)
+		{
+			ret = hel_iterate_files(&id);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+			ret = hel_read(id, buff_out, 0, g_stream_size);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+			TEST_ASSERT_(memcmp(buff_out, g_stream_data, g_stream_size) == 0, "round %d", g_round);
+
+			ret = hel_delete(id);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		}
+		else
+		{
+			TEST_ASSERT_(stats.files_num == 1, "got %d files, round %d", (int)stats.files_num, g_round);
+		}
+
+		ret = hel_get_space_info(&info);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(info.free_sectors == g_info_before_stream.free_sectors, "round %d", g_round);
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		ret = test_create_and_write_one_helper(MY_STR1, 1, &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_get_space_info(&g_info_before_stream);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		g_stream_size = 1 + (rand() % sizeof(g_stream_data));
+		fill_rand_buff(g_stream_data, g_stream_size);
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_write_open(&writer, (rand() % 2) ? 0 : SECTOR_DATA_SIZE);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		ret = test_stream_write_helper(&writer, g_stream_data, g_stream_size, 1 + (rand() % SECTOR_DATA_SIZE));
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		ret = hel_write_commit(&writer, &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		ret = hel_read(id, buff_out, 0, g_stream_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, g_stream_data, g_stream_size) == 0);
+	}
+}
+
+void append_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * 3], buff_out[SECTOR_DATA_SIZE * 3];
+	void *in[3];
+	HEL_BASE_TYPE size[3];
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_file_id id, other_id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	fill_rand_buff(data, sizeof(data));
+
+	ret = test_create_and_write_one_helper(data, 5, &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	in[0] = data + 5;
+	size[0] = 3;
+
+	ret = hel_append(id, NULL, size, 1);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_append(DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE, in, size, 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_append(id + 1, in, size, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	// Fits at the last sector of the file
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_append(id, in, size, 1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(id, buff_out, 0, 8);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, 8) == 0);
+
+	ret = hel_read(id, buff_out, 0, 9);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// Other file right after it, so the rest is linked as new chunk
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &other_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(other_id == id + 1);
+
+	in[0] = data + 8;
+	size[0] = SECTOR_DATA_SIZE - 8;
+	in[1] = data + SECTOR_DATA_SIZE;
+	size[1] = 0;
+	in[2] = data + SECTOR_DATA_SIZE;
+	size[2] = SECTOR_DATA_SIZE * 2;
+
+	ret = hel_append(id, in, size, 3);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_read(other_id, buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, MY_STR1, sizeof(MY_STR1)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 2);
+	TEST_ASSERT(stats.files_chunks_num == 3);
+	TEST_ASSERT(stats.max_chunks_per_file == 2);
+
+	// Nothing to append
+	ret = hel_append(id, in, size, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// More than the free space, the file is not changed
+	in[0] = data;
+	size[0] = DEFAULT_MEM_SIZE;
+
+	ret = hel_append(id, in, size, 1);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data) + 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// The memory is valid after init
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+}
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_append_data[SECTOR_DATA_SIZE * 4];
+static HEL_BASE_TYPE g_append_old_size, g_append_new_size;
+static hel_space_info g_info_before_append;
+
+void power_down_in_append_test()
+{
+	uint8_t buff_out[sizeof(g_append_data)];
+	hel_space_info info;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		// The file has either all the appended data or none of it
+		ret = hel_read(0, buff_out, 0, g_append_new_size);
+		if(ret == hel_success)
+		{
+			TEST_ASSERT_(memcmp(buff_out, g_append_data, g_append_new_size) == 0, "round %d", g_round);
+		}
+		else
+		{
+			TEST_ASSERT_(ret == hel_boundaries_err, "got error %d, round %d", ret, g_round);
+
+			ret = hel_read(0, buff_out, 0, g_append_old_size);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+			TEST_ASSERT_(memcmp(buff_out, g_append_data, g_append_old_size) == 0, "round %d", g_round);
+
+			ret = hel_read(0, buff_out, 0, g_append_old_size + 1);
+			TEST_ASSERT_(ret == hel_boundaries_err, "got error %d, round %d", ret, g_round);
+
+			ret = hel_get_space_info(&info);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+			TEST_ASSERT_(info.free_sectors == g_info_before_append.free_sectors, "round %d", g_round);
+		}
+	}
+
+	while(g_round < 500)
+	{
+		void *in;
+		HEL_BASE_TYPE size;
+
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		g_append_old_size = 1 + (rand() % (SECTOR_DATA_SIZE * 2));
+		g_append_new_size = g_append_old_size + 1 + (rand() % (sizeof(g_append_data) - g_append_old_size));
+		fill_rand_buff(g_append_data, g_append_new_size);
+
+		ret = test_create_and_write_one_helper(g_append_data, g_append_old_size, &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		if(rand() % 2)
+		{
+			// Other file after it, so the file can't grow over the sectors after it
+			ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		}
+
+		ret = hel_get_space_info(&g_info_before_append);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		in = g_append_data + g_append_old_size;
+		size = g_append_new_size - g_append_old_size;
+		ret = hel_append(0, &in, &size, 1);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		ret = hel_read(0, buff_out, 0, g_append_new_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, g_append_data, g_append_new_size) == 0);
+	}
+}
+
+/*
+ * Creates file that has two chunks, the first at sector 0, with file of single sector between them.
+ */
+static hel_ret test_create_two_chunks_file_helper(uint8_t *data, HEL_BASE_TYPE size, hel_file_id *id)
+{
+	hel_file_id hole_id, between_id;
+	hel_ret ret;
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &hole_id);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &between_id);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	ret = hel_delete(hole_id);
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	return test_create_and_write_one_helper(data, size, id);
+}
+
+void write_at_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * 3], new_data[SECTOR_DATA_SIZE], buff_out[SECTOR_DATA_SIZE * 3];
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_read_cursor cursor;
+	HEL_BASE_TYPE read_size;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	fill_rand_buff(data, sizeof(data));
+	fill_rand_buff(new_data, sizeof(new_data));
+
+	ret = test_create_two_chunks_file_helper(data, sizeof(data), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(id == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.max_chunks_per_file == 2);
+
+	ret = hel_write_at(id, 0, NULL, 1);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_write_at(DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE, 0, new_data, 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_write_at(id + 2, 0, new_data, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_write_at(id, sizeof(data) - 1, new_data, 2);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_write_at(id, sizeof(data), new_data, 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	// Cursor that was opened before the write reads the new data
+	ret = hel_open_read(id, &cursor);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Inside the first chunk
+	ret = hel_write_at(id, 3, new_data, 10);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	memcpy(data + 3, new_data, 10);
+
+	// Over the boundary between the chunks
+	ret = hel_write_at(id, SECTOR_DATA_SIZE - 5, new_data, sizeof(new_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	memcpy(data + SECTOR_DATA_SIZE - 5, new_data, sizeof(new_data));
+
+	// The last byte
+	ret = hel_write_at(id, sizeof(data) - 1, new_data, 1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	data[sizeof(data) - 1] = new_data[0];
+
+	ret = hel_write_at(id, 0, new_data, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_read_next(&cursor, buff_out, sizeof(data), &read_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(read_size == sizeof(data));
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	// The file chunks are not changed
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 2);
+	TEST_ASSERT(stats.files_chunks_num == 3);
+
+	// The memory is valid after init
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	// No free chunk for the journal record
+	while(test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id) == hel_success);
+
+	ret = hel_write_at(0, 0, new_data, 1);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_read(0, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+}
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_write_at_old[SECTOR_DATA_SIZE * 3], g_write_at_new[SECTOR_DATA_SIZE * 3];
+
+void power_down_in_write_at_test()
+{
+	uint8_t buff_out[sizeof(g_write_at_old)];
+	HEL_BASE_TYPE offset, size;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		// The file has either all the old data or all the new data
+		ret = hel_read(0, buff_out, 0, sizeof(buff_out));
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+		TEST_ASSERT_((memcmp(buff_out, g_write_at_old, sizeof(buff_out)) == 0) || (memcmp(buff_out, g_write_at_new, sizeof(buff_out)) == 0), "round %d", g_round);
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		fill_rand_buff(g_write_at_old, sizeof(g_write_at_old));
+		memcpy(g_write_at_new, g_write_at_old, sizeof(g_write_at_new));
+
+		ret = test_create_two_chunks_file_helper(g_write_at_old, sizeof(g_write_at_old), &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		offset = rand() % sizeof(g_write_at_new);
+		size = 1 + (rand() % (sizeof(g_write_at_new) - offset));
+		fill_rand_buff(g_write_at_new + offset, size);
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_write_at(id, offset, g_write_at_new + offset, size);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		ret = hel_read(id, buff_out, 0, sizeof(buff_out));
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, g_write_at_new, sizeof(buff_out)) == 0);
+	}
+}
+
+void replace_test()
+{
+	uint8_t old_data[SECTOR_DATA_SIZE * 2], new_data[SECTOR_DATA_SIZE * 3], buff_out[SECTOR_DATA_SIZE * 3];
+	void *in[2] = {new_data, new_data + SECTOR_DATA_SIZE};
+	HEL_BASE_TYPE size[2] = {SECTOR_DATA_SIZE, SECTOR_DATA_SIZE * 2};
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_file_id id, other_id, new_id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	fill_rand_buff(old_data, sizeof(old_data));
+	fill_rand_buff(new_data, sizeof(new_data));
+
+	ret = test_create_and_write_one_helper(old_data, sizeof(old_data), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &other_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_replace(id, in, size, 2, NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_replace(DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE, in, size, 2, &new_id);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_replace(other_id + 1, in, size, 2, &new_id);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_replace(id, in, size, 2, &new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(new_id != id);
+
+	ret = hel_read(new_id, buff_out, 0, sizeof(new_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, new_data, sizeof(new_data)) == 0);
+
+	ret = hel_read(id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_read(other_id, buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, MY_STR1, sizeof(MY_STR1)) == 0);
+
+	// The old chunks are free again
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == info_before.free_sectors + 3 - 4);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 2);
+	TEST_ASSERT(stats.files_chunks_num == 2);
+
+	// Replace with empty content
+	id = new_id;
+	ret = hel_replace(id, NULL, NULL, 0, &new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(new_id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// No room for the new content, the old one stays
+	id = new_id;
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	in[0] = buff_out;
+	size[0] = DEFAULT_MEM_SIZE;
+	ret = hel_replace(id, in, size, 1, &new_id);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	// The memory is valid after init
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(id, buff_out, 0, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+}
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_replace_old[SECTOR_DATA_SIZE * 3], g_replace_new[SECTOR_DATA_SIZE * 3];
+static HEL_BASE_TYPE g_replace_old_size, g_replace_new_size;
+
+void power_down_in_replace_test()
+{
+	uint8_t buff_out[sizeof(g_replace_new)];
+	hel_frag_stats stats;
+	hel_file_id id;
+	void *in;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		// Exactly one version exists
+		ret = hel_get_frag_stats(&stats);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(stats.files_num == 1, "got %d files, round %d", (int)stats.files_num, g_round);
+
+		ret = hel_get_first_file(&id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		if(id == 0)
+		{
+			ret = hel_read(id, buff_out, 0, g_replace_old_size);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+			TEST_ASSERT_(memcmp(buff_out, g_replace_old, g_replace_old_size) == 0, "round %d", g_round);
+		}
+		else
+		{
+			ret = hel_read(id, buff_out, 0, g_replace_new_size);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+			TEST_ASSERT_(memcmp(buff_out, g_replace_new, g_replace_new_size) == 0, "round %d", g_round);
+		}
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		g_replace_old_size = 1 + (rand() % sizeof(g_replace_old));
+		g_replace_new_size = 1 + (rand() % sizeof(g_replace_new));
+		fill_rand_buff(g_replace_old, g_replace_old_size);
+		fill_rand_buff(g_replace_new, g_replace_new_size);
+
+		ret = test_create_and_write_one_helper(g_replace_old, g_replace_old_size, &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(id == 0);
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		in = g_replace_new;
+		ret = hel_replace(id, &in, &g_replace_new_size, 1, &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		ret = hel_read(id, buff_out, 0, g_replace_new_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, g_replace_new, g_replace_new_size) == 0);
+	}
+}
+
+void truncate_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * 3], buff_out[SECTOR_DATA_SIZE * 3];
+	void *in = MY_STR1;
+	HEL_BASE_TYPE size = sizeof(MY_STR1);
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	fill_rand_buff(data, sizeof(data));
+
+	// Chunks at sectors 0 and 2-3, and other file at sector 1
+	ret = test_create_two_chunks_file_helper(data, sizeof(data), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(id == 0);
+
+	ret = hel_truncate(DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE, 0);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_truncate(4, 0);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_truncate(id, sizeof(data) + 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_truncate(id, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	// The last chunk is split
+	ret = hel_truncate(id, SECTOR_DATA_SIZE + 3);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, SECTOR_DATA_SIZE + 3);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, SECTOR_DATA_SIZE + 3) == 0);
+
+	ret = hel_read(id, buff_out, 0, SECTOR_DATA_SIZE + 4);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == info_before.free_sectors + 1);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_chunks_num == 3);
+
+	// The last chunk is freed, the first becomes end chunk
+	ret = hel_truncate(id, SECTOR_DATA_SIZE);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, SECTOR_DATA_SIZE);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, SECTOR_DATA_SIZE) == 0);
+
+	ret = hel_read(id, buff_out, 0, SECTOR_DATA_SIZE + 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == info_before.free_sectors + 2);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_chunks_num == 2);
+	TEST_ASSERT(stats.max_chunks_per_file == 1);
+
+	// Empty file, that can grow again
+	ret = hel_truncate(id, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	ret = hel_append(id, &in, &size, 1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, MY_STR1, sizeof(MY_STR1)) == 0);
+
+	// The memory is valid after init
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(id, buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, MY_STR1, sizeof(MY_STR1)) == 0);
+}
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_truncate_data[SECTOR_DATA_SIZE * 4];
+static HEL_BASE_TYPE g_truncate_old_size, g_truncate_new_size;
+
+void power_down_in_truncate_test()
+{
+	uint8_t buff_out[sizeof(g_truncate_data)];
+	hel_frag_stats stats;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_get_frag_stats(&stats);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(stats.files_num == 2, "got %d files, round %d", (int)stats.files_num, g_round);
+
+		// The file has either the old size or the new one
+		ret = hel_read(0, buff_out, 0, g_truncate_old_size);
+		if(ret != hel_success)
+		{
+			TEST_ASSERT_(ret == hel_boundaries_err, "got error %d, round %d", ret, g_round);
+
+			ret = hel_read(0, buff_out, 0, g_truncate_new_size + 1);
+			TEST_ASSERT_(ret == hel_boundaries_err, "got error %d, round %d", ret, g_round);
+
+			ret = hel_read(0, buff_out, 0, g_truncate_new_size);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+		}
+
+		TEST_ASSERT_(memcmp(buff_out, g_truncate_data, g_truncate_new_size) == 0, "round %d", g_round);
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		g_truncate_old_size = SECTOR_DATA_SIZE + 1 + (rand() % (sizeof(g_truncate_data) - SECTOR_DATA_SIZE));
+		g_truncate_new_size = rand() % g_truncate_old_size;
+		fill_rand_buff(g_truncate_data, g_truncate_old_size);
+
+		ret = test_create_two_chunks_file_helper(g_truncate_data, g_truncate_old_size, &id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_truncate(id, g_truncate_new_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		ret = hel_read(id, buff_out, 0, g_truncate_new_size + 1);
+		TEST_ASSERT_(ret == hel_boundaries_err, "got error %d", ret);
+
+		ret = hel_read(id, buff_out, 0, g_truncate_new_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, g_truncate_data, g_truncate_new_size) == 0);
+	}
+}
+
+#define BATCH_TEST_FILES_NUM 20
+
+static uint8_t g_batch_split_data[DEFAULT_MEM_SIZE * 2], g_batch_split_out[DEFAULT_MEM_SIZE * 2];
+
+void create_batch_test()
+{
+	uint8_t data[BATCH_TEST_FILES_NUM][SECTOR_DATA_SIZE * 2], big_data[SECTOR_DATA_SIZE * 4];
+	uint8_t buff_out[SECTOR_DATA_SIZE * 4];
+	void *in[BATCH_TEST_FILES_NUM][2], *big_in = big_data;
+	HEL_BASE_TYPE size[BATCH_TEST_FILES_NUM][2], big_size = sizeof(big_data);
+	hel_batch_file files[BATCH_TEST_FILES_NUM + 1];
+	hel_file_id ids[BATCH_TEST_FILES_NUM + 1], hole_ids[BATCH_TEST_FILES_NUM];
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE * 2, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	for(int i = 0; i < BATCH_TEST_FILES_NUM; i++)
+	{
+		fill_rand_buff(data[i], sizeof(data[i]));
+
+		// Sizes up to two sectors, some files with two buffers and one empty file
+		in[i][0] = data[i];
+		size[i][0] = (i == 0) ? 0 : 1 + (rand() % SECTOR_DATA_SIZE);
+		in[i][1] = data[i] + size[i][0];
+		size[i][1] = (i % 2) ? rand() % SECTOR_DATA_SIZE : 0;
+
+		files[i].in = in[i];
+		files[i].size = size[i];
+		files[i].num = (i % 2) ? 2 : 1;
+	}
+
+	ret = hel_create_batch(NULL, 1, ids);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_create_batch(files, 1, NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_create_batch(NULL, 0, NULL);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_create_batch(files, BATCH_TEST_FILES_NUM, ids);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// All the files one after the other
+	for(int i = 0; i < BATCH_TEST_FILES_NUM; i++)
+	{
+		HEL_BASE_TYPE file_size = size[i][0] + ((i % 2) ? size[i][1] : 0);
+
+		if(i != 0)
+		{
+			HEL_BASE_TYPE prev_size = size[i - 1][0] + (((i - 1) % 2) ? size[i - 1][1] : 0);
+
+			TEST_ASSERT(ids[i] == ids[i - 1] + (prev_size + MIN_FILE_SIZE + DEFAULT_SECTOR_SIZE - 1) / DEFAULT_SECTOR_SIZE);
+		}
+
+		ret = hel_read(ids[i], buff_out, 0, file_size);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, data[i], file_size) == 0);
+
+		ret = hel_read(ids[i], buff_out, 0, file_size + 1);
+		TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+	}
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == BATCH_TEST_FILES_NUM);
+	TEST_ASSERT(stats.files_chunks_num == BATCH_TEST_FILES_NUM);
+
+	// Holes of single sector, the small files fill them and the big one goes after them
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	for(int i = 0; i < BATCH_TEST_FILES_NUM; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &hole_ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &ids[0]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	for(int i = 0; i < BATCH_TEST_FILES_NUM; i++)
+	{
+		ret = hel_delete(hole_ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		size[i][0] = 1 + (rand() % SECTOR_DATA_SIZE);
+		files[i].num = 1;
+	}
+
+	files[BATCH_TEST_FILES_NUM / 2].in = &big_in;
+	files[BATCH_TEST_FILES_NUM / 2].size = &big_size;
+	fill_rand_buff(big_data, sizeof(big_data));
+
+	ret = hel_create_batch(files, BATCH_TEST_FILES_NUM, ids);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	for(int i = 0; i < BATCH_TEST_FILES_NUM; i++)
+	{
+		if(i == BATCH_TEST_FILES_NUM / 2)
+		{
+			TEST_ASSERT(ids[i] == BATCH_TEST_FILES_NUM * 2);
+
+			ret = hel_read(ids[i], buff_out, 0, sizeof(big_data));
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+			TEST_ASSERT(memcmp(buff_out, big_data, sizeof(big_data)) == 0);
+		}
+		else
+		{
+			if(i < BATCH_TEST_FILES_NUM / 2)
+			{
+				TEST_ASSERT(ids[i] == hole_ids[i]);
+			}
+			else
+			{
+				// The extents are not checked again, so the files after the big file are placed after it
+				HEL_BASE_TYPE prev_size = (i - 1 == BATCH_TEST_FILES_NUM / 2) ? sizeof(big_data) : size[i - 1][0];
+
+				TEST_ASSERT(ids[i] == ids[i - 1] + (prev_size + MIN_FILE_SIZE + DEFAULT_SECTOR_SIZE - 1) / DEFAULT_SECTOR_SIZE);
+			}
+
+			ret = hel_read(ids[i], buff_out, 0, size[i][0]);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+			TEST_ASSERT(memcmp(buff_out, data[i], size[i][0]) == 0);
+		}
+	}
+
+	// File that doesn't fit any free extent is split, and file that doesn't fit at all fails the batch
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	fill_rand_buff(g_batch_split_data, sizeof(g_batch_split_data));
+	big_in = g_batch_split_data;
+	big_size = info_before.largest_free_sectors * DEFAULT_SECTOR_SIZE;
+	files[0].in = &big_in;
+	files[0].size = &big_size;
+	files[1].in = &big_in;
+	files[1].size = size[1];
+	files[1].num = 1;
+	size[1][0] = sizeof(g_batch_split_data);
+
+	ret = hel_create_batch(files, 2, ids);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == BATCH_TEST_FILES_NUM * 2 + 1);
+	TEST_ASSERT(stats.max_chunks_per_file > 1);
+
+	ret = hel_read(ids[0], g_batch_split_out, 0, big_size);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(g_batch_split_out, g_batch_split_data, big_size) == 0);
+
+	// Failed write of run, none of its files exists and its sectors are free again
+	ret = hel_delete(ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	big_in = MY_STR1;
+	big_size = sizeof(MY_STR1);
+	for(int i = 0; i < 2; i++)
+	{
+		files[i].in = &big_in;
+		files[i].size = &big_size;
+		files[i].num = 1;
+	}
+
+	mem_driver_writes_before_fail = 0;
+	ret = hel_create_batch(files, 2, ids);
+	mem_driver_writes_before_fail = -1;
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == BATCH_TEST_FILES_NUM * 2);
+
+	// The memory is valid after init
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+}
+
+#define BATCH_POWER_DOWN_FILES_NUM 5
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_batch_data[BATCH_POWER_DOWN_FILES_NUM][SECTOR_DATA_SIZE * 2];
+static HEL_BASE_TYPE g_batch_sizes[BATCH_POWER_DOWN_FILES_NUM];
+static hel_file_id g_batch_ids[BATCH_POWER_DOWN_FILES_NUM];
+
+void power_down_in_create_batch_test()
+{
+	uint8_t buff_out[SECTOR_DATA_SIZE * 2];
+	void *in[BATCH_POWER_DOWN_FILES_NUM];
+	hel_batch_file files[BATCH_POWER_DOWN_FILES_NUM];
+	hel_file_id ids[BATCH_POWER_DOWN_FILES_NUM];
+	hel_frag_stats stats;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		// All the files are at the same free extent, so they appear together
+		ret = hel_get_frag_stats(&stats);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_((stats.files_num == 0) || (stats.files_num == BATCH_POWER_DOWN_FILES_NUM), "got %d files, round %d", (int)stats.files_num, g_round);
+
+		for(int i = 0; (stats.files_num != 0) && (i < BATCH_POWER_DOWN_FILES_NUM); i++)
+		{
+			ret = hel_read(g_batch_ids[i], buff_out, 0, g_batch_sizes[i]);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+			TEST_ASSERT_(memcmp(buff_out, g_batch_data[i], g_batch_sizes[i]) == 0, "round %d", g_round);
+		}
+	}
+
+	while(g_round < 500)
+	{
+		hel_file_id next_id = 0;
+
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		for(int i = 0; i < BATCH_POWER_DOWN_FILES_NUM; i++)
+		{
+			g_batch_sizes[i] = rand() % sizeof(g_batch_data[i]);
+			fill_rand_buff(g_batch_data[i], g_batch_sizes[i]);
+
+			in[i] = g_batch_data[i];
+			files[i].in = &in[i];
+			files[i].size = &g_batch_sizes[i];
+			files[i].num = 1;
+
+			g_batch_ids[i] = next_id;
+			next_id += (g_batch_sizes[i] + MIN_FILE_SIZE + DEFAULT_SECTOR_SIZE - 1) / DEFAULT_SECTOR_SIZE;
+		}
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_create_batch(files, BATCH_POWER_DOWN_FILES_NUM, ids);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		TEST_ASSERT(memcmp(ids, g_batch_ids, sizeof(ids)) == 0);
+	}
+}
+
+/*
+ * Creates the layout: 0 - P, 1 - Q, 2 - first chunk of B, 3 - R, 4 - last chunk of B, 5 - S.
+ * So deleting Q, B, S makes free extent that starts with file (1-2), and free extent that starts with the last chunk of B (4-).
+ */
+static void delete_batch_layout_helper(uint8_t *b_data, hel_file_id *ids)
+{
+	hel_file_id hole_id, id;
+	hel_ret ret;
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(id == 0);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &hole_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_delete(hole_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(b_data, SECTOR_DATA_SIZE * 2, &ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(ids[1] == 2);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &ids[2]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(ids[2] == 5);
+}
+
+void delete_batch_test()
+{
+	uint8_t b_data[SECTOR_DATA_SIZE * 2], buff_out[SECTOR_DATA_SIZE * 2];
+	hel_file_id ids[3], batch_ids[3], bad_ids[2];
+	hel_space_info info_expected, info;
+	hel_frag_stats stats_expected, stats;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	fill_rand_buff(b_data, sizeof(b_data));
+
+	// The expected result is as deleting the files one by one
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	delete_batch_layout_helper(b_data, ids);
+
+	for(int i = 0; i < 3; i++)
+	{
+		ret = hel_delete(ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_get_space_info(&info_expected);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_frag_stats(&stats_expected);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	delete_batch_layout_helper(b_data, ids);
+
+	ret = hel_delete_batch(NULL, 1);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_delete_batch(NULL, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	bad_ids[0] = ids[0];
+	bad_ids[1] = ids[0];
+	ret = hel_delete_batch(bad_ids, 2);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	bad_ids[1] = 4;
+	ret = hel_delete_batch(bad_ids, 2);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	bad_ids[1] = DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE;
+	ret = hel_delete_batch(bad_ids, 2);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// Nothing was deleted
+	ret = hel_read(ids[0], buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	batch_ids[0] = ids[2];
+	batch_ids[1] = ids[0];
+	batch_ids[2] = ids[1];
+	ret = hel_delete_batch(batch_ids, 3);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Sorted
+	TEST_ASSERT(memcmp(batch_ids, ids, sizeof(ids)) == 0);
+
+	for(int i = 0; i < 3; i++)
+	{
+		ret = hel_read(ids[i], buff_out, 0, 1);
+		TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+	}
+
+	ret = hel_read(0, buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, MY_STR1, sizeof(MY_STR1)) == 0);
+
+	ret = hel_read(3, buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, MY_STR1, sizeof(MY_STR1)) == 0);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_expected, sizeof(info)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&stats, &stats_expected, sizeof(stats)) == 0);
+
+	// Iterating over the files walks over the merged free chunks
+	ret = hel_get_first_file(&ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(ids[0] == 0);
+
+	ret = hel_iterate_files(&ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(ids[0] == 3);
+
+	ret = hel_iterate_files(&ids[0]);
+	TEST_ASSERT_(ret == hel_file_not_exist_err, "expected error hel_file_not_exist_err-%d but got %d", hel_file_not_exist_err, ret);
+
+	// The memory is valid after init, and the freed space can be used
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_expected, sizeof(info)) == 0);
+
+	ret = test_create_and_write_one_helper(b_data, sizeof(b_data), &ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(ids[0], buff_out, 0, sizeof(b_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, b_data, sizeof(b_data)) == 0);
+}
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_delete_batch_data[SECTOR_DATA_SIZE * 2];
+static hel_file_id g_delete_batch_ids[3];
+static hel_space_info g_delete_batch_info;
+
+void power_down_in_delete_batch_test()
+{
+	uint8_t buff_out[SECTOR_DATA_SIZE * 2];
+	hel_file_id batch_ids[3];
+	hel_space_info info;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_read(0, buff_out, 0, sizeof(MY_STR1));
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		ret = hel_read(3, buff_out, 0, sizeof(MY_STR1));
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		// Each file is either deleted or not changed, deleting the rest gives the same free space
+		for(int i = 0; i < 3; i++)
+		{
+			HEL_BASE_TYPE size = (i == 1) ? sizeof(g_delete_batch_data) : sizeof(MY_STR1);
+
+			ret = hel_read(g_delete_batch_ids[i], buff_out, 0, size);
+			if(ret == hel_success)
+			{
+				TEST_ASSERT_(memcmp(buff_out, (i == 1) ? g_delete_batch_data : (uint8_t *)MY_STR1, size) == 0, "round %d", g_round);
+
+				ret = hel_delete(g_delete_batch_ids[i]);
+				TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+			}
+			else
+			{
+				TEST_ASSERT_(ret == hel_not_file_err, "got error %d, round %d", ret, g_round);
+			}
+		}
+
+		ret = hel_get_space_info(&info);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(info.free_sectors == g_delete_batch_info.free_sectors, "round %d", g_round);
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		fill_rand_buff(g_delete_batch_data, sizeof(g_delete_batch_data));
+		delete_batch_layout_helper(g_delete_batch_data, g_delete_batch_ids);
+
+		memcpy(batch_ids, g_delete_batch_ids, sizeof(batch_ids));
+
+		// Q, S and the two chunks of B are single sector each
+		ret = hel_get_space_info(&g_delete_batch_info);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		g_delete_batch_info.free_sectors += 4;
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_delete_batch(batch_ids, 3);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+
+		ret = hel_get_space_info(&info);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(info.free_sectors == g_delete_batch_info.free_sectors);
+	}
+}
+
+void txn_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * 2], buff_out[SECTOR_DATA_SIZE * 2];
+	void *in = data;
+	HEL_BASE_TYPE size = sizeof(data);
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_file_id ids[HEL_TXN_MAX_FILES + 1], new_ids[2], aborted_id;
+	hel_txn txn;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	fill_rand_buff(data, sizeof(data));
+
+	for(int i = 0; i < HEL_TXN_MAX_FILES + 1; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_txn_begin(NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_create(&txn, &in, &size, 1, NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_txn_delete(&txn, ids[HEL_TXN_MAX_FILES] + 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	// Two files created and two deleted together
+	ret = hel_txn_create(&txn, &in, &size, 1, &new_ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_create(&txn, NULL, NULL, 0, &new_ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_delete(&txn, ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_delete(&txn, ids[0]);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_txn_delete(&txn, ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Nothing is changed before the commit
+	ret = hel_read(new_ids[0], buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_read(ids[0], buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_commit(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_commit(&txn);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_read(new_ids[0], buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_read(new_ids[1], buff_out, 0, 0);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	for(int i = 0; i < 2; i++)
+	{
+		ret = hel_read(ids[i], buff_out, 0, 1);
+		TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+	}
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == HEL_TXN_MAX_FILES + 1);
+
+	// Abort frees the staged files
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_create(&txn, &in, &size, 1, &aborted_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_delete(&txn, ids[2]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_abort(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_abort(&txn);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_read(aborted_id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(ids[2], buff_out, 0, sizeof(MY_STR1));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Too many files in the transaction
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	for(int i = 2; i < HEL_TXN_MAX_FILES + 1; i++)
+	{
+		ret = hel_txn_delete(&txn, ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_txn_delete(&txn, new_ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_delete(&txn, new_ids[0]);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	// The file was deleted after it was staged
+	ret = hel_delete(new_ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_commit(&txn);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_txn_abort(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// Single change is written without journal
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_delete(&txn, ids[2]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_commit(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(ids[2], buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	// Empty transaction
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_commit(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// The memory is valid after init
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == HEL_TXN_MAX_FILES - 2 + 1);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_read(new_ids[0], buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	// Init cancels the open transaction, its staged files are free and its staged deletes are not done
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_create(&txn, &in, &size, 1, &aborted_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_delete(&txn, new_ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_commit(&txn);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_txn_abort(&txn);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_read(aborted_id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_read(new_ids[0], buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	// Transaction that was started before init but used at the first time after it
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_create(&txn, &in, &size, 1, &aborted_id);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_txn_delete(&txn, new_ids[0]);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+}
+
+// This needed to the power down tests , where all locals erases.
+static uint8_t g_txn_data[2][SECTOR_DATA_SIZE * 2];
+static hel_file_id g_txn_new_ids[2];
+
+void power_down_in_txn_test()
+{
+	uint8_t buff_out[SECTOR_DATA_SIZE * 2];
+	void *in;
+	HEL_BASE_TYPE size;
+	hel_file_id old_ids[2];
+	hel_frag_stats stats;
+	hel_txn txn;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	g_round = 0;
+	power_down_prob = 10;
+
+	setjmp(env);
+
+	power_down = PD_NONE;
+
+	if(g_round != 0)
+	{
+		ret = hel_close();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init();
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_get_frag_stats(&stats);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT_(stats.files_num == 2, "got %d files, round %d", (int)stats.files_num, g_round);
+
+		// Either the old files exist or the new ones
+		ret = hel_read(0, buff_out, 0, sizeof(MY_STR1));
+		if(ret == hel_success)
+		{
+			ret = hel_read(1, buff_out, 0, sizeof(MY_STR1));
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+		}
+		else
+		{
+			TEST_ASSERT_(ret == hel_not_file_err, "got error %d, round %d", ret, g_round);
+
+			for(int i = 0; i < 2; i++)
+			{
+				ret = hel_read(g_txn_new_ids[i], buff_out, 0, sizeof(g_txn_data[i]));
+				TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+				TEST_ASSERT_(memcmp(buff_out, g_txn_data[i], sizeof(g_txn_data[i])) == 0, "round %d", g_round);
+			}
+		}
+	}
+
+	while(g_round < 500)
+	{
+		g_round++;
+
+		ret = hel_format();
+		TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+		for(int i = 0; i < 2; i++)
+		{
+			ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &old_ids[i]);
+			TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+			fill_rand_buff(g_txn_data[i], sizeof(g_txn_data[i]));
+		}
+
+		power_down = rand() % 2 ? PD_IN_MIDDLE_RANDOMLY : PD_BEFORE_OERATION_RANDOMLY;
+
+		ret = hel_txn_begin(&txn);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		for(int i = 0; i < 2; i++)
+		{
+			in = g_txn_data[i];
+			size = sizeof(g_txn_data[i]);
+			ret = hel_txn_create(&txn, &in, &size, 1, &g_txn_new_ids[i]);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+			ret = hel_txn_delete(&txn, old_ids[i]);
+			TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+		}
+
+		ret = hel_txn_commit(&txn);
+		TEST_ASSERT_(ret == hel_success, "got error %d, round %d", ret, g_round);
+
+		power_down = PD_NONE;
+	}
+}
+
+#define PLAN_GROWTH_HOLES_NUM 12
+
+void chunks_plan_growth_test()
+{
+	uint8_t data[(SECTOR_DATA_SIZE * PLAN_GROWTH_HOLES_NUM) + 10], buff_out[sizeof(data)];
+	void *in = data;
+	HEL_BASE_TYPE size = sizeof(data);
+	hel_file_id ids[PLAN_GROWTH_HOLES_NUM * 2], txn_id;
+	hel_frag_stats stats;
+	hel_txn txn;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	fill_rand_buff(data, sizeof(data));
+
+	// Single sector holes, more free extents than the plan is allocated with at init
+	for(int i = 0; i < PLAN_GROWTH_HOLES_NUM * 2; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	for(int i = 0; i < PLAN_GROWTH_HOLES_NUM * 2; i += 2)
+	{
+		ret = hel_delete(ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	// The index is built again, so it grows while the plan doesn't
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_set_alloc_policy(hel_alloc_first_fit);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// The appended data is spread over all the holes
+	ret = hel_append(ids[1], &in, &size, 1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(ids[1], buff_out, sizeof(MY_STR1), sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(stats.files_chunks_num == PLAN_GROWTH_HOLES_NUM * 2, "got %d chunks", (int)stats.files_chunks_num);
+
+	ret = hel_delete(ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// And the staged file of a transaction too
+	ret = hel_txn_begin(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_create(&txn, &in, &size, 1, &txn_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_txn_commit(&txn);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(txn_id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(stats.files_chunks_num > PLAN_GROWTH_HOLES_NUM + 8, "got %d chunks", (int)stats.files_chunks_num);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_read(txn_id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+}
+
+#if HEL_THREAD_SAFE
+
+#define CONCURRENT_MEM_SIZE (DEFAULT_MEM_SIZE * 2)
+#define CONCURRENT_FILES_NUM ((HEL_EXTENT_CACHE_ENTRIES * 2) + 4) // More files than cache entries, so the reads miss the cache too
+#define CONCURRENT_FILE_SIZE (SECTOR_DATA_SIZE * 3)
+#define CONCURRENT_READS_NUM 20000
+#define CONCURRENT_MAX_THREADS 8
+
+static hel_file_id g_concurrent_ids[CONCURRENT_FILES_NUM];
+static atomic_bool g_concurrent_stop;
+
+typedef struct
+{
+	unsigned int seed;
+	int reads_num; // 0 for reading until g_concurrent_stop is set
+	int errors_num;
+}concurrent_reader_args;
+
+// The content of each of the files is its index at every byte, so readers can check what they read without sharing buffers
+static void *concurrent_reader(void *_args)
+{
+	concurrent_reader_args *args = _args;
+	uint8_t buff_out[CONCURRENT_FILE_SIZE];
+
+	for(int i = 0; (args->reads_num == 0) ? !g_concurrent_stop : (i < args->reads_num); i++)
+	{
+		int file_idx = rand_r(&args->seed) % CONCURRENT_FILES_NUM;
+		HEL_BASE_TYPE begin = rand_r(&args->seed) % CONCURRENT_FILE_SIZE;
+		HEL_BASE_TYPE size = rand_r(&args->seed) % (CONCURRENT_FILE_SIZE - begin + 1);
+		hel_file_id id;
+		int files_num = 0;
+
+		if(hel_read(g_concurrent_ids[file_idx], buff_out, begin, size) != hel_success)
+		{
+			args->errors_num++;
+			continue;
+		}
+
+		for(HEL_BASE_TYPE j = 0; j < size; j++)
+		{
+			if(buff_out[j] != file_idx)
+			{
+				args->errors_num++;
+				break;
+			}
+		}
+
+		if((i % 16) == 0)
+		{
+			hel_ret ret = hel_get_first_file(&id);
+			while(ret == hel_success)
+			{
+				files_num++;
+				ret = hel_iterate_files(&id);
+			}
+
+			if((ret != hel_file_not_exist_err) || (files_num < CONCURRENT_FILES_NUM))
+			{
+				args->errors_num++;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static hel_ret concurrent_files_create_helper()
+{
+	uint8_t data[CONCURRENT_FILE_SIZE];
+	hel_ret ret;
+
+	mem_driver_init_test(CONCURRENT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	if(ret != hel_success)
+	{
+		return ret;
+	}
+
+	for(int i = 0; i < CONCURRENT_FILES_NUM; i++)
+	{
+		memset(data, i, sizeof(data));
+
+		ret = test_create_and_write_one_helper(data, sizeof(data), &g_concurrent_ids[i]);
+		if(ret != hel_success)
+		{
+			return ret;
+		}
+	}
+
+	return hel_success;
+}
+
+void concurrent_read_write_test()
+{
+	pthread_t threads[4];
+	concurrent_reader_args args[4];
+	uint8_t data[CONCURRENT_FILE_SIZE], same_data[SECTOR_DATA_SIZE];
+	hel_file_id temp_id;
+	hel_ret ret;
+
+	ret = concurrent_files_create_helper();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	fill_rand_buff(data, sizeof(data));
+	g_concurrent_stop = false;
+
+	for(int i = 0; i < 4; i++)
+	{
+		args[i].seed = rand();
+		args[i].reads_num = 0;
+		args[i].errors_num = 0;
+		TEST_ASSERT(pthread_create(&threads[i], NULL, concurrent_reader, &args[i]) == 0);
+	}
+
+	// The writer changes the memory around the files that the readers read
+	for(int i = 0; i < 500; i++)
+	{
+		HEL_BASE_TYPE size = (rand() % sizeof(data)) + 1;
+
+		ret = test_create_and_write_one_helper(data, size, &temp_id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_append(temp_id, (void *[]){data}, &size, 1);
+		TEST_ASSERT_(ret == hel_success || ret == hel_mem_err, "got error %d", ret);
+
+		// Rewriting the same content, so the readers should never see other data
+		memset(same_data, i % CONCURRENT_FILES_NUM, sizeof(same_data));
+		ret = hel_write_at(g_concurrent_ids[i % CONCURRENT_FILES_NUM], rand() % (CONCURRENT_FILE_SIZE - sizeof(same_data) + 1), same_data, sizeof(same_data));
+		TEST_ASSERT_(ret == hel_success || ret == hel_mem_err, "got error %d", ret);
+
+		ret = hel_delete(temp_id);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	g_concurrent_stop = true;
+
+	for(int i = 0; i < 4; i++)
+	{
+		TEST_ASSERT(pthread_join(threads[i], NULL) == 0);
+		TEST_ASSERT_(args[i].errors_num == 0, "reader %d got %d errors", i, args[i].errors_num);
+	}
+}
+
+void concurrent_read_benchmark()
+{
+	pthread_t threads[CONCURRENT_MAX_THREADS];
+	concurrent_reader_args args[CONCURRENT_MAX_THREADS];
+	struct timespec start, end;
+	int cores_num = sysconf(_SC_NPROCESSORS_ONLN);
+	hel_ret ret;
+
+	ret = concurrent_files_create_helper();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	printf("\n%d cores\n", cores_num);
+
+	// The scaling depends on the machine, so it is only printed
+	for(int threads_num = 1; threads_num <= CONCURRENT_MAX_THREADS; threads_num *= 2)
+	{
+		double seconds;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for(int i = 0; i < threads_num; i++)
+		{
+			args[i].seed = rand();
+			args[i].reads_num = CONCURRENT_READS_NUM;
+			args[i].errors_num = 0;
+			TEST_ASSERT(pthread_create(&threads[i], NULL, concurrent_reader, &args[i]) == 0);
+		}
+
+		for(int i = 0; i < threads_num; i++)
+		{
+			TEST_ASSERT(pthread_join(threads[i], NULL) == 0);
+			TEST_ASSERT_(args[i].errors_num == 0, "reader %d got %d errors", i, args[i].errors_num);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		seconds = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+		printf("%d threads: %.0f reads/sec\n", threads_num, (threads_num * CONCURRENT_READS_NUM) / seconds);
+	}
+}
+
+#define CONCURRENT_CREATES_NUM 300
+#define CONCURRENT_BENCH_FILES_NUM 12
+#define CONCURRENT_BENCH_ROUNDS 50
+
+typedef struct
+{
+	unsigned int seed;
+	int thread_idx;
+	int errors_num;
+	hel_file_id ids[CONCURRENT_BENCH_FILES_NUM];
+}concurrent_creator_args;
+
+// Each creator writes files with its index at every byte, reads them back and deletes them, so the files of the creators don't collide
+static void *concurrent_creator(void *_args)
+{
+	concurrent_creator_args *args = _args;
+	uint8_t data[SECTOR_DATA_SIZE * 3], buff_out[sizeof(data)];
+	hel_file_id id;
+
+	memset(data, args->thread_idx, sizeof(data));
+
+	for(int i = 0; i < CONCURRENT_CREATES_NUM; i++)
+	{
+		HEL_BASE_TYPE size = (rand_r(&args->seed) % sizeof(data)) + 1;
+
+		if(test_create_and_write_one_helper(data, size, &id) != hel_success)
+		{
+			args->errors_num++;
+			continue;
+		}
+
+		if((hel_read(id, buff_out, 0, size) != hel_success) || (memcmp(buff_out, data, size) != 0))
+		{
+			args->errors_num++;
+		}
+
+		if(hel_delete(id) != hel_success)
+		{
+			args->errors_num++;
+		}
+	}
+
+	return NULL;
+}
+
+void concurrent_create_test()
+{
+	pthread_t threads[4];
+	concurrent_creator_args args[4];
+	hel_space_info info, info_after;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	ret = hel_set_alloc_groups(4);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	for(int i = 0; i < 4; i++)
+	{
+		args[i].seed = rand();
+		args[i].thread_idx = i;
+		args[i].errors_num = 0;
+		TEST_ASSERT(pthread_create(&threads[i], NULL, concurrent_creator, &args[i]) == 0);
+	}
+
+	for(int i = 0; i < 4; i++)
+	{
+		TEST_ASSERT(pthread_join(threads[i], NULL) == 0);
+		TEST_ASSERT_(args[i].errors_num == 0, "creator %d got %d errors", i, args[i].errors_num);
+	}
+
+	// All the files were deleted, so the free space should be as at the start, also after reading it again from the memory
+	ret = hel_get_first_file(&id);
+	TEST_ASSERT_(ret == hel_file_not_exist_err, "expected error hel_file_not_exist_err-%d but got %d", hel_file_not_exist_err, ret);
+
+	ret = hel_get_space_info(&info_after);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(info_after.free_sectors == info.free_sectors, "expected %d free sectors got %d", info.free_sectors, info_after.free_sectors);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_get_space_info(&info_after);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(info_after.free_sectors == info.free_sectors, "expected %d free sectors got %d", info.free_sectors, info_after.free_sectors);
+}
+
+static void *concurrent_bench_creator(void *_args)
+{
+	concurrent_creator_args *args = _args;
+	uint8_t data[SECTOR_DATA_SIZE];
+
+	memset(data, args->thread_idx, sizeof(data));
+
+	for(int i = 0; i < CONCURRENT_BENCH_FILES_NUM; i++)
+	{
+		if(test_create_and_write_one_helper(data, sizeof(data), &args->ids[i]) != hel_success)
+		{
+			args->errors_num++;
+		}
+	}
+
+	return NULL;
+}
+
+void concurrent_create_benchmark()
+{
+	pthread_t threads[CONCURRENT_MAX_THREADS];
+	concurrent_creator_args args[CONCURRENT_MAX_THREADS];
+	struct timespec start, end;
+	hel_ret ret;
+
+	// Room for the files of all the threads, less than 127 sectors for 16 bits base type
+	mem_driver_init_test(DEFAULT_SECTOR_SIZE * (CONCURRENT_MAX_THREADS * CONCURRENT_BENCH_FILES_NUM + 8), DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	printf("\n");
+
+	// The data is written outside of the allocator lock, so creates scale when the memory writes are slow
+	mem_driver_write_delay_us = 20;
+
+	// The scaling depends on the machine and the memory driver, so it is only printed
+	for(int threads_num = 1; threads_num <= CONCURRENT_MAX_THREADS; threads_num *= 2)
+	{
+		double seconds = 0;
+
+		ret = hel_set_alloc_groups(threads_num);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		for(int round = 0; round < CONCURRENT_BENCH_ROUNDS; round++)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+			for(int i = 0; i < threads_num; i++)
+			{
+				args[i].thread_idx = i;
+				args[i].errors_num = 0;
+				TEST_ASSERT(pthread_create(&threads[i], NULL, concurrent_bench_creator, &args[i]) == 0);
+			}
+
+			for(int i = 0; i < threads_num; i++)
+			{
+				TEST_ASSERT(pthread_join(threads[i], NULL) == 0);
+				TEST_ASSERT_(args[i].errors_num == 0, "creator %d got %d errors", i, args[i].errors_num);
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			seconds += (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+
+			for(int i = 0; i < threads_num; i++)
+			{
+				ret = hel_delete_batch(args[i].ids, CONCURRENT_BENCH_FILES_NUM);
+				TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+			}
+		}
+
+		printf("%d threads: %.0f creates/sec\n", threads_num, (threads_num * CONCURRENT_BENCH_FILES_NUM * CONCURRENT_BENCH_ROUNDS) / seconds);
+	}
+
+	mem_driver_write_delay_us = 0;
+}
+
+#endif
+
+/*
+ * Volume for the context API tests, its memory is given to the driver functions as their arg.
+ */
+typedef struct
+{
+	uint8_t mem[DEFAULT_MEM_SIZE];
+#if HEL_THREAD_SAFE
+	pthread_rwlock_t lock;
+	pthread_mutex_t cache_lock;
+	pthread_mutex_t alloc_lock;
+	pthread_mutex_t group_locks[HEL_MAX_ALLOC_GROUPS];
+#endif
+}test_volume;
+
+static hel_ret test_volume_init(void *arg, HEL_BASE_TYPE *size, HEL_BASE_TYPE *sector_size)
+{
+	*size = sizeof(((test_volume *)arg)->mem);
+	*sector_size = DEFAULT_SECTOR_SIZE;
+
+	return hel_success;
+}
+
+static hel_ret test_volume_close(void *arg)
+{
+	return hel_success;
+}
+
+static hel_ret test_volume_write(void *arg, HEL_BASE_TYPE v_addr, HEL_BASE_TYPE *atomic_write, void **in, HEL_BASE_TYPE *size, HEL_BASE_TYPE buffs_num)
+{
+	test_volume *volume = arg;
+	HEL_BASE_TYPE addr = (atomic_write != NULL) ? v_addr + ATOMIC_WRITE_SIZE : v_addr;
+
+	for(HEL_BASE_TYPE i = 0; i < buffs_num; i++)
+	{
+		memcpy(volume->mem + addr, in[i], size[i]);
+		addr += size[i];
+	}
+
+	if(atomic_write != NULL)
+	{
+		memcpy(volume->mem + v_addr, atomic_write, ATOMIC_WRITE_SIZE);
+	}
+
+	return hel_success;
+}
+
+static hel_ret test_volume_read(void *arg, HEL_BASE_TYPE v_addr, HEL_BASE_TYPE size, void *out)
+{
+	test_volume *volume = arg;
+
+	memcpy(out, volume->mem + v_addr, size);
+
+	return hel_success;
+}
+
+#if HEL_THREAD_SAFE
+static hel_ret test_volume_lock_shared(void *arg)
+{
+	return (pthread_rwlock_rdlock(&((test_volume *)arg)->lock) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_lock_exclusive(void *arg)
+{
+	return (pthread_rwlock_wrlock(&((test_volume *)arg)->lock) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_unlock(void *arg)
+{
+	return (pthread_rwlock_unlock(&((test_volume *)arg)->lock) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_cache_lock(void *arg)
+{
+	return (pthread_mutex_lock(&((test_volume *)arg)->cache_lock) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_cache_unlock(void *arg)
+{
+	return (pthread_mutex_unlock(&((test_volume *)arg)->cache_lock) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_alloc_lock(void *arg)
+{
+	return (pthread_mutex_lock(&((test_volume *)arg)->alloc_lock) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_alloc_unlock(void *arg)
+{
+	return (pthread_mutex_unlock(&((test_volume *)arg)->alloc_lock) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_group_lock(void *arg, HEL_BASE_TYPE group)
+{
+	return (pthread_mutex_lock(&((test_volume *)arg)->group_locks[group]) == 0) ? hel_success : hel_param_err;
+}
+
+static hel_ret test_volume_group_unlock(void *arg, HEL_BASE_TYPE group)
+{
+	return (pthread_mutex_unlock(&((test_volume *)arg)->group_locks[group]) == 0) ? hel_success : hel_param_err;
+}
+#endif
+
+static hel_ret test_volume_setup_helper(hel_fs *fs, test_volume *volume)
+{
+	hel_driver driver =
+	{
+		.arg = volume,
+		.mem_init = test_volume_init,
+		.mem_close = test_volume_close,
+		.mem_write = test_volume_write,
+		.mem_read = test_volume_read,
+#if HEL_THREAD_SAFE
+		.lock_shared = test_volume_lock_shared,
+		.unlock_shared = test_volume_unlock,
+		.lock_exclusive = test_volume_lock_exclusive,
+		.unlock_exclusive = test_volume_unlock,
+		.cache_lock = test_volume_cache_lock,
+		.cache_unlock = test_volume_cache_unlock,
+		.alloc_lock = test_volume_alloc_lock,
+		.alloc_unlock = test_volume_alloc_unlock,
+		.group_lock = test_volume_group_lock,
+		.group_unlock = test_volume_group_unlock,
+#endif
+	};
+
+	memset(volume, 0, sizeof(*volume));
+#if HEL_THREAD_SAFE
+	pthread_rwlock_init(&volume->lock, NULL);
+	pthread_mutex_init(&volume->cache_lock, NULL);
+	pthread_mutex_init(&volume->alloc_lock, NULL);
+	for(int i = 0; i < HEL_MAX_ALLOC_GROUPS; i++)
+	{
+		pthread_mutex_init(&volume->group_locks[i], NULL);
+	}
+#endif
+
+	return hel_fs_setup(fs, &driver);
+}
+
+// The volumes are big, so they are not on the stack
+static test_volume g_volumes[2];
+static hel_fs g_fss[2];
+
+void ctx_volumes_test()
+{
+	uint8_t buff_out[sizeof(BIG_STR1)];
+	char *strs[2] = {MY_STR1, BIG_STR1};
+	HEL_BASE_TYPE sizes[2] = {sizeof(MY_STR1), sizeof(BIG_STR1)};
+	hel_file_id ids[2], id;
+	hel_space_info infos[2];
+	hel_ret ret;
+
+	ret = hel_fs_setup(NULL, NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_format_ctx(NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	for(int i = 0; i < 2; i++)
+	{
+		ret = test_volume_setup_helper(&g_fss[i], &g_volumes[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_format_ctx(&g_fss[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	// The default volume is not affected by the others
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	for(int i = 0; i < 2; i++)
+	{
+		void *in = strs[i];
+
+		ret = hel_create_and_write_ctx(&g_fss[i], &in, &sizes[i], 1, &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	// Each volume has its own free space, so both files are at the start of their memory
+	TEST_ASSERT(ids[0] == ids[1]);
+
+	ret = hel_get_first_file(&id);
+	TEST_ASSERT_(ret == hel_file_not_exist_err, "expected error hel_file_not_exist_err-%d but got %d", hel_file_not_exist_err, ret);
+
+	for(int i = 0; i < 2; i++)
+	{
+		ret = hel_read_ctx(&g_fss[i], ids[i], buff_out, 0, sizes[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(memcmp(buff_out, strs[i], sizes[i]) == 0);
+
+		ret = hel_get_space_info_ctx(&g_fss[i], &infos[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	TEST_ASSERT(infos[0].free_sectors > infos[1].free_sectors);
+
+	ret = hel_delete_ctx(&g_fss[0], ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read_ctx(&g_fss[0], ids[0], buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	// Init finds the files of each volume at its memory
+	for(int i = 0; i < 2; i++)
+	{
+		ret = hel_close_ctx(&g_fss[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_init_ctx(&g_fss[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_get_first_file_ctx(&g_fss[0], &id);
+	TEST_ASSERT_(ret == hel_file_not_exist_err, "expected error hel_file_not_exist_err-%d but got %d", hel_file_not_exist_err, ret);
+
+	ret = hel_get_first_file_ctx(&g_fss[1], &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(id == ids[1]);
+
+	ret = hel_read_ctx(&g_fss[1], ids[1], buff_out, 0, sizes[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, strs[1], sizes[1]) == 0);
+
+	for(int i = 0; i < 2; i++)
+	{
+		ret = hel_close_ctx(&g_fss[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+}
+
+#if HEL_THREAD_SAFE
+static void *volume_worker(void *arg)
+{
+	hel_fs *fs = arg;
+	uint8_t data[SECTOR_DATA_SIZE * 2], buff_out[SECTOR_DATA_SIZE * 2];
+	void *in = data;
+	HEL_BASE_TYPE size = sizeof(data);
+	hel_file_id id;
+	intptr_t errors_num = 0;
+
+	memset(data, (fs == &g_fss[0]) ? 0xaa : 0x55, sizeof(data));
+
+	for(int i = 0; i < 1000; i++)
+	{
+		if((hel_create_and_write_ctx(fs, &in, &size, 1, &id) != hel_success) ||
+		   (hel_read_ctx(fs, id, buff_out, 0, sizeof(buff_out)) != hel_success) ||
+		   (memcmp(buff_out, data, sizeof(data)) != 0) ||
+		   (hel_delete_ctx(fs, id) != hel_success))
+		{
+			errors_num++;
+		}
+	}
+
+	return (void *)errors_num;
+}
+
+void concurrent_volumes_test()
+{
+	pthread_t threads[2];
+	void *errors_num;
+	hel_ret ret;
+
+	for(int i = 0; i < 2; i++)
+	{
+		ret = test_volume_setup_helper(&g_fss[i], &g_volumes[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+		ret = hel_format_ctx(&g_fss[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	for(int i = 0; i < 2; i++)
+	{
+		TEST_ASSERT(pthread_create(&threads[i], NULL, volume_worker, &g_fss[i]) == 0);
+	}
+
+	for(int i = 0; i < 2; i++)
+	{
+		TEST_ASSERT(pthread_join(threads[i], &errors_num) == 0);
+		TEST_ASSERT_(errors_num == NULL, "volume %d got %d errors", i, (int)(intptr_t)errors_num);
+
+		ret = hel_close_ctx(&g_fss[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+}
+#endif
+
+#if HEL_LOCKFREE_READS
+
+static hel_file_id g_lockfree_ids[2], g_lockfree_new_id;
+static uint8_t g_lockfree_new_data[SECTOR_DATA_SIZE * 2];
+
+// Runs in the middle of lock-free read, like the task that changes the files was interrupted by the reader
+static void lockfree_change_files_hook()
+{
+	hel_file_id ids[2];
+	hel_ret ret;
+
+	mem_driver_read_hook = NULL;
+
+	ids[0] = g_lockfree_ids[0];
+	ids[1] = g_lockfree_ids[1];
+	ret = hel_delete_batch(ids, 2);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(g_lockfree_new_data, sizeof(g_lockfree_new_data), &g_lockfree_new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+}
+
+void lockfree_read_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * 2], buff_out[SECTOR_DATA_SIZE * 2];
+	hel_lockfree_reader reader;
+	hel_file_id id;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	fill_rand_buff(data, sizeof(data));
+	fill_rand_buff(g_lockfree_new_data, sizeof(g_lockfree_new_data));
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	// Sectors 0-1 and 2
+	ret = test_create_and_write_one_helper(data, sizeof(data), &g_lockfree_ids[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(g_lockfree_ids[0] == 0);
+
+	ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &g_lockfree_ids[1]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(g_lockfree_ids[1] == 2);
+
+	ret = hel_lockfree_begin(NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	ret = hel_lockfree_begin(&reader);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_lockfree_read(&reader, DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// The files are deleted and new file is created after the first chunk metadata was read
+	mem_driver_read_hook = lockfree_change_files_hook;
+	ret = hel_lockfree_read(&reader, g_lockfree_ids[0], buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	// The sectors of the deleted files are not reused while the reader may read them
+	TEST_ASSERT(g_lockfree_new_id == 3);
+
+	ret = hel_lockfree_read(&reader, g_lockfree_ids[0], buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_lockfree_read(&reader, g_lockfree_new_id, buff_out, 0, sizeof(g_lockfree_new_data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, g_lockfree_new_data, sizeof(g_lockfree_new_data)) == 0);
+
+	ret = hel_delete(g_lockfree_new_id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = test_create_and_write_one_helper(data, sizeof(data), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(id == 5);
+
+	ret = hel_lockfree_end(&reader);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	// After the reader ended the freed sectors are reused from the next change
+	ret = test_create_and_write_one_helper(data, sizeof(data), &id);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(id == 0);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+}
+#endif
+
+#if HEL_ASYNC
+
+static int g_async_done_num;
+static hel_ret g_async_done_ret;
+
+static void async_done_callback(hel_async_op *op, hel_ret ret)
+{
+	TEST_ASSERT(op->context == &g_async_done_num);
+
+	g_async_done_num++;
+	g_async_done_ret = ret;
+}
+
+void async_test()
+{
+	uint8_t data[SECTOR_DATA_SIZE * 3], buff_out[SECTOR_DATA_SIZE * 3];
+	uint8_t small_buffs[HEL_ASYNC_MAX_REQUESTS + 1];
+	void *in[HEL_ASYNC_MAX_REQUESTS + 1] = {data, data + SECTOR_DATA_SIZE};
+	HEL_BASE_TYPE sizes[HEL_ASYNC_MAX_REQUESTS + 1] = {SECTOR_DATA_SIZE, SECTOR_DATA_SIZE * 2};
+	hel_async_op op = {.done = async_done_callback, .context = &g_async_done_num};
+	hel_async_op busy_ops[HEL_ASYNC_MAX_CREATES];
+	hel_space_info info_before, info;
+	hel_frag_stats stats;
+	hel_file_id ids[4], id;
+	bool done;
+	hel_ret ret;
+
+	mem_driver_init_test(DEFAULT_MEM_SIZE, DEFAULT_SECTOR_SIZE);
+
+	fill_rand_buff(data, sizeof(data));
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_success, "Got error %d", ret);
+
+	// Holes at sectors 0 and 2, so the file is split to 3 chunks
+	for(int i = 0; i < 4; i++)
+	{
+		ret = test_create_and_write_one_helper(MY_STR1, sizeof(MY_STR1), &ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+		TEST_ASSERT(ids[i] == i);
+	}
+
+	for(int i = 0; i < 4; i += 2)
+	{
+		ret = hel_delete(ids[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_create_and_write_async(in, sizes, 2, &id, NULL);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	g_async_done_num = 0;
+	ret = hel_create_and_write_async(in, sizes, 2, &id, &op);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(id == 0);
+
+	// The data of the 3 chunks and the metadata of the last 2 are queued together, the first chunk metadata waits for them
+	TEST_ASSERT_(mem_driver_async_queued_max == 5, "%d queued", mem_driver_async_queued_max);
+	TEST_ASSERT(g_async_done_num == 0);
+
+	ret = hel_read(id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	TEST_ASSERT(mem_driver_async_run(5) == 5);
+
+	ret = hel_async_poll(&op, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(!done);
+
+	// The file is counted only after it is created
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 2);
+
+	TEST_ASSERT(mem_driver_async_run(-1) == 1);
+	TEST_ASSERT(g_async_done_num == 1);
+	TEST_ASSERT_(g_async_done_ret == hel_success, "got error %d", g_async_done_ret);
+
+	ret = hel_async_poll(&op, &done);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(done);
+
+	ret = hel_read(id, buff_out, 0, sizeof(data));
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 3);
+	TEST_ASSERT(stats.files_chunks_num == 5);
+
+	// From the middle of the first chunk to the middle of the last one
+	mem_driver_async_queued_max = 0;
+	memset(buff_out, 0, sizeof(buff_out));
+	ret = hel_read_async(id, buff_out, 1, sizeof(data) - 2, &op);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT_(mem_driver_async_queued_max == 3, "%d queued", mem_driver_async_queued_max);
+
+	TEST_ASSERT(mem_driver_async_run(-1) == 3);
+	TEST_ASSERT(g_async_done_num == 2);
+	TEST_ASSERT_(g_async_done_ret == hel_success, "got error %d", g_async_done_ret);
+	TEST_ASSERT(memcmp(buff_out, data + 1, sizeof(data) - 2) == 0);
+
+	ret = hel_read_async(id, buff_out, 0, sizeof(data) + 1, &op);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// The second chunk of the file
+	ret = hel_read_async(ids[2], buff_out, 0, 1, &op);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	ret = hel_read_async(DEFAULT_MEM_SIZE / DEFAULT_SECTOR_SIZE, buff_out, 0, 1, &op);
+	TEST_ASSERT_(ret == hel_boundaries_err, "expected error hel_boundaries_err-%d but got %d", hel_boundaries_err, ret);
+
+	// Each buffer needs its own transfer, the reserved chunks are released
+	ret = hel_get_space_info(&info_before);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	for(int i = 0; i < HEL_ASYNC_MAX_REQUESTS + 1; i++)
+	{
+		in[i] = &small_buffs[i];
+		sizes[i] = 1;
+	}
+
+	ret = hel_create_and_write_async(in, sizes, HEL_ASYNC_MAX_REQUESTS + 1, &id, &op);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(info.free_sectors == info_before.free_sectors);
+
+	// Failed transfer, the first chunk metadata is not written so the file is not created
+	mem_driver_async_transfer_ret = hel_mem_err;
+
+	ret = hel_create_and_write_async(in, sizes, 1, &id, &op);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	TEST_ASSERT(mem_driver_async_run(-1) == 1);
+	TEST_ASSERT(g_async_done_num == 3);
+	TEST_ASSERT_(g_async_done_ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, g_async_done_ret);
+
+	ret = hel_async_poll(&op, &done);
+	TEST_ASSERT_(ret == hel_mem_err, "expected error hel_mem_err-%d but got %d", hel_mem_err, ret);
+	TEST_ASSERT(done);
+
+	ret = hel_read(id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_not_file_err, "expected error hel_not_file_err-%d but got %d", hel_not_file_err, ret);
+
+	// The reserved chunks are released and the file is not counted
+	ret = hel_get_space_info(&info);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(memcmp(&info, &info_before, sizeof(info)) == 0);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 3);
+
+	mem_driver_async_transfer_ret = hel_success;
+
+	// Creates in progress are limited, they are freed by the next call after they are done
+	for(int i = 0; i < HEL_ASYNC_MAX_CREATES; i++)
+	{
+		busy_ops[i].done = NULL;
+		ret = hel_create_and_write_async(in, sizes, 1, &id, &busy_ops[i]);
+		TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	}
+
+	ret = hel_create_and_write_async(in, sizes, 1, &id, &op);
+	TEST_ASSERT_(ret == hel_busy_err, "expected error hel_busy_err-%d but got %d", hel_busy_err, ret);
+
+	// The data and then the metadata of each file
+	TEST_ASSERT(mem_driver_async_run(-1) == 2 * HEL_ASYNC_MAX_CREATES);
+
+	ret = hel_create_and_write_async(in, sizes, 1, &id, &op);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	TEST_ASSERT(mem_driver_async_run(-1) == 2);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 3 + HEL_ASYNC_MAX_CREATES + 1);
+
+	// The driver still writes the create, so the free space can't be built again meanwhile
+	ret = hel_create_and_write_async(in, sizes, 1, &id, &busy_ops[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_busy_err, "expected error hel_busy_err-%d but got %d", hel_busy_err, ret);
+
+	ret = hel_format();
+	TEST_ASSERT_(ret == hel_busy_err, "expected error hel_busy_err-%d but got %d", hel_busy_err, ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_busy_err, "expected error hel_busy_err-%d but got %d", hel_busy_err, ret);
+
+	TEST_ASSERT(mem_driver_async_run(-1) == 2);
+
+	ret = hel_init();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_read(id, buff_out, 0, 1);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(buff_out[0] == small_buffs[0]);
+
+	ret = hel_get_frag_stats(&stats);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(stats.files_num == 3 + HEL_ASYNC_MAX_CREATES + 2);
+
+	ret = hel_async_poll(NULL, &done);
+	TEST_ASSERT_(ret == hel_param_err, "expected error hel_param_err-%d but got %d", hel_param_err, ret);
+
+	// Volume without asynchronous driver, the operation is done before the call returns
+	ret = test_volume_setup_helper(&g_fss[0], &g_volumes[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_format_ctx(&g_fss[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	in[0] = data;
+	sizes[0] = sizeof(data);
+	ret = hel_create_and_write_async_ctx(&g_fss[0], in, sizes, 1, &id, &op);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(g_async_done_num == 5);
+	TEST_ASSERT_(g_async_done_ret == hel_success, "got error %d", g_async_done_ret);
+
+	memset(buff_out, 0, sizeof(buff_out));
+	ret = hel_read_async_ctx(&g_fss[0], id, buff_out, 0, sizeof(data), &op);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+	TEST_ASSERT(g_async_done_num == 6);
+	TEST_ASSERT(memcmp(buff_out, data, sizeof(data)) == 0);
+
+	ret = hel_close_ctx(&g_fss[0]);
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+
+	ret = hel_close();
+	TEST_ASSERT_(ret == hel_success, "got error %d", ret);
+}
+#endif
@@ -6,7 +6,11 @@
 #include <setjmp.h>
 #include <stdbool.h>
 #include <math.h>
+#include <unistd.h>
 
+#if HEL_THREAD_SAFE
+#include <pthread.h>
+#endif
 
 #include "../kernel/hel_kernel.h"
 #include "test_utils.h"
@@ -17,9 +21,34 @@ static HEL_BASE_TYPE sector_size;
 
 #define HEL_MIN(x, y) ((x > y) ? y: x)
 
+#if HEL_THREAD_SAFE
+// Creates write while other threads read and write, so the copies are serialized for the words that they share to be read whole
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+#define MEM_LOCK() (void)pthread_mutex_lock(&mem_lock)
+#define MEM_UNLOCK() (void)pthread_mutex_unlock(&mem_lock)
+#else
+#define MEM_LOCK()
+#define MEM_UNLOCK()
+#endif
+
 jmp_buf env;
 power_down_option power_down = PD_NONE;
 int power_down_prob = 0;
+int mem_driver_reads_num = 0;
+int mem_driver_write_delay_us = 0;
+int mem_driver_writes_before_fail = -1;
+void (*mem_driver_read_hook)() = NULL;
+
+#if HEL_ASYNC
+#define ASYNC_QUEUE_SIZE 64
+
+// The submitted requests, done by mem_driver_async_run like DMA that completes them by interrupts
+static hel_mem_request *async_queue[ASYNC_QUEUE_SIZE];
+static int async_queue_first = 0;
+static int async_queue_num = 0;
+int mem_driver_async_queued_max = 0;
+hel_ret mem_driver_async_transfer_ret = hel_success;
+#endif
 
 extern void fill_rand_buff(uint8_t *buff, size_t len);
 
@@ -35,6 +64,9 @@ static bool decide_if_power_down(HEL_BASE_TYPE *size, HEL_BASE_TYPE num)
 		{
 			if((rand() % power_down_prob) == 0)
 			{
+#if HEL_THREAD_SAFE
+				os_driver_power_down_test();
+#endif
 				longjmp(env, 0);
 				assert(false);
 			}
@@ -90,6 +122,13 @@ void mem_driver_init_test(HEL_BASE_TYPE size, HEL_BASE_TYPE _sector_size)
 	assert(mem_buff != NULL);
 
 	fill_rand_buff(mem_buff, size);
+
+#if HEL_ASYNC
+	async_queue_first = 0;
+	async_queue_num = 0;
+	mem_driver_async_queued_max = 0;
+	mem_driver_async_transfer_ret = hel_success;
+#endif
 }
 
 hel_ret mem_driver_init(HEL_BASE_TYPE *size, HEL_BASE_TYPE *_sector_size)
@@ -120,8 +159,23 @@ hel_ret mem_driver_write(HEL_BASE_TYPE v_addr, HEL_BASE_TYPE *atomic_write, void
 		v_addr += ATOMIC_WRITE_SIZE;
 	}
 
+	if(mem_driver_writes_before_fail == 0)
+	{
+		return hel_mem_err;
+	}
+	if(mem_driver_writes_before_fail > 0)
+	{
+		mem_driver_writes_before_fail--;
+	}
+
 	bool down = decide_if_power_down(size, buffs_num);
 
+	if(mem_driver_write_delay_us != 0)
+	{
+		usleep(mem_driver_write_delay_us);
+	}
+
+	MEM_LOCK();
 	for(HEL_BASE_TYPE i = 0; i < buffs_num; i++)
 	{
 		HEL_BASE_TYPE curr_size = size[i];
@@ -131,15 +185,21 @@ hel_ret mem_driver_write(HEL_BASE_TYPE v_addr, HEL_BASE_TYPE *atomic_write, void
 
 		v_addr += size[i];
 	}
+	MEM_UNLOCK();
 
 	if(down)
 	{
+#if HEL_THREAD_SAFE
+		os_driver_power_down_test();
+#endif
 		longjmp(env, 0);
 	}
 
 	if(atomic_write != NULL)
 	{
+		MEM_LOCK();
 		memcpy(mem_buff + orig_v_addr, atomic_write, ATOMIC_WRITE_SIZE);
+		MEM_UNLOCK();
 	}
 
 
@@ -152,7 +212,68 @@ hel_ret mem_driver_read(HEL_BASE_TYPE v_addr, HEL_BASE_TYPE size, void *_out)
 	assert(mem_buff != NULL);
 	assert((v_addr < mem_size) && (mem_size - v_addr >= size));
 
+	MEM_LOCK();
+	mem_driver_reads_num++;
+
 	memcpy(out, mem_buff + v_addr, size);
+	MEM_UNLOCK();
+
+	if(mem_driver_read_hook != NULL)
+	{
+		mem_driver_read_hook();
+	}
 
 	return hel_success;
-}
\ No newline at end of file
+}
+
+#if HEL_ASYNC
+hel_ret mem_driver_submit(hel_mem_request *request)
+{
+	if(async_queue_num == ASYNC_QUEUE_SIZE)
+	{
+		return hel_mem_err;
+	}
+
+	async_queue[(async_queue_first + async_queue_num) % ASYNC_QUEUE_SIZE] = request;
+	async_queue_num++;
+
+	if(async_queue_num > mem_driver_async_queued_max)
+	{
+		mem_driver_async_queued_max = async_queue_num;
+	}
+
+	return hel_success;
+}
+
+int mem_driver_async_run(int requests_num)
+{
+	int done_num = 0;
+
+	while((async_queue_num != 0) && (done_num != requests_num))
+	{
+		hel_mem_request *request = async_queue[async_queue_first];
+		hel_ret ret = mem_driver_async_transfer_ret;
+
+		async_queue_first = (async_queue_first + 1) % ASYNC_QUEUE_SIZE;
+		async_queue_num--;
+
+		if(ret == hel_success)
+		{
+			if(request->is_write)
+			{
+				ret = mem_driver_write(request->v_addr, request->atomic_write, &request->buff, &request->size, (request->buff != NULL) ? 1 : 0);
+			}
+			else
+			{
+				ret = mem_driver_read(request->v_addr, request->size, request->buff);
+			}
+		}
+
+		// May submit the next request
+		hel_mem_request_done(request, ret);
+		done_num++;
+	}
+
+	return done_num;
+}
+#endif
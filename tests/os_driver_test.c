@@ -0,0 +1,86 @@
+#include "../kernel/hel_kernel.h"
+
+#if HEL_THREAD_SAFE
+
+#include <pthread.h>
+
+#include "../kernel/os_driver.h"
+
+#include "test_utils.h"
+
+static pthread_rwlock_t kernel_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t group_locks[HEL_MAX_ALLOC_GROUPS];
+static pthread_once_t group_locks_once = PTHREAD_ONCE_INIT;
+
+static void group_locks_init()
+{
+	for(int i = 0; i < HEL_MAX_ALLOC_GROUPS; i++)
+	{
+		pthread_mutex_init(&group_locks[i], NULL);
+	}
+}
+
+void os_driver_power_down_test()
+{
+	// The power down jumps out of the kernel while it holds its lock, after real power down the locks are created again
+	kernel_lock = (pthread_rwlock_t)PTHREAD_RWLOCK_INITIALIZER;
+	cache_lock = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+	alloc_lock = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+	group_locks_init();
+}
+
+hel_ret os_driver_lock_shared()
+{
+	return (pthread_rwlock_rdlock(&kernel_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_unlock_shared()
+{
+	return (pthread_rwlock_unlock(&kernel_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_lock_exclusive()
+{
+	return (pthread_rwlock_wrlock(&kernel_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_unlock_exclusive()
+{
+	return (pthread_rwlock_unlock(&kernel_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_cache_lock()
+{
+	return (pthread_mutex_lock(&cache_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_cache_unlock()
+{
+	return (pthread_mutex_unlock(&cache_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_alloc_lock()
+{
+	return (pthread_mutex_lock(&alloc_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_alloc_unlock()
+{
+	return (pthread_mutex_unlock(&alloc_lock) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_group_lock(HEL_BASE_TYPE group)
+{
+	pthread_once(&group_locks_once, group_locks_init);
+
+	return (pthread_mutex_lock(&group_locks[group]) == 0) ? hel_success : hel_param_err;
+}
+
+hel_ret os_driver_group_unlock(HEL_BASE_TYPE group)
+{
+	return (pthread_mutex_unlock(&group_locks[group]) == 0) ? hel_success : hel_param_err;
+}
+
+#endif
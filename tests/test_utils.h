@@ -5,6 +5,9 @@
 #include "../kernel/hel_kernel.h"
 
 void mem_driver_init_test(HEL_BASE_TYPE size, HEL_BASE_TYPE sector_size);
+#if HEL_THREAD_SAFE
+void os_driver_power_down_test();
+#endif
 
 typedef enum{
 	PD_NONE,
@@ -14,3 +17,12 @@ typedef enum{
 extern power_down_option power_down;
 extern int power_down_prob;
 extern jmp_buf env;
+extern int mem_driver_reads_num; // Counts the calls to mem_driver_read
+extern int mem_driver_write_delay_us; // Delay of each mem_driver_write, for simulating slow memory
+extern int mem_driver_writes_before_fail; // Number of mem_driver_write calls that succeed before the rest fail, -1 for never
+extern void (*mem_driver_read_hook)(); // Called after each mem_driver_read, for simulating changes in the middle of read
+#if HEL_ASYNC
+extern int mem_driver_async_queued_max; // Max number of requests that were queued at the same time
+extern hel_ret mem_driver_async_transfer_ret; // The result of the transfers, for simulating failed transfers
+int mem_driver_async_run(int requests_num); // Does up to requests_num queued requests by their order, returns the number of done requests
+#endif